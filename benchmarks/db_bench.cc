@@ -13,6 +13,7 @@
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/rate_limiter.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
 #include "util/crc32c.h"
@@ -88,6 +89,15 @@ static bool FLAGS_comparisons = false;
 // (initialized to default value by "main")
 static int FLAGS_write_buffer_size = 0;
 
+// Maximum number of write buffers held in memory
+// (initialized to default value by "main")
+static int FLAGS_max_write_buffer_number = 0;
+
+// Bytes per second at which writes are admitted while compactions fall
+// behind (0 disables throttling).
+// (initialized to default value by "main")
+static int FLAGS_delayed_write_rate = 0;
+
 // Number of bytes written to each file.
 // (initialized to default value by "main")
 static int FLAGS_max_file_size = 0;
@@ -100,6 +110,22 @@ static int FLAGS_block_size = 0;
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
+// If non-negative, use a CLOCK cache with 2^FLAGS_clock_cache_shard_bits
+// shards instead of an LRU cache.
+static int FLAGS_clock_cache_shard_bits = -1;
+
+// Number of blocks that readseq and readreverse prefetch ahead of the
+// iterator (no prefetching if == 0).
+static int FLAGS_prefetch_blocks = 0;
+
+// Number of threads that do the prefetch reads
+// (initialized to default value by "main")
+static int FLAGS_prefetch_threads = 0;
+
+// Compaction readahead and output buffer sizes (use default if == 0)
+static int FLAGS_compaction_readahead_size = 0;
+static int FLAGS_compaction_write_buffer_size = 0;
+
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
@@ -107,6 +133,11 @@ static int FLAGS_open_files = 0;
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// Limit on the bytes per second written to table files by background work
+// (no limit if == 0), and whether the limit is tuned from the backlog.
+static int FLAGS_rate_limiter_bytes_per_sec = 0;
+static bool FLAGS_rate_limiter_auto_tuned = false;
+
 // Common key prefix length.
 static int FLAGS_key_prefix = 0;
 
@@ -118,9 +149,21 @@ static bool FLAGS_use_existing_db = false;
 // If true, reuse existing log/MANIFEST files when re-opening a database.
 static bool FLAGS_reuse_logs = false;
 
+// If true, write data blocks with a hash index for point lookups.
+static bool FLAGS_data_block_hash_index = false;
+
 // If true, use compression.
 static bool FLAGS_compression = true;
 
+// Number of threads that compress the blocks of each table being built.
+static int FLAGS_compression_threads = 1;
+
+// Number of threads that apply log records when the database is opened.
+static int FLAGS_recovery_threads = 1;
+
+// Number of threads that open the tables in the background after Open().
+static int FLAGS_warm_up_threads = 0;
+
 // Use the db with the following name.
 static const char* FLAGS_db = nullptr;
 
@@ -373,6 +416,7 @@ class Benchmark {
  private:
   Cache* cache_;
   const FilterPolicy* filter_policy_;
+  RateLimiter* rate_limiter_;
   DB* db_;
   int num_;
   int value_size_;
@@ -463,10 +507,19 @@ class Benchmark {
 
  public:
   Benchmark()
-      : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
+      : cache_(FLAGS_cache_size < 0 ? nullptr
+               : FLAGS_clock_cache_shard_bits >= 0
+                   ? NewClockCache(FLAGS_cache_size,
+                                   FLAGS_clock_cache_shard_bits)
+                   : NewLRUCache(FLAGS_cache_size)),
         filter_policy_(FLAGS_bloom_bits >= 0
                            ? NewBloomFilterPolicy(FLAGS_bloom_bits)
                            : nullptr),
+        rate_limiter_(FLAGS_rate_limiter_bytes_per_sec > 0
+                          ? NewGenericRateLimiter(
+                                FLAGS_rate_limiter_bytes_per_sec,
+                                FLAGS_rate_limiter_auto_tuned)
+                          : nullptr),
         db_(nullptr),
         num_(FLAGS_num),
         value_size_(FLAGS_value_size),
@@ -491,6 +544,7 @@ class Benchmark {
     delete db_;
     delete cache_;
     delete filter_policy_;
+    delete rate_limiter_;
   }
 
   void Run() {
@@ -766,16 +820,26 @@ class Benchmark {
     options.create_if_missing = !FLAGS_use_existing_db;
     options.block_cache = cache_;
     options.write_buffer_size = FLAGS_write_buffer_size;
+    options.max_write_buffer_number = FLAGS_max_write_buffer_number;
+    options.delayed_write_rate = FLAGS_delayed_write_rate;
     options.max_file_size = FLAGS_max_file_size;
     options.block_size = FLAGS_block_size;
     if (FLAGS_comparisons) {
       options.comparator = &count_comparator_;
     }
     options.max_open_files = FLAGS_open_files;
+    options.compaction_readahead_size = FLAGS_compaction_readahead_size;
+    options.compaction_write_buffer_size = FLAGS_compaction_write_buffer_size;
     options.filter_policy = filter_policy_;
+    options.rate_limiter = rate_limiter_;
     options.reuse_logs = FLAGS_reuse_logs;
+    options.data_block_hash_index = FLAGS_data_block_hash_index;
     options.compression =
         FLAGS_compression ? kSnappyCompression : kNoCompression;
+    options.compression_threads = FLAGS_compression_threads;
+    options.recovery_threads = FLAGS_recovery_threads;
+    options.warm_up_threads = FLAGS_warm_up_threads;
+    options.prefetch_threads = FLAGS_prefetch_threads;
     Status s = DB::Open(options, FLAGS_db, &db_);
     if (!s.ok()) {
       std::fprintf(stderr, "open error: %s\n", s.ToString().c_str());
@@ -826,7 +890,9 @@ class Benchmark {
   }
 
   void ReadSequential(ThreadState* thread) {
-    Iterator* iter = db_->NewIterator(ReadOptions());
+    ReadOptions options;
+    options.prefetch_blocks = FLAGS_prefetch_blocks;
+    Iterator* iter = db_->NewIterator(options);
     int i = 0;
     int64_t bytes = 0;
     for (iter->SeekToFirst(); i < reads_ && iter->Valid(); iter->Next()) {
@@ -839,7 +905,9 @@ class Benchmark {
   }
 
   void ReadReverse(ThreadState* thread) {
-    Iterator* iter = db_->NewIterator(ReadOptions());
+    ReadOptions options;
+    options.prefetch_blocks = FLAGS_prefetch_blocks;
+    Iterator* iter = db_->NewIterator(options);
     int i = 0;
     int64_t bytes = 0;
     for (iter->SeekToLast(); i < reads_ && iter->Valid(); iter->Prev()) {
@@ -1025,9 +1093,13 @@ class Benchmark {
 
 int main(int argc, char** argv) {
   FLAGS_write_buffer_size = leveldb::Options().write_buffer_size;
+  FLAGS_max_write_buffer_number = leveldb::Options().max_write_buffer_number;
+  FLAGS_delayed_write_rate =
+      static_cast<int>(leveldb::Options().delayed_write_rate);
   FLAGS_max_file_size = leveldb::Options().max_file_size;
   FLAGS_block_size = leveldb::Options().block_size;
   FLAGS_open_files = leveldb::Options().max_open_files;
+  FLAGS_prefetch_threads = leveldb::Options().prefetch_threads;
   std::string default_db_path;
 
   for (int i = 1; i < argc; i++) {
@@ -1050,9 +1122,20 @@ int main(int argc, char** argv) {
     } else if (sscanf(argv[i], "--reuse_logs=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_reuse_logs = n;
+    } else if (sscanf(argv[i], "--data_block_hash_index=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_data_block_hash_index = n;
     } else if (sscanf(argv[i], "--compression=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_compression = n;
+    } else if (sscanf(argv[i], "--compression_threads=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_compression_threads = n;
+    } else if (sscanf(argv[i], "--recovery_threads=%d%c", &n, &junk) == 1) {
+      FLAGS_recovery_threads = n;
+    } else if (sscanf(argv[i], "--warm_up_threads=%d%c", &n, &junk) == 1) {
+      FLAGS_warm_up_threads = n;
     } else if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
       FLAGS_num = n;
     } else if (sscanf(argv[i], "--reads=%d%c", &n, &junk) == 1) {
@@ -1063,6 +1146,11 @@ int main(int argc, char** argv) {
       FLAGS_value_size = n;
     } else if (sscanf(argv[i], "--write_buffer_size=%d%c", &n, &junk) == 1) {
       FLAGS_write_buffer_size = n;
+    } else if (sscanf(argv[i], "--max_write_buffer_number=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_max_write_buffer_number = n;
+    } else if (sscanf(argv[i], "--delayed_write_rate=%d%c", &n, &junk) == 1) {
+      FLAGS_delayed_write_rate = n;
     } else if (sscanf(argv[i], "--max_file_size=%d%c", &n, &junk) == 1) {
       FLAGS_max_file_size = n;
     } else if (sscanf(argv[i], "--block_size=%d%c", &n, &junk) == 1) {
@@ -1071,8 +1159,28 @@ int main(int argc, char** argv) {
       FLAGS_key_prefix = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
+    } else if (sscanf(argv[i], "--clock_cache_shard_bits=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_clock_cache_shard_bits = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--rate_limiter_bytes_per_sec=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_rate_limiter_bytes_per_sec = n;
+    } else if (sscanf(argv[i], "--rate_limiter_auto_tuned=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_rate_limiter_auto_tuned = n;
+    } else if (sscanf(argv[i], "--prefetch_blocks=%d%c", &n, &junk) == 1) {
+      FLAGS_prefetch_blocks = n;
+    } else if (sscanf(argv[i], "--prefetch_threads=%d%c", &n, &junk) == 1) {
+      FLAGS_prefetch_threads = n;
+    } else if (sscanf(argv[i], "--compaction_readahead_size=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_compaction_readahead_size = n;
+    } else if (sscanf(argv[i], "--compaction_write_buffer_size=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_compaction_write_buffer_size = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
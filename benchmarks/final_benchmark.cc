@@ -53,13 +53,28 @@ int read_data(leveldb::DB* db, int num_entries, int key_size) {
 int main(int argc, char **argv) {
     if(argc == 1) {
         std::cout << "Please pass 1 if database should be seeded or 0 otherwise.";
+        std::cout << " Optionally pass the bloom filter bits per key (default 5)";
+        std::cout << " and \"uniform\" or \"optimized\" to choose whether";
+        std::cout << " bits per key vary by level." << std::endl;
         return -1;
     }
+    int bits_per_key = 5;
+    if (argc > 2) {
+        bits_per_key = atoi(argv[2]);
+    }
+    bool optimized = argc > 3 && strcmp(argv[3], "optimized") == 0;
+
     leveldb::DB* db;
     leveldb::Options options;
     srand(time(nullptr));
 
     options.create_if_missing = true;
+    if (optimized) {
+        options.filter_policy =
+            leveldb::NewOptimizedBloomFilterPolicy(bits_per_key);
+    } else {
+        options.filter_policy = leveldb::NewBloomFilterPolicy(bits_per_key);
+    }
     options.block_size = 1024 * 1024;
     options.compression = leveldb::kNoCompression;
     int key_size = 1024;
@@ -76,8 +91,6 @@ int main(int argc, char **argv) {
             std::cout << "Database seeding complete." << std::endl;
         }
     }
-    options.filter_policy =
-        leveldb::NewBloomFilterPolicy(5);
     delete db;
 
     status = leveldb::DB::Open(options, "/tmp/testdb", &db);
@@ -89,5 +102,7 @@ int main(int argc, char **argv) {
     auto stop = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
     std::cout << "Done. Took "<< duration.count() << "ms" << std::endl;
+    delete db;
+    delete options.filter_policy;
     return 0;
 }
\ No newline at end of file
@@ -24,6 +24,7 @@
 #include "db/write_batch_internal.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/scheduler.h"
 #include "leveldb/status.h"
 #include "leveldb/table.h"
 #include "leveldb/table_builder.h"
@@ -34,20 +35,43 @@
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/rate_limiter.h"
+#include "util/thread_pool.h"
 
 namespace leveldb {
 
 const int kNumNonTableCacheFiles = 10;
 
+// A write delayed by the write controller sleeps in slices of at most this
+// many microseconds, and the delay is recomputed after each one.
+const uint64_t kWriteDelaySliceMicros = 1000;
+
 // Information kept for every waiting writer
 struct DBImpl::Writer {
   explicit Writer(port::Mutex* mu)
-      : batch(nullptr), sync(false), done(false), cv(mu) {}
+      : batch(nullptr),
+        sync(false),
+        done(false),
+        last_sequence(0),
+        leader(nullptr),
+        pending_inserts(0),
+        cv(mu) {}
 
   Status status;
   WriteBatch* batch;
   bool sync;
   bool done;
+
+  // Used by the leader of a write group in pipelined mode: the last
+  // sequence number assigned to the group.
+  SequenceNumber last_sequence;
+
+  // Used with concurrent memtable writes.  A follower inserts its own
+  // batch once "leader" is set, and records any error in leader->status.
+  // The leader waits for its "pending_inserts" to drop to zero.
+  Writer* leader;
+  int pending_inserts;
+
   port::CondVar cv;
 };
 
@@ -83,6 +107,30 @@ struct DBImpl::CompactionState {
   TableBuilder* builder;
 
   uint64_t total_bytes;
+
+  // Progress through the keys of the compaction.
+  Compaction::Position position;
+};
+
+// A range of the keys of a compaction that is compacted on its own thread.
+struct DBImpl::Subcompaction {
+  Subcompaction(DBImpl* db, CompactionState* state)
+      : db(db),
+        state(state),
+        input(nullptr),
+        begin(nullptr),
+        end(nullptr),
+        imm_micros(0),
+        done(false) {}
+
+  DBImpl* const db;
+  CompactionState* const state;  // Outputs of this range
+  Iterator* input;
+  const Slice* begin;  // First user key of the range
+  const Slice* end;    // User key after the range; null means unbounded
+  Status status;
+  int64_t imm_micros;
+  bool done;  // Guarded by db->mutex_
 };
 
 // Fix user-supplied options to be reasonable
@@ -100,8 +148,21 @@ Options SanitizeOptions(const std::string& dbname,
   result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
   ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
+  ClipToRange(&result.max_write_buffer_number, 2, 64);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+  ClipToRange(&result.max_background_compactions, 1, 64);
+  ClipToRange(&result.max_subcompactions, 1, 64);
+  ClipToRange(&result.compression_threads, 1, 64);
+  ClipToRange(&result.recovery_threads, 1, 64);
+  ClipToRange(&result.warm_up_threads, 0, 64);
+  ClipToRange(&result.prefetch_threads, 1, 64);
+  if (result.compaction_readahead_size > 0) {
+    ClipToRange(&result.compaction_readahead_size, 64 << 10, 64 << 20);
+  }
+  if (result.compaction_write_buffer_size > 0) {
+    ClipToRange(&result.compaction_write_buffer_size, 64 << 10, 64 << 20);
+  }
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -115,6 +176,15 @@ Options SanitizeOptions(const std::string& dbname,
   if (result.block_cache == nullptr) {
     result.block_cache = NewLRUCache(8 << 20);
   }
+  if (result.compression_threads > 1 &&
+      result.compression_scheduler == nullptr) {
+    result.compression_scheduler =
+        NewThreadPoolScheduler(result.compression_threads, src.env);
+  }
+  if (result.prefetch_scheduler == nullptr) {
+    result.prefetch_scheduler =
+        NewThreadPoolScheduler(result.prefetch_threads, src.env);
+  }
   return result;
 }
 
@@ -123,52 +193,94 @@ static int TableCacheSize(const Options& sanitized_options) {
   return sanitized_options.max_open_files - kNumNonTableCacheFiles;
 }
 
+// Returns the compression to use for tables written to "level".
+static CompressionType CompressionForLevel(const Options& options, int level) {
+  const std::vector<CompressionType>& per_level = options.compression_per_level;
+  if (per_level.empty()) {
+    return options.compression;
+  }
+  return per_level[std::min<size_t>(level, per_level.size() - 1)];
+}
+
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
-      internal_filter_policy_(raw_options.filter_policy),
+      internal_filter_policy_(raw_options.filter_policy,
+                              raw_options.prefix_extractor,
+                              raw_options.whole_key_filtering),
       options_(SanitizeOptions(dbname, &internal_comparator_,
                                &internal_filter_policy_, raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
+      owns_compression_scheduler_(options_.compression_scheduler !=
+                                  raw_options.compression_scheduler),
+      owns_prefetch_scheduler_(options_.prefetch_scheduler !=
+                               raw_options.prefetch_scheduler),
       dbname_(dbname),
       table_cache_(new TableCache(dbname_, options_, TableCacheSize(options_))),
       db_lock_(nullptr),
       shutting_down_(false),
       background_work_finished_signal_(&mutex_),
       mem_(nullptr),
-      imm_(nullptr),
       has_imm_(false),
       logfile_(nullptr),
       logfile_number_(0),
       log_(nullptr),
       seed_(0),
       tmp_batch_(new WriteBatch),
-      background_compaction_scheduled_(false),
+      background_compactions_scheduled_(0),
+      running_compactions_(0),
+      merging_compactions_(0),
+      peak_merging_compactions_(0),
+      background_flush_scheduled_(false),
+      imm_compaction_running_(false),
+      manifest_write_running_(false),
+      manifest_write_finished_signal_(&mutex_),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
-                               &internal_comparator_)) {}
+                               &internal_comparator_)),
+      write_controller_(&options_),
+      write_delay_micros_(0),
+      warm_up_pool_(nullptr),
+      warm_up_version_(nullptr),
+      warm_up_next_(0),
+      warm_up_opened_(0),
+      warm_up_running_(0) {
+  // One thread for every compaction plus one for memtable compactions.
+  // SetBackgroundThreads() only ever grows the pool, so this does not
+  // take threads away from other databases that share the Env.
+  env_->SetBackgroundThreads(options_.max_background_compactions + 1);
+}
 
 DBImpl::~DBImpl() {
   // Wait for background work to finish.
   mutex_.Lock();
   shutting_down_.store(true, std::memory_order_release);
-  while (background_compaction_scheduled_) {
+  while (background_compactions_scheduled_ > 0 ||
+         background_flush_scheduled_) {
     background_work_finished_signal_.Wait();
   }
   mutex_.Unlock();
 
+  // The warm-up threads stop early once shutting_down_ is set.
+  delete warm_up_pool_;
+
   if (db_lock_ != nullptr) {
     env_->UnlockFile(db_lock_);
   }
 
   delete versions_;
   if (mem_ != nullptr) mem_->Unref();
-  if (imm_ != nullptr) imm_->Unref();
+  for (size_t i = 0; i < imm_.size(); i++) {
+    imm_[i].mem->Unref();
+  }
   delete tmp_batch_;
   delete log_;
   delete logfile_;
   delete table_cache_;
+  for (const auto& kvp : level_filter_policies_) {
+    delete kvp.second;
+  }
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -176,6 +288,12 @@ DBImpl::~DBImpl() {
   if (owns_cache_) {
     delete options_.block_cache;
   }
+  if (owns_compression_scheduler_) {
+    delete options_.compression_scheduler;
+  }
+  if (owns_prefetch_scheduler_) {
+    delete options_.prefetch_scheduler;
+  }
 }
 
 Status DBImpl::NewDB() {
@@ -382,6 +500,133 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
   return Status::OK();
 }
 
+namespace {
+
+// Applies the batches read from a log file to a memtable on a pool of
+// threads, so that the recovering thread only has to read and checksum
+// the log.  Batches are handed out in chunks of about kChunkBytes, and
+// at most two chunks per thread are in flight at a time.
+class LogReplayPool {
+ public:
+  LogReplayPool(Env* env, int num_threads)
+      : cv_(&mu_),
+        chunk_(nullptr),
+        pending_(0),
+        max_pending_(2 * num_threads),
+        pool_(env, num_threads) {}
+
+  ~LogReplayPool() {
+    assert(chunk_ == nullptr);
+    assert(pending_ == 0);
+  }
+
+  // Queue the batch in "record" to be inserted into *mem, and return the
+  // sequence number of its last entry.
+  // REQUIRES: mem is the same for all calls between calls to Finish().
+  SequenceNumber Add(const Slice& record, MemTable* mem) {
+    if (chunk_ == nullptr) {
+      chunk_ = new Chunk;
+      chunk_->pool = this;
+      chunk_->mem = mem;
+      chunk_->bytes = 0;
+    }
+    assert(chunk_->mem == mem);
+    chunk_->batches.emplace_back();
+    WriteBatch* batch = &chunk_->batches.back();
+    WriteBatchInternal::SetContents(batch, record);
+    const SequenceNumber last_seq = WriteBatchInternal::Sequence(batch) +
+                                    WriteBatchInternal::Count(batch) - 1;
+    chunk_->bytes += record.size();
+    if (chunk_->bytes >= kChunkBytes) {
+      Dispatch();
+    }
+    return last_seq;
+  }
+
+  // Return the first error from inserting a batch since the last call to
+  // TakeStatus() or Finish(), and forget it so that it is reported once.
+  Status TakeStatus() {
+    MutexLock l(&mu_);
+    Status s = status_;
+    status_ = Status::OK();
+    return s;
+  }
+
+  // Wait until all the queued batches have been inserted, and return the
+  // first error from inserting them that has not been reported yet.
+  Status Finish() {
+    if (chunk_ != nullptr) {
+      Dispatch();
+    }
+    MutexLock l(&mu_);
+    while (pending_ > 0) {
+      cv_.Wait();
+    }
+    Status s = status_;
+    status_ = Status::OK();
+    return s;
+  }
+
+ private:
+  static const size_t kChunkBytes = 256 << 10;
+
+  struct Chunk {
+    LogReplayPool* pool;
+    MemTable* mem;
+    std::vector<WriteBatch> batches;
+    size_t bytes;
+  };
+
+  void Dispatch() {
+    Chunk* chunk = chunk_;
+    chunk_ = nullptr;
+    {
+      MutexLock l(&mu_);
+      while (pending_ >= max_pending_) {
+        cv_.Wait();
+      }
+      pending_++;
+    }
+    pool_.Schedule(&LogReplayPool::Apply, chunk);
+  }
+
+  static void Apply(void* arg) {
+    Chunk* chunk = reinterpret_cast<Chunk*>(arg);
+    // Like the serial replay, a batch that fails to insert does not stop
+    // the batches after it from being inserted; the caller decides from
+    // the reported error whether recovery goes on.
+    Status s;
+    for (size_t i = 0; i < chunk->batches.size(); i++) {
+      Status batch_status = WriteBatchInternal::InsertIntoConcurrently(
+          &chunk->batches[i], chunk->mem);
+      if (!batch_status.ok() && s.ok()) {
+        s = batch_status;
+      }
+    }
+    LogReplayPool* pool = chunk->pool;
+    delete chunk;
+    MutexLock l(&pool->mu_);
+    if (!s.ok() && pool->status_.ok()) {
+      pool->status_ = s;
+    }
+    pool->pending_--;
+    pool->cv_.SignalAll();
+  }
+
+  port::Mutex mu_;
+  port::CondVar cv_ GUARDED_BY(mu_);
+  Status status_ GUARDED_BY(mu_);
+  Chunk* chunk_;  // Batches not yet handed to the pool, or null
+  int pending_ GUARDED_BY(mu_);  // Chunks handed to the pool
+  const int max_pending_;
+
+  // Declared last so that its threads exit before the members above are
+  // destroyed.
+  ThreadPool pool_;
+};
+
+}  // namespace
+
 Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
                               bool* save_manifest, VersionEdit* edit,
                               SequenceNumber* max_sequence) {
@@ -429,33 +674,53 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   WriteBatch batch;
   int compactions = 0;
   MemTable* mem = nullptr;
+  // With recovery_threads > 1, batches are inserted by "replay" while
+  // this thread goes on reading the log.  The memtable is only flushed
+  // or handed over once the batches queued for it have been inserted.
+  LogReplayPool* replay =
+      (options_.recovery_threads > 1)
+          ? new LogReplayPool(env_, options_.recovery_threads)
+          : nullptr;
   while (reader.ReadRecord(&record, &scratch) && status.ok()) {
     if (record.size() < 12) {
       reporter.Corruption(record.size(),
                           Status::Corruption("log record too small"));
       continue;
     }
-    WriteBatchInternal::SetContents(&batch, record);
 
     if (mem == nullptr) {
       mem = new MemTable(internal_comparator_);
       mem->Ref();
     }
-    status = WriteBatchInternal::InsertInto(&batch, mem);
+    SequenceNumber last_seq;
+    if (replay != nullptr) {
+      last_seq = replay->Add(record, mem);
+      status = replay->TakeStatus();
+    } else {
+      WriteBatchInternal::SetContents(&batch, record);
+      last_seq = WriteBatchInternal::Sequence(&batch) +
+                 WriteBatchInternal::Count(&batch) - 1;
+      status = WriteBatchInternal::InsertInto(&batch, mem);
+    }
     MaybeIgnoreError(&status);
     if (!status.ok()) {
       break;
     }
-    const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
-                                    WriteBatchInternal::Count(&batch) - 1;
     if (last_seq > *max_sequence) {
       *max_sequence = last_seq;
     }
 
     if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
+      if (replay != nullptr) {
+        status = replay->Finish();
+        MaybeIgnoreError(&status);
+        if (!status.ok()) {
+          break;
+        }
+      }
       compactions++;
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      status = WriteLevel0Table(&mem, 1, edit, nullptr, nullptr);
       mem->Unref();
       mem = nullptr;
       if (!status.ok()) {
@@ -466,6 +731,14 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     }
   }
 
+  if (replay != nullptr) {
+    Status s = replay->Finish();
+    MaybeIgnoreError(&s);
+    if (status.ok()) {
+      status = s;
+    }
+    delete replay;
+  }
   delete file;
 
   // See if we should keep reusing the last log file.
@@ -494,7 +767,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     // mem did not get reused; compact it.
     if (status.ok()) {
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      status = WriteLevel0Table(&mem, 1, edit, nullptr, nullptr);
     }
     mem->Unref();
   }
@@ -502,21 +775,38 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   return status;
 }
 
-Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-                                Version* base) {
+Status DBImpl::WriteLevel0Table(MemTable* const* mems, int n,
+                                VersionEdit* edit, Version* base,
+                                uint64_t* pending_output) {
   mutex_.AssertHeld();
+  assert(n > 0);
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
-  Iterator* iter = mem->NewIterator();
-  Log(options_.info_log, "Level-0 table #%llu: started",
-      (unsigned long long)meta.number);
+  Iterator* iter;
+  if (n == 1) {
+    iter = mems[0]->NewIterator();
+  } else {
+    std::vector<Iterator*> list(n);
+    for (int i = 0; i < n; i++) {
+      list[i] = mems[i]->NewIterator();
+    }
+    iter = NewMergingIterator(&internal_comparator_, &list[0], n);
+  }
+  Log(options_.info_log, "Level-0 table #%llu: started from %d memtables",
+      (unsigned long long)meta.number, n);
+
+  // The table may end up being placed at a higher level, but it is built
+  // before that level is known.
+  Options table_options = options_;
+  table_options.filter_policy = FilterPolicyForLevel(0);
+  table_options.compression = CompressionForLevel(options_, 0);
 
   Status s;
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, table_options, table_cache_, iter, &meta);
     mutex_.Lock();
   }
 
@@ -524,7 +814,11 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
       (unsigned long long)meta.number, (unsigned long long)meta.file_size,
       s.ToString().c_str());
   delete iter;
-  pending_outputs_.erase(meta.number);
+  if (pending_output != nullptr) {
+    *pending_output = meta.number;
+  } else {
+    pending_outputs_.erase(meta.number);
+  }
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
@@ -548,31 +842,47 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
 
 void DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
-  assert(imm_ != nullptr);
-
-  // Save the contents of the memtable as a new Table
+  assert(!imm_.empty());
+  assert(!imm_compaction_running_);
+  imm_compaction_running_ = true;
+
+  // Merge all the memtables queued so far into a single new Table.
+  // Memtables frozen while it is being written are left for the next
+  // compaction.
+  const size_t n = imm_.size();
+  std::vector<MemTable*> mems(n);
+  for (size_t i = 0; i < n; i++) {
+    mems[i] = imm_[i].mem;
+  }
+  const uint64_t next_log_number = imm_[n - 1].next_log_number;
   VersionEdit edit;
   Version* base = versions_->current();
   base->Ref();
-  Status s = WriteLevel0Table(imm_, &edit, base);
+  uint64_t file_number;
+  Status s = WriteLevel0Table(&mems[0], static_cast<int>(n), &edit, base,
+                              &file_number);
   base->Unref();
 
   if (s.ok() && shutting_down_.load(std::memory_order_acquire)) {
     s = Status::IOError("Deleting DB during memtable compaction");
   }
 
-  // Replace immutable memtable with the generated Table
+  // Replace immutable memtables with the generated Table
   if (s.ok()) {
     edit.SetPrevLogNumber(0);
-    edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
-    s = versions_->LogAndApply(&edit, &mutex_);
+    edit.SetLogNumber(next_log_number);  // Earlier logs no longer needed
+    s = LogAndApply(&edit);
   }
+  pending_outputs_.erase(file_number);
 
+  imm_compaction_running_ = false;
   if (s.ok()) {
     // Commit to the new state
-    imm_->Unref();
-    imm_ = nullptr;
-    has_imm_.store(false, std::memory_order_release);
+    for (size_t i = 0; i < n; i++) {
+      imm_.front().mem->Unref();
+      imm_.pop_front();
+    }
+    has_imm_.store(!imm_.empty(), std::memory_order_release);
     RemoveObsoleteFiles();
   } else {
     RecordBackgroundError(s);
@@ -641,10 +951,10 @@ Status DBImpl::TEST_CompactMemTable() {
   if (s.ok()) {
     // Wait until the compaction completes
     MutexLock l(&mutex_);
-    while (imm_ != nullptr && bg_error_.ok()) {
+    while (!imm_.empty() && bg_error_.ok()) {
       background_work_finished_signal_.Wait();
     }
-    if (imm_ != nullptr) {
+    if (!imm_.empty()) {
       s = bg_error_;
     }
   }
@@ -659,20 +969,41 @@ void DBImpl::RecordBackgroundError(const Status& s) {
   }
 }
 
+Status DBImpl::LogAndApply(VersionEdit* edit) {
+  mutex_.AssertHeld();
+  while (manifest_write_running_) {
+    manifest_write_finished_signal_.Wait();
+  }
+  manifest_write_running_ = true;
+  Status s = versions_->LogAndApply(edit, &mutex_);
+  manifest_write_running_ = false;
+  manifest_write_finished_signal_.Signal();
+  return s;
+}
+
 void DBImpl::MaybeScheduleCompaction() {
   mutex_.AssertHeld();
-  if (background_compaction_scheduled_) {
-    // Already scheduled
-  } else if (shutting_down_.load(std::memory_order_acquire)) {
+  if (shutting_down_.load(std::memory_order_acquire)) {
     // DB is being deleted; no more background compactions
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
-  } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
-             !versions_->NeedsCompaction()) {
-    // No work to be done
   } else {
-    background_compaction_scheduled_ = true;
-    env_->Schedule(&DBImpl::BGWork, this);
+    if (!imm_.empty() && !background_flush_scheduled_) {
+      // Memtable compactions get their own thread so that they are never
+      // stuck behind a long compaction of the on-disk levels.
+      background_flush_scheduled_ = true;
+      env_->Schedule(&DBImpl::BGFlushWork, this);
+    }
+    if (background_compactions_scheduled_ >=
+        options_.max_background_compactions) {
+      // Already scheduled as many as allowed
+    } else if (manual_compaction_ == nullptr &&
+               !versions_->NeedsCompaction()) {
+      // No work to be done
+    } else {
+      background_compactions_scheduled_++;
+      env_->Schedule(&DBImpl::BGWork, this);
+    }
   }
 }
 
@@ -680,37 +1011,64 @@ void DBImpl::BGWork(void* db) {
   reinterpret_cast<DBImpl*>(db)->BackgroundCall();
 }
 
+void DBImpl::BGFlushWork(void* db) {
+  reinterpret_cast<DBImpl*>(db)->BackgroundFlushCall();
+}
+
 void DBImpl::BackgroundCall() {
   MutexLock l(&mutex_);
-  assert(background_compaction_scheduled_);
+  assert(background_compactions_scheduled_ > 0);
+  bool made_progress = false;
   if (shutting_down_.load(std::memory_order_acquire)) {
     // No more background work when shutting down.
   } else if (!bg_error_.ok()) {
     // No more background work after a background error.
   } else {
-    BackgroundCompaction();
+    made_progress = BackgroundCompaction();
   }
 
-  background_compaction_scheduled_ = false;
+  background_compactions_scheduled_--;
 
   // Previous compaction may have produced too many files in a level,
-  // so reschedule another compaction if needed.
-  MaybeScheduleCompaction();
+  // so reschedule another compaction if needed.  A call that found
+  // nothing to do does not reschedule: the compactions it conflicted
+  // with will do so once they finish.
+  if (made_progress) {
+    MaybeScheduleCompaction();
+  }
   background_work_finished_signal_.SignalAll();
 }
 
-void DBImpl::BackgroundCompaction() {
-  mutex_.AssertHeld();
-
-  if (imm_ != nullptr) {
+void DBImpl::BackgroundFlushCall() {
+  MutexLock l(&mutex_);
+  assert(background_flush_scheduled_);
+  if (shutting_down_.load(std::memory_order_acquire)) {
+    // No more background work when shutting down.
+  } else if (!bg_error_.ok()) {
+    // No more background work after a background error.
+  } else if (!imm_.empty() && !imm_compaction_running_) {
     CompactMemTable();
-    return;
   }
 
+  background_flush_scheduled_ = false;
+
+  // The new level-0 file may call for a compaction.
+  MaybeScheduleCompaction();
+  background_work_finished_signal_.SignalAll();
+}
+
+bool DBImpl::BackgroundCompaction() {
+  mutex_.AssertHeld();
+
   Compaction* c;
   bool is_manual = (manual_compaction_ != nullptr);
   InternalKey manual_end;
   if (is_manual) {
+    if (running_compactions_ > 0) {
+      // Manual compactions run alone.  The running compactions will
+      // reschedule once they finish.
+      return false;
+    }
     ManualCompaction* m = manual_compaction_;
     c = versions_->CompactRange(m->level, m->begin, m->end);
     m->done = (c == nullptr);
@@ -724,8 +1082,13 @@ void DBImpl::BackgroundCompaction() {
         (m->done ? "(end)" : manual_end.DebugString().c_str()));
   } else {
     c = versions_->PickCompaction();
+    if (c == nullptr) {
+      return false;
+    }
+    // Another thread may find work that does not conflict with this one.
+    MaybeScheduleCompaction();
   }
-
+  running_compactions_++;
   Status status;
   if (c == nullptr) {
     // Nothing to do
@@ -736,7 +1099,7 @@ void DBImpl::BackgroundCompaction() {
     c->edit()->RemoveFile(c->level(), f->number);
     c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
                        f->largest);
-    status = versions_->LogAndApply(c->edit(), &mutex_);
+    status = LogAndApply(c->edit());
     if (!status.ok()) {
       RecordBackgroundError(status);
     }
@@ -747,7 +1110,11 @@ void DBImpl::BackgroundCompaction() {
         status.ToString().c_str(), versions_->LevelSummary(&tmp));
   } else {
     CompactionState* compact = new CompactionState(c);
+    merging_compactions_++;
+    peak_merging_compactions_ =
+        std::max(peak_merging_compactions_, merging_compactions_);
     status = DoCompactionWork(compact);
+    merging_compactions_--;
     if (!status.ok()) {
       RecordBackgroundError(status);
     }
@@ -756,6 +1123,7 @@ void DBImpl::BackgroundCompaction() {
     RemoveObsoleteFiles();
   }
   delete c;
+  running_compactions_--;
 
   if (status.ok()) {
     // Done
@@ -778,6 +1146,7 @@ void DBImpl::BackgroundCompaction() {
     }
     manual_compaction_ = nullptr;
   }
+  return true;
 }
 
 void DBImpl::CleanupCompaction(CompactionState* compact) {
@@ -801,8 +1170,13 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   assert(compact != nullptr);
   assert(compact->builder == nullptr);
   uint64_t file_number;
+  Options table_options = options_;
+  table_options.compression =
+      CompressionForLevel(options_, compact->compaction->level() + 1);
   {
     mutex_.Lock();
+    table_options.filter_policy =
+        FilterPolicyForLevel(compact->compaction->level() + 1);
     file_number = versions_->NewFileNumber();
     pending_outputs_.insert(file_number);
     CompactionState::Output out;
@@ -815,13 +1189,47 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
 
   // Make the output file
   std::string fname = TableFileName(dbname_, file_number);
-  Status s = env_->NewWritableFile(fname, &compact->outfile);
+  Status s;
+  if (options_.compaction_write_buffer_size > 0) {
+    s = env_->NewBufferedWritableFile(
+        fname, options_.compaction_write_buffer_size, &compact->outfile);
+  } else {
+    s = env_->NewWritableFile(fname, &compact->outfile);
+  }
+  if (s.ok() && options_.rate_limiter != nullptr) {
+    compact->outfile = NewRateLimitedWritableFile(
+        compact->outfile, options_.rate_limiter, RateLimiter::kLow);
+  }
   if (s.ok()) {
-    compact->builder = new TableBuilder(options_, compact->outfile);
+    compact->builder = new TableBuilder(table_options, compact->outfile);
   }
   return s;
 }
 
+const FilterPolicy* DBImpl::FilterPolicyForLevel(int level) {
+  mutex_.AssertHeld();
+  if (options_.filter_policy == nullptr) {
+    return nullptr;
+  }
+  uint64_t level_bytes[config::kNumLevels];
+  for (int i = 0; i < config::kNumLevels; i++) {
+    level_bytes[i] = versions_->NumLevelBytes(i);
+  }
+  const FilterPolicy* user_policy = internal_filter_policy_.user_policy();
+  const FilterPolicy* policy =
+      user_policy->PolicyForLevel(level, level_bytes, config::kNumLevels);
+  if (policy == user_policy) {
+    return options_.filter_policy;
+  }
+  InternalFilterPolicy*& wrapper = level_filter_policies_[policy];
+  if (wrapper == nullptr) {
+    wrapper = new InternalFilterPolicy(
+        policy, internal_filter_policy_.prefix_extractor(),
+        internal_filter_policy_.whole_key_filtering());
+  }
+  return wrapper;
+}
+
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
                                           Iterator* input) {
   assert(compact != nullptr);
@@ -886,7 +1294,7 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
     compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
                                          out.smallest, out.largest);
   }
-  return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+  return LogAndApply(compact->compaction->edit());
 }
 
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
@@ -907,12 +1315,106 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
   }
 
+  // Split large compactions into key ranges that are compacted in parallel.
+  // This thread compacts the first range.
+  std::vector<std::string> boundaries;
+  compact->compaction->SplitKeyRange(options_.max_subcompactions, &boundaries);
+  std::vector<Slice> boundary_keys(boundaries.begin(), boundaries.end());
+  std::vector<Subcompaction*> subcompactions;
+  for (size_t i = 0; i < boundary_keys.size(); i++) {
+    CompactionState* state = new CompactionState(compact->compaction);
+    state->smallest_snapshot = compact->smallest_snapshot;
+    Subcompaction* sub = new Subcompaction(this, state);
+    sub->input = versions_->MakeInputIterator(compact->compaction);
+    sub->begin = &boundary_keys[i];
+    if (i + 1 < boundary_keys.size()) {
+      sub->end = &boundary_keys[i + 1];
+    }
+    subcompactions.push_back(sub);
+  }
+  if (!subcompactions.empty()) {
+    Log(options_.info_log, "Compaction split into %d ranges",
+        static_cast<int>(subcompactions.size() + 1));
+  }
+
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
 
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
-  input->SeekToFirst();
+  for (size_t i = 0; i < subcompactions.size(); i++) {
+    env_->StartThread(&DBImpl::SubcompactionThread, subcompactions[i]);
+  }
+  Status status =
+      DoSubcompactionWork(compact, input, nullptr,
+                          boundary_keys.empty() ? nullptr : &boundary_keys[0],
+                          &imm_micros);
+  delete input;
+  input = nullptr;
+
+  // Collect the outputs of the other ranges, which follow ours in key order.
+  mutex_.Lock();
+  for (size_t i = 0; i < subcompactions.size(); i++) {
+    Subcompaction* sub = subcompactions[i];
+    while (!sub->done) {
+      background_work_finished_signal_.Wait();
+    }
+    if (status.ok()) {
+      status = sub->status;
+    }
+    CompactionState* state = sub->state;
+    compact->outputs.insert(compact->outputs.end(), state->outputs.begin(),
+                            state->outputs.end());
+    compact->total_bytes += state->total_bytes;
+    state->outputs.clear();
+    CleanupCompaction(state);
+    delete sub->input;
+    delete sub;
+  }
+
+  CompactionStats stats;
+  stats.micros = env_->NowMicros() - start_micros - imm_micros;
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+    }
+  }
+  for (size_t i = 0; i < compact->outputs.size(); i++) {
+    stats.bytes_written += compact->outputs[i].file_size;
+  }
+
+  stats_[compact->compaction->level() + 1].Add(stats);
+
+  if (status.ok()) {
+    status = InstallCompactionResults(compact);
+  }
+  if (!status.ok()) {
+    RecordBackgroundError(status);
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log, "compacted to: %s", versions_->LevelSummary(&tmp));
+  return status;
+}
+
+void DBImpl::SubcompactionThread(void* arg) {
+  Subcompaction* sub = reinterpret_cast<Subcompaction*>(arg);
+  DBImpl* db = sub->db;
+  sub->status = db->DoSubcompactionWork(sub->state, sub->input, sub->begin,
+                                        sub->end, &sub->imm_micros);
+  MutexLock l(&db->mutex_);
+  sub->done = true;
+  db->background_work_finished_signal_.SignalAll();
+}
+
+Status DBImpl::DoSubcompactionWork(CompactionState* compact, Iterator* input,
+                                   const Slice* begin, const Slice* end,
+                                   int64_t* imm_micros) {
+  if (begin == nullptr) {
+    input->SeekToFirst();
+  } else {
+    InternalKey start(*begin, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+  }
   Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
@@ -923,17 +1425,22 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     if (has_imm_.load(std::memory_order_relaxed)) {
       const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != nullptr) {
+      if (!imm_.empty() && !imm_compaction_running_) {
         CompactMemTable();
         // Wake up MakeRoomForWrite() if necessary.
         background_work_finished_signal_.SignalAll();
       }
       mutex_.Unlock();
-      imm_micros += (env_->NowMicros() - imm_start);
+      *imm_micros += (env_->NowMicros() - imm_start);
     }
 
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
+    if (end != nullptr &&
+        user_comparator()->Compare(ExtractUserKey(key), *end) >= 0) {
+      // Reached the start of the next range
+      break;
+    }
+    if (compact->compaction->ShouldStopBefore(key, &compact->position) &&
         compact->builder != nullptr) {
       status = FinishCompactionOutputFile(compact, input);
       if (!status.ok()) {
@@ -963,7 +1470,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         drop = true;  // (A)
       } else if (ikey.type == kTypeDeletion &&
                  ikey.sequence <= compact->smallest_snapshot &&
-                 compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+                 compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                                        &compact->position)) {
         // For this user key:
         // (1) there is no data in higher levels
         // (2) data in lower levels will have larger sequence numbers
@@ -982,7 +1490,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         "%d smallest_snapshot: %d",
         ikey.user_key.ToString().c_str(),
         (int)ikey.sequence, ikey.type, kTypeValue, drop,
-        compact->compaction->IsBaseLevelForKey(ikey.user_key),
+        compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                               &compact->position),
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
@@ -1022,32 +1531,66 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (status.ok()) {
     status = input->status();
   }
-  delete input;
-  input = nullptr;
+  return status;
+}
 
-  CompactionStats stats;
-  stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
-    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+void DBImpl::StartWarmUp() {
+  mutex_.AssertHeld();
+  assert(warm_up_pool_ == nullptr);
+
+  // Lower levels are read most often relative to their size, so they are
+  // opened first.  Files that would not fit in the table cache are left
+  // for the reads to open.
+  Version* v = versions_->current();
+  const size_t capacity = TableCacheSize(options_);
+  std::vector<FileMetaData*> files;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    v->GetOverlappingInputs(level, nullptr, nullptr, &files);
+    for (size_t i = 0; i < files.size(); i++) {
+      if (warm_up_files_.size() < capacity) {
+        warm_up_files_.push_back(files[i]);
+      }
     }
   }
-  for (size_t i = 0; i < compact->outputs.size(); i++) {
-    stats.bytes_written += compact->outputs[i].file_size;
+  if (warm_up_files_.empty()) {
+    return;
   }
 
-  mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
+  // Keep the files from being deleted until they have been opened.
+  warm_up_version_ = v;
+  warm_up_version_->Ref();
+  const int threads = static_cast<int>(std::min<size_t>(
+      options_.warm_up_threads, warm_up_files_.size()));
+  Log(options_.info_log, "Warming up %d tables on %d threads",
+      static_cast<int>(warm_up_files_.size()), threads);
+  warm_up_running_ = threads;
+  warm_up_pool_ = new ThreadPool(env_, threads);
+  for (int i = 0; i < threads; i++) {
+    warm_up_pool_->Schedule(&DBImpl::WarmUpWork, this);
+  }
+}
 
-  if (status.ok()) {
-    status = InstallCompactionResults(compact);
+void DBImpl::WarmUpWork(void* db) { reinterpret_cast<DBImpl*>(db)->WarmUp(); }
+
+void DBImpl::WarmUp() {
+  while (!shutting_down_.load(std::memory_order_acquire)) {
+    const size_t i = warm_up_next_.fetch_add(1, std::memory_order_relaxed);
+    if (i >= warm_up_files_.size()) {
+      break;
+    }
+    // Errors are left for the reads of the table to report.
+    FileMetaData* f = warm_up_files_[i];
+    table_cache_->Warm(f->number, f->file_size);
+    warm_up_opened_.fetch_add(1, std::memory_order_release);
   }
-  if (!status.ok()) {
-    RecordBackgroundError(status);
+
+  MutexLock l(&mutex_);
+  if (--warm_up_running_ == 0) {
+    Log(options_.info_log, "Warm-up opened %d tables",
+        static_cast<int>(warm_up_opened_.load(std::memory_order_acquire)));
+    warm_up_version_->Unref();
+    warm_up_version_ = nullptr;
   }
-  VersionSet::LevelSummaryStorage tmp;
-  Log(options_.info_log, "compacted to: %s", versions_->LevelSummary(&tmp));
-  return status;
 }
 
 namespace {
@@ -1055,18 +1598,28 @@ namespace {
 struct IterState {
   port::Mutex* const mu;
   Version* const version GUARDED_BY(mu);
-  MemTable* const mem GUARDED_BY(mu);
-  MemTable* const imm GUARDED_BY(mu);
+  std::vector<MemTable*> mems GUARDED_BY(mu);
 
-  IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
-      : mu(mutex), version(version), mem(mem), imm(imm) {}
+  IterState(port::Mutex* mutex, Version* version)
+      : mu(mutex), version(version) {}
+};
+
+// Orders indices into a vector of user keys by the keys they refer to.
+struct KeyIndexComparator {
+  const Comparator* ucmp;
+  const std::vector<Slice>* keys;
+
+  bool operator()(size_t a, size_t b) const {
+    return ucmp->Compare((*keys)[a], (*keys)[b]) < 0;
+  }
 };
 
 static void CleanupIteratorState(void* arg1, void* arg2) {
   IterState* state = reinterpret_cast<IterState*>(arg1);
   state->mu->Lock();
-  state->mem->Unref();
-  if (state->imm != nullptr) state->imm->Unref();
+  for (size_t i = 0; i < state->mems.size(); i++) {
+    state->mems[i]->Unref();
+  }
   state->version->Unref();
   state->mu->Unlock();
   delete state;
@@ -1074,6 +1627,17 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 
 }  // anonymous namespace
 
+void DBImpl::RefMemTables(std::vector<MemTable*>* mems) {
+  mutex_.AssertHeld();
+  mem_->Ref();
+  mems->push_back(mem_);
+  for (size_t i = imm_.size(); i > 0; i--) {
+    MemTable* imm = imm_[i - 1].mem;
+    imm->Ref();
+    mems->push_back(imm);
+  }
+}
+
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       SequenceNumber* latest_snapshot,
                                       uint32_t* seed) {
@@ -1081,19 +1645,16 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
   *latest_snapshot = versions_->LastSequence();
 
   // Collect together all needed child iterators
+  IterState* cleanup = new IterState(&mutex_, versions_->current());
+  RefMemTables(&cleanup->mems);
   std::vector<Iterator*> list;
-  list.push_back(mem_->NewIterator());
-  mem_->Ref();
-  if (imm_ != nullptr) {
-    list.push_back(imm_->NewIterator());
-    imm_->Ref();
+  for (size_t i = 0; i < cleanup->mems.size(); i++) {
+    list.push_back(cleanup->mems[i]->NewIterator());
   }
   versions_->current()->AddIterators(options, &list);
   Iterator* internal_iter =
       NewMergingIterator(&internal_comparator_, &list[0], list.size());
   versions_->current()->Ref();
-
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
 
   *seed = ++seed_;
@@ -1112,6 +1673,11 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
   return versions_->MaxNextLevelOverlappingBytes();
 }
 
+int DBImpl::TEST_PeakMergingCompactions() {
+  MutexLock l(&mutex_);
+  return peak_merging_compactions_;
+}
+
 Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
   Status s;
@@ -1124,11 +1690,9 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
     snapshot = versions_->LastSequence();
   }
 
-  MemTable* mem = mem_;
-  MemTable* imm = imm_;
+  std::vector<MemTable*> mems;
+  RefMemTables(&mems);
   Version* current = versions_->current();
-  mem->Ref();
-  if (imm != nullptr) imm->Ref();
   current->Ref();
 
   bool have_stat_update = false;
@@ -1137,13 +1701,14 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   // Unlock while reading from files and memtables
   {
     mutex_.Unlock();
-    // First look in the memtable, then in the immutable memtable (if any).
+    // First look in the memtable, then in the immutable memtables (if
+    // any), newest first.
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done
-    } else {
+    bool done = false;
+    for (size_t i = 0; i < mems.size() && !done; i++) {
+      done = mems[i]->Get(lkey, value, &s);
+    }
+    if (!done) {
       s = current->Get(options, lkey, value, &stats);
       have_stat_update = true;
     }
@@ -1153,16 +1718,110 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   if (have_stat_update && current->UpdateStats(stats)) {
     MaybeScheduleCompaction();
   }
-  mem->Unref();
-  if (imm != nullptr) imm->Unref();
+  for (size_t i = 0; i < mems.size(); i++) {
+    mems[i]->Unref();
+  }
   current->Unref();
   return s;
 }
 
+void DBImpl::MultiGet(const ReadOptions& options,
+                      const std::vector<Slice>& keys,
+                      std::vector<std::string>* values,
+                      std::vector<Status>* statuses) {
+  const size_t n = keys.size();
+  values->resize(n);
+  statuses->assign(n, Status());
+
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != nullptr) {
+    snapshot =
+        static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  std::vector<MemTable*> mems;
+  RefMemTables(&mems);
+  Version* current = versions_->current();
+  current->Ref();
+
+  std::vector<Version::GetStats> stats;
+
+  // Unlock while reading from files and memtables
+  {
+    mutex_.Unlock();
+
+    // Visit the keys in sorted order so that the keys falling into the
+    // same table (and the same block within it) are handled together.
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) order[i] = i;
+    const Comparator* ucmp = user_comparator();
+    KeyIndexComparator cmp;
+    cmp.ucmp = ucmp;
+    cmp.keys = &keys;
+    std::stable_sort(order.begin(), order.end(), cmp);
+
+    std::vector<LookupKey*> lkeys(n);
+    std::vector<const LookupKey*> table_keys;
+    std::vector<std::string*> table_values;
+    std::vector<size_t> table_index;
+    for (size_t j = 0; j < n; j++) {
+      const size_t i = order[j];
+      lkeys[i] = new LookupKey(keys[i], snapshot);
+      Status* s = &(*statuses)[i];
+      std::string* value = &(*values)[i];
+      // First look in the memtable, then in the immutable memtables (if
+      // any), newest first.
+      bool done = false;
+      for (size_t m = 0; m < mems.size() && !done; m++) {
+        done = mems[m]->Get(*lkeys[i], value, s);
+      }
+      if (!done) {
+        table_keys.push_back(lkeys[i]);
+        table_values.push_back(value);
+        table_index.push_back(i);
+      }
+    }
+
+    if (!table_keys.empty()) {
+      std::vector<Status> table_statuses;
+      current->MultiGet(options, table_keys, table_values, &table_statuses,
+                        &stats);
+      for (size_t j = 0; j < table_index.size(); j++) {
+        (*statuses)[table_index[j]] = table_statuses[j];
+      }
+    }
+    for (size_t i = 0; i < n; i++) {
+      delete lkeys[i];
+    }
+    mutex_.Lock();
+  }
+
+  bool schedule = false;
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (current->UpdateStats(stats[i])) {
+      schedule = true;
+    }
+  }
+  if (schedule) {
+    MaybeScheduleCompaction();
+  }
+  for (size_t i = 0; i < mems.size(); i++) {
+    mems[i]->Unref();
+  }
+  current->Unref();
+}
+
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
   Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
+  if (!options.prefix.empty()) {
+    iter = NewPrefixIterator(iter, user_comparator(), options_.prefix_extractor,
+                             options.prefix);
+  }
   return NewDBIterator(this, user_comparator(), iter,
                        (options.snapshot != nullptr
                             ? static_cast<const SnapshotImpl*>(options.snapshot)
@@ -1205,12 +1864,35 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
 
   MutexLock l(&mutex_);
   writers_.push_back(&w);
-  while (!w.done && &w != writers_.front()) {
+  while (!w.done && w.leader == nullptr && &w != writers_.front()) {
     w.cv.Wait();
   }
   if (w.done) {
     return w.status;
   }
+  if (w.leader != nullptr) {
+    // Our group has been logged; apply our batch alongside the others.
+    // mem_ is not replaced while the group is in the memtable stage.
+    MemTable* mem = mem_;
+    mutex_.Unlock();
+    Status s = WriteBatchInternal::InsertIntoConcurrently(updates, mem);
+    mutex_.Lock();
+    Writer* leader = w.leader;
+    if (!s.ok() && leader->status.ok()) {
+      leader->status = s;
+    }
+    if (--leader->pending_inserts == 0) {
+      leader->cv.Signal();
+    }
+    while (!w.done) {
+      w.cv.Wait();
+    }
+    return w.status;
+  }
+  if (options_.enable_pipelined_write ||
+      options_.allow_concurrent_memtable_write) {
+    return PipelinedWrite(&w);
+  }
 
   // May temporarily unlock and wait.
   Status status = MakeRoomForWrite(updates == nullptr);
@@ -1220,6 +1902,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     WriteBatch* write_batch = BuildBatchGroup(&last_writer);
     WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
     last_sequence += WriteBatchInternal::Count(write_batch);
+    write_controller_.Charge(WriteBatchInternal::ByteSize(write_batch));
 
     // Add to log and apply to memtable.  We can release the lock
     // during this phase since &w is currently responsible for logging
@@ -1270,6 +1953,134 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   return status;
 }
 
+Status DBImpl::PipelinedWrite(Writer* w) {
+  mutex_.AssertHeld();
+  assert(w == writers_.front());
+
+  // May temporarily unlock and wait.
+  Status status = MakeRoomForWrite(w->batch == nullptr);
+
+  // Sequence numbers are handed out past those of the groups that are
+  // still waiting to be applied to the memtable.
+  uint64_t last_sequence = memtable_writers_.empty()
+                               ? versions_->LastSequence()
+                               : memtable_writers_.back()->last_sequence;
+  Writer* last_writer = w;
+  const bool has_batch = status.ok() && w->batch != nullptr;
+  if (has_batch) {
+    WriteBatch* write_batch = BuildBatchGroup(&last_writer);
+    WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
+    write_controller_.Charge(WriteBatchInternal::ByteSize(write_batch));
+
+    // The batches of the group are applied one by one in the memtable
+    // stage, after the next group may have reused tmp_batch_, so give
+    // each of them its share of the sequence numbers.
+    for (std::deque<Writer*>::iterator iter = writers_.begin();; ++iter) {
+      Writer* writer = *iter;
+      if (writer->batch != nullptr) {
+        WriteBatchInternal::SetSequence(writer->batch, last_sequence + 1);
+        last_sequence += WriteBatchInternal::Count(writer->batch);
+      }
+      if (writer == last_writer) break;
+    }
+
+    // Only this thread writes to the log until the group is handed over
+    // to the memtable stage below.
+    {
+      mutex_.Unlock();
+      status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+      if (status.ok() && w->sync) {
+        status = logfile_->Sync();
+      }
+      mutex_.Lock();
+      if (!status.ok()) {
+        // The state of the log file is indeterminate: the log record we
+        // just added, or part of it, may or may not show up when the DB is
+        // re-opened.  Its sequence numbers are still published below so
+        // that no later batch reuses them, and we force the DB into a mode
+        // where all future writes fail.
+        RecordBackgroundError(status);
+      }
+    }
+    if (write_batch == tmp_batch_) tmp_batch_->Clear();
+  }
+  w->last_sequence = last_sequence;
+
+  // Hand the group over to the memtable stage, and let the next group
+  // write to the log while this one is applied.
+  std::vector<Writer*> group;
+  while (true) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    group.push_back(ready);
+    if (ready == last_writer) break;
+  }
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+  memtable_writers_.push_back(w);
+
+  // Groups are applied in the order of their sequence numbers, so that
+  // each of them can publish its last sequence number when it is done.
+  while (w != memtable_writers_.front()) {
+    w->cv.Wait();
+  }
+  if (status.ok() && w->batch != nullptr) {
+    // mem_ is not replaced while memtable_writers_ is non-empty.
+    MemTable* mem = mem_;
+    if (options_.allow_concurrent_memtable_write && group.size() > 1) {
+      // Every writer of the group inserts its own batch.
+      for (size_t i = 1; i < group.size(); i++) {
+        if (group[i]->batch != nullptr) {
+          group[i]->leader = w;
+          w->pending_inserts++;
+          group[i]->cv.Signal();
+        }
+      }
+      mutex_.Unlock();
+      status = WriteBatchInternal::InsertIntoConcurrently(w->batch, mem);
+      mutex_.Lock();
+      while (w->pending_inserts > 0) {
+        w->cv.Wait();
+      }
+      if (status.ok()) {
+        status = w->status;
+      }
+    } else {
+      mutex_.Unlock();
+      for (size_t i = 0; i < group.size() && status.ok(); i++) {
+        if (group[i]->batch != nullptr) {
+          status = WriteBatchInternal::InsertInto(group[i]->batch, mem);
+        }
+      }
+      mutex_.Lock();
+    }
+  }
+  if (has_batch) {
+    versions_->SetLastSequence(last_sequence);
+  }
+  memtable_writers_.pop_front();
+
+  for (size_t i = 0; i < group.size(); i++) {
+    Writer* ready = group[i];
+    if (ready != w) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.Signal();
+    }
+  }
+
+  // Notify the next group of the memtable stage, or a writer waiting in
+  // MakeRoomForWrite() to switch memtables.
+  if (!memtable_writers_.empty()) {
+    memtable_writers_.front()->cv.Signal();
+  } else {
+    background_work_finished_signal_.SignalAll();
+  }
+
+  return status;
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-null batch
 WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
@@ -1332,31 +2143,52 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // Yield previous error
       s = bg_error_;
       break;
-    } else if (allow_delay && versions_->NumLevelFiles(0) >=
-                                  config::kL0_SlowdownWritesTrigger) {
-      // We are getting close to hitting a hard limit on the number of
-      // L0 files.  Rather than delaying a single write by several
-      // seconds when we hit the hard limit, start delaying each
-      // individual write by 1ms to reduce latency variance.  Also,
-      // this delay hands over some CPU to the compaction thread in
-      // case it is sharing the same core as the writer.
-      mutex_.Unlock();
-      env_->SleepForMicroseconds(1000);
+    } else if (allow_delay) {
+      // We may be getting close to hitting a hard limit on the number of
+      // L0 files, or compactions may be falling behind.  Rather than
+      // delaying a single write by several seconds when we hit the hard
+      // limit, admit writes at a rate that drops as compactions fall
+      // further behind, to reduce latency variance.  Also, this delay
+      // hands over some CPU to the compaction threads in case they are
+      // sharing the same cores as the writers.
       allow_delay = false;  // Do not delay a single write more than once
-      mutex_.Lock();
+      //
+      // The delay can be long at low rates, so it is slept in short
+      // slices: the write goes ahead as soon as compactions catch up, and
+      // stops waiting on shutdown or a background error.
+      while (bg_error_.ok() &&
+             !shutting_down_.load(std::memory_order_acquire)) {
+        const uint64_t now_micros = env_->NowMicros();
+        write_controller_.Update(versions_->NumLevelFiles(0),
+                                 versions_->CompactionDebt(), now_micros);
+        const uint64_t delay = std::min(write_controller_.GetDelay(now_micros),
+                                        kWriteDelaySliceMicros);
+        if (delay == 0) {
+          break;
+        }
+        write_delay_micros_ += delay;
+        mutex_.Unlock();
+        env_->SleepForMicroseconds(static_cast<int>(delay));
+        mutex_.Lock();
+      }
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
       break;
-    } else if (imm_ != nullptr) {
+    } else if (imm_.size() + 1 >=
+               static_cast<size_t>(options_.max_write_buffer_number)) {
       // We have filled up the current memtable, but the previous
-      // one is still being compacted, so we wait.
+      // ones are still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
       background_work_finished_signal_.Wait();
     } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
       background_work_finished_signal_.Wait();
+    } else if (!memtable_writers_.empty()) {
+      // Earlier write groups have been logged but are still being applied
+      // to mem_.  Wait for them so that mem_ holds everything in the log.
+      background_work_finished_signal_.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
@@ -1373,7 +2205,10 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       logfile_ = lfile;
       logfile_number_ = new_log_number;
       log_ = new log::Writer(lfile);
-      imm_ = mem_;
+      ImmutableMemTable imm;
+      imm.mem = mem_;
+      imm.next_log_number = new_log_number;
+      imm_.push_back(imm);
       has_imm_.store(true, std::memory_order_release);
       mem_ = new MemTable(internal_comparator_);
       mem_->Ref();
@@ -1428,13 +2263,50 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "compaction-debt") {
+    char buf[50];
+    std::snprintf(buf, sizeof(buf), "%llu",
+                  static_cast<unsigned long long>(versions_->CompactionDebt()));
+    value->append(buf);
+    return true;
+  } else if (in == "delayed-write-rate") {
+    char buf[50];
+    std::snprintf(
+        buf, sizeof(buf), "%llu",
+        static_cast<unsigned long long>(write_controller_.delayed_write_rate()));
+    value->append(buf);
+    return true;
+  } else if (in == "write-delay-micros") {
+    char buf[50];
+    std::snprintf(buf, sizeof(buf), "%llu",
+                  static_cast<unsigned long long>(write_delay_micros_));
+    value->append(buf);
+    return true;
+  } else if (in == "warm-up-tables") {
+    char buf[50];
+    std::snprintf(buf, sizeof(buf), "%d",
+                  static_cast<int>(warm_up_files_.size()));
+    value->append(buf);
+    return true;
+  } else if (in == "warm-up-tables-opened") {
+    char buf[50];
+    std::snprintf(
+        buf, sizeof(buf), "%d",
+        static_cast<int>(warm_up_opened_.load(std::memory_order_acquire)));
+    value->append(buf);
+    return true;
+  } else if (in == "num-immutable-mem-table") {
+    char buf[50];
+    std::snprintf(buf, sizeof(buf), "%d", static_cast<int>(imm_.size()));
+    value->append(buf);
+    return true;
   } else if (in == "approximate-memory-usage") {
     size_t total_usage = options_.block_cache->TotalCharge();
     if (mem_) {
       total_usage += mem_->ApproximateMemoryUsage();
     }
-    if (imm_) {
-      total_usage += imm_->ApproximateMemoryUsage();
+    for (size_t i = 0; i < imm_.size(); i++) {
+      total_usage += imm_[i].mem->ApproximateMemoryUsage();
     }
     char buf[50];
     std::snprintf(buf, sizeof(buf), "%llu",
@@ -1478,6 +2350,23 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+void DB::MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                  std::vector<std::string>* values,
+                  std::vector<Status>* statuses) {
+  values->resize(keys.size());
+  statuses->resize(keys.size());
+  ReadOptions opt = options;
+  if (options.snapshot == nullptr) {
+    opt.snapshot = GetSnapshot();
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    (*statuses)[i] = Get(opt, keys[i], &(*values)[i]);
+  }
+  if (options.snapshot == nullptr) {
+    ReleaseSnapshot(opt.snapshot);
+  }
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
@@ -1512,6 +2401,9 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
   if (s.ok()) {
     impl->RemoveObsoleteFiles();
     impl->MaybeScheduleCompaction();
+    if (options.warm_up_threads > 0) {
+      impl->StartWarmUp();
+    }
   }
   impl->mutex_.Unlock();
   if (s.ok()) {
@@ -7,12 +7,15 @@
 
 #include <atomic>
 #include <deque>
+#include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
+#include "db/write_controller.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "port/port.h"
@@ -20,8 +23,10 @@
 
 namespace leveldb {
 
+struct FileMetaData;
 class MemTable;
 class TableCache;
+class ThreadPool;
 class Version;
 class VersionEdit;
 class VersionSet;
@@ -42,6 +47,9 @@ class DBImpl : public DB {
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
+  void MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                std::vector<std::string>* values,
+                std::vector<Status>* statuses) override;
   Iterator* NewIterator(const ReadOptions&) override;
   const Snapshot* GetSnapshot() override;
   void ReleaseSnapshot(const Snapshot* snapshot) override;
@@ -66,6 +74,10 @@ class DBImpl : public DB {
   // file at a level >= 1.
   int64_t TEST_MaxNextLevelOverlappingBytes();
 
+  // Return the largest number of compactions that have been merging
+  // files at the same time since the DB was opened.
+  int TEST_PeakMergingCompactions();
+
   // Record a sample of bytes read at the specified internal key.
   // Samples are taken approximately once every config::kReadBytesPeriod
   // bytes.
@@ -74,6 +86,7 @@ class DBImpl : public DB {
  private:
   friend class DB;
   struct CompactionState;
+  struct Subcompaction;
   struct Writer;
 
   // Information for a manual compaction
@@ -101,6 +114,14 @@ class DBImpl : public DB {
     int64_t bytes_written;
   };
 
+  // A memtable that is full and waiting to be written to a level-0 table.
+  struct ImmutableMemTable {
+    MemTable* mem;
+    // Number of the log file that was started when mem was frozen.  Once
+    // mem has been written, older log files are no longer needed.
+    uint64_t next_log_number;
+  };
+
   Iterator* NewInternalIterator(const ReadOptions&,
                                 SequenceNumber* latest_snapshot,
                                 uint32_t* seed);
@@ -118,16 +139,27 @@ class DBImpl : public DB {
   // Delete any unneeded files and stale in-memory entries.
   void RemoveObsoleteFiles() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  // Compact the in-memory write buffer to disk.  Switches to a new
-  // log-file/memtable and writes a new descriptor iff successful.
-  // Errors are recorded in bg_error_.
+  // Compact the immutable memtables to a single level-0 table.  Writes a
+  // new descriptor and drops the memtables iff successful.  Errors are
+  // recorded in bg_error_.
   void CompactMemTable() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Ref mem_ and the immutable memtables and append them to *mems,
+  // newest first.
+  void RefMemTables(std::vector<MemTable*>* mems)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   Status RecoverLogFile(uint64_t log_number, bool last_log, bool* save_manifest,
                         VersionEdit* edit, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
+  // Write the merged contents of mems[0,n-1] to a new level-0 table and
+  // record it in *edit.  If pending_output is non-null, the number of the
+  // new table is stored there and left in pending_outputs_ so that
+  // concurrent calls to RemoveObsoleteFiles() keep the file until *edit
+  // has been applied; the caller must then erase it.
+  Status WriteLevel0Table(MemTable* const* mems, int n, VersionEdit* edit,
+                          Version* base, uint64_t* pending_output)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
@@ -135,17 +167,45 @@ class DBImpl : public DB {
   WriteBatch* BuildBatchGroup(Writer** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Write path used with options_.enable_pipelined_write.  The group led
+  // by *w is logged, then applied to the memtable while the next group
+  // is being logged.
+  // REQUIRES: *w is at the front of writers_
+  Status PipelinedWrite(Writer* w) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   void RecordBackgroundError(const Status& s);
 
+  // Apply *edit to the current version.  Unlike VersionSet::LogAndApply(),
+  // may be called from several background threads at once.
+  Status LogAndApply(VersionEdit* edit) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   static void BGWork(void* db);
+  static void BGFlushWork(void* db);
   void BackgroundCall();
-  void BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void BackgroundFlushCall();
+  // Returns false if there was no compaction that could be run.
+  bool BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void CleanupCompaction(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Compact the keys of *input that belong to [*begin,*end) into the
+  // outputs of *compact.  A null begin or end means the range is unbounded
+  // on that side.  Called without mutex_ held; may run concurrently for
+  // disjoint ranges of the same compaction.
+  Status DoSubcompactionWork(CompactionState* compact, Iterator* input,
+                             const Slice* begin, const Slice* end,
+                             int64_t* imm_micros);
+  static void SubcompactionThread(void* arg);
+
+  // Start opening the tables of the current version on warm_up_pool_
+  // (see Options::warm_up_threads).
+  void StartWarmUp() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static void WarmUpWork(void* db);
+  void WarmUp();
+
   Status OpenCompactionOutputFile(CompactionState* compact);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
   Status InstallCompactionResults(CompactionState* compact)
@@ -155,6 +215,11 @@ class DBImpl : public DB {
     return internal_comparator_.user_comparator();
   }
 
+  // Returns the filter policy for new tables at the specified level,
+  // given the current sizes of the levels.
+  const FilterPolicy* FilterPolicyForLevel(int level)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Constant after construction
   Env* const env_;
   const InternalKeyComparator internal_comparator_;
@@ -162,6 +227,8 @@ class DBImpl : public DB {
   const Options options_;  // options_.comparator == &internal_comparator_
   const bool owns_info_log_;
   const bool owns_cache_;
+  const bool owns_compression_scheduler_;
+  const bool owns_prefetch_scheduler_;
   const std::string dbname_;
 
   // table_cache_ provides its own synchronization
@@ -175,8 +242,9 @@ class DBImpl : public DB {
   std::atomic<bool> shutting_down_;
   port::CondVar background_work_finished_signal_ GUARDED_BY(mutex_);
   MemTable* mem_;
-  MemTable* imm_ GUARDED_BY(mutex_);  // Memtable being compacted
-  std::atomic<bool> has_imm_;         // So bg thread can detect non-null imm_
+  // Memtables waiting to be compacted, oldest first.
+  std::deque<ImmutableMemTable> imm_ GUARDED_BY(mutex_);
+  std::atomic<bool> has_imm_;  // So bg thread can detect non-empty imm_
   WritableFile* logfile_;
   uint64_t logfile_number_ GUARDED_BY(mutex_);
   log::Writer* log_;
@@ -184,6 +252,10 @@ class DBImpl : public DB {
 
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
+
+  // Leaders of the write groups that have been logged but not yet applied
+  // to the memtable, in sequence number order (pipelined writes only).
+  std::deque<Writer*> memtable_writers_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
   SnapshotList snapshots_ GUARDED_BY(mutex_);
@@ -192,8 +264,26 @@ class DBImpl : public DB {
   // part of ongoing compactions.
   std::set<uint64_t> pending_outputs_ GUARDED_BY(mutex_);
 
-  // Has a background compaction been scheduled or is running?
-  bool background_compaction_scheduled_ GUARDED_BY(mutex_);
+  // Number of background compactions that are scheduled or running.
+  int background_compactions_scheduled_ GUARDED_BY(mutex_);
+
+  // Number of background compactions that picked some work.
+  int running_compactions_ GUARDED_BY(mutex_);
+
+  // Number of running compactions that merge files rather than move one,
+  // and the largest value it has reached.
+  int merging_compactions_ GUARDED_BY(mutex_);
+  int peak_merging_compactions_ GUARDED_BY(mutex_);
+
+  // Has a background memtable compaction been scheduled or is running?
+  bool background_flush_scheduled_ GUARDED_BY(mutex_);
+
+  // Is some thread writing imm_ to a table file?
+  bool imm_compaction_running_ GUARDED_BY(mutex_);
+
+  // Is some thread writing to the MANIFEST?
+  bool manifest_write_running_ GUARDED_BY(mutex_);
+  port::CondVar manifest_write_finished_signal_ GUARDED_BY(mutex_);
 
   ManualCompaction* manual_compaction_ GUARDED_BY(mutex_);
 
@@ -203,6 +293,28 @@ class DBImpl : public DB {
   Status bg_error_ GUARDED_BY(mutex_);
 
   CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
+
+  // Throttles writes while compactions are falling behind.
+  WriteController write_controller_ GUARDED_BY(mutex_);
+
+  // Total time writes have been delayed by write_controller_.
+  uint64_t write_delay_micros_ GUARDED_BY(mutex_);
+
+  // Threads that open the tables of warm_up_version_ after Open(), or null
+  // if no warm-up was started.  warm_up_files_ is filled in before the
+  // threads start, and is claimed one file at a time through
+  // warm_up_next_.  The last thread to finish releases warm_up_version_.
+  ThreadPool* warm_up_pool_;
+  Version* warm_up_version_ GUARDED_BY(mutex_);
+  std::vector<FileMetaData*> warm_up_files_;
+  std::atomic<size_t> warm_up_next_;
+  std::atomic<size_t> warm_up_opened_;
+  int warm_up_running_ GUARDED_BY(mutex_);
+
+  // Wrappers for the per-level policies returned by the user's filter
+  // policy, keyed by the user policy they wrap.
+  std::map<const FilterPolicy*, InternalFilterPolicy*> level_filter_policies_
+      GUARDED_BY(mutex_);
 };
 
 // Sanitize db options.  The caller should delete result.info_log if
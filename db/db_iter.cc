@@ -307,6 +307,92 @@ void DBIter::SeekToLast() {
   FindPrevUserEntry();
 }
 
+// An internal iterator that only yields the entries of "iter_" whose
+// user keys have a given prefix (see ReadOptions::prefix).  Those entries
+// are contiguous, so the iterator is invalid once it leaves them.
+class PrefixIter : public Iterator {
+ public:
+  PrefixIter(Iterator* iter, const Comparator* user_comparator,
+             const PrefixExtractor* extractor, const Slice& prefix)
+      : iter_(iter),
+        user_comparator_(user_comparator),
+        extractor_(extractor),
+        prefix_(prefix.data(), prefix.size()),
+        prefix_key_(prefix_, kMaxSequenceNumber, kValueTypeForSeek),
+        valid_(false) {}
+
+  PrefixIter(const PrefixIter&) = delete;
+  PrefixIter& operator=(const PrefixIter&) = delete;
+
+  ~PrefixIter() override { delete iter_; }
+
+  bool Valid() const override { return valid_; }
+  Slice key() const override {
+    assert(valid_);
+    return iter_->key();
+  }
+  Slice value() const override {
+    assert(valid_);
+    return iter_->value();
+  }
+  Status status() const override { return iter_->status(); }
+
+  void Next() override {
+    assert(valid_);
+    iter_->Next();
+    Update();
+  }
+  void Prev() override {
+    assert(valid_);
+    iter_->Prev();
+    Update();
+  }
+
+  void Seek(const Slice& target) override {
+    if (user_comparator_->Compare(ExtractUserKey(target), prefix_) < 0) {
+      iter_->Seek(prefix_key_.Encode());
+    } else {
+      iter_->Seek(target);
+    }
+    Update();
+  }
+
+  void SeekToFirst() override {
+    iter_->Seek(prefix_key_.Encode());
+    Update();
+  }
+
+  void SeekToLast() override {
+    // There is no key to seek to just past the entries with the prefix,
+    // so scan forward through them.
+    iter_->Seek(prefix_key_.Encode());
+    while (iter_->Valid() && HasPrefix()) {
+      iter_->Next();
+    }
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+    Update();
+  }
+
+ private:
+  bool HasPrefix() const {
+    return UserKeyHasPrefix(extractor_, ExtractUserKey(iter_->key()),
+                            prefix_);
+  }
+
+  void Update() { valid_ = iter_->Valid() && HasPrefix(); }
+
+  Iterator* const iter_;
+  const Comparator* const user_comparator_;
+  const PrefixExtractor* const extractor_;
+  const std::string prefix_;
+  const InternalKey prefix_key_;
+  bool valid_;
+};
+
 }  // anonymous namespace
 
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
@@ -315,4 +401,11 @@ Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
   return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
 }
 
+Iterator* NewPrefixIterator(Iterator* internal_iter,
+                            const Comparator* user_key_comparator,
+                            const PrefixExtractor* extractor,
+                            const Slice& prefix) {
+  return new PrefixIter(internal_iter, user_key_comparator, extractor, prefix);
+}
+
 }  // namespace leveldb
@@ -21,6 +21,14 @@ Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
                         uint32_t seed);
 
+// Return a new iterator over the entries of "*internal_iter" whose user
+// keys have the specified prefix (see ReadOptions::prefix).  Takes
+// ownership of "internal_iter".
+Iterator* NewPrefixIterator(Iterator* internal_iter,
+                            const Comparator* user_key_comparator,
+                            const PrefixExtractor* extractor,
+                            const Slice& prefix);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_DB_DB_ITER_H_
@@ -16,6 +16,8 @@
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/prefix_extractor.h"
+#include "leveldb/rate_limiter.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -118,6 +120,20 @@ class SpecialEnv : public EnvWrapper {
   // Force write to manifest files to fail while this pointer is non-null.
   std::atomic<bool> manifest_write_error_;
 
+  // Force flushes of log files to fail, after the data reached the file.
+  std::atomic<bool> log_flush_error_;
+
+  // Reads through readahead files, which only compactions use, are
+  // blocked while this is true.
+  std::atomic<bool> delay_readahead_reads_;
+
+  // While non-zero, NowMicros() returns this instead of the time, and
+  // SleepForMicroseconds() advances it instead of sleeping.
+  std::atomic<uint64_t> fake_now_micros_;
+
+  // Longest sleep requested from SleepForMicroseconds() on the fake clock.
+  std::atomic<int> max_fake_sleep_micros_;
+
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
 
@@ -129,6 +145,10 @@ class SpecialEnv : public EnvWrapper {
         non_writable_(false),
         manifest_sync_error_(false),
         manifest_write_error_(false),
+        log_flush_error_(false),
+        delay_readahead_reads_(false),
+        fake_now_micros_(0),
+        max_fake_sleep_micros_(0),
         count_random_reads_(false) {}
 
   Status NewWritableFile(const std::string& f, WritableFile** r) {
@@ -136,9 +156,11 @@ class SpecialEnv : public EnvWrapper {
      private:
       SpecialEnv* const env_;
       WritableFile* const base_;
+      const bool log_;
 
      public:
-      DataFile(SpecialEnv* env, WritableFile* base) : env_(env), base_(base) {}
+      DataFile(SpecialEnv* env, WritableFile* base, bool log)
+          : env_(env), base_(base), log_(log) {}
       ~DataFile() { delete base_; }
       Status Append(const Slice& data) {
         if (env_->no_space_.load(std::memory_order_acquire)) {
@@ -149,7 +171,14 @@ class SpecialEnv : public EnvWrapper {
         }
       }
       Status Close() { return base_->Close(); }
-      Status Flush() { return base_->Flush(); }
+      Status Flush() {
+        Status s = base_->Flush();
+        if (s.ok() && log_ &&
+            env_->log_flush_error_.load(std::memory_order_acquire)) {
+          return Status::IOError("simulated log flush error");
+        }
+        return s;
+      }
       Status Sync() {
         if (env_->data_sync_error_.load(std::memory_order_acquire)) {
           return Status::IOError("simulated data sync error");
@@ -194,7 +223,7 @@ class SpecialEnv : public EnvWrapper {
     if (s.ok()) {
       if (strstr(f.c_str(), ".ldb") != nullptr ||
           strstr(f.c_str(), ".log") != nullptr) {
-        *r = new DataFile(this, *r);
+        *r = new DataFile(this, *r, strstr(f.c_str(), ".log") != nullptr);
       } else if (strstr(f.c_str(), "MANIFEST") != nullptr) {
         *r = new ManifestFile(this, *r);
       }
@@ -225,6 +254,50 @@ class SpecialEnv : public EnvWrapper {
     }
     return s;
   }
+
+  Status NewReadaheadRandomAccessFile(const std::string& f, size_t n,
+                                      RandomAccessFile** r) {
+    class DelayedFile : public RandomAccessFile {
+     private:
+      SpecialEnv* env_;
+      RandomAccessFile* target_;
+
+     public:
+      DelayedFile(SpecialEnv* env, RandomAccessFile* target)
+          : env_(env), target_(target) {}
+      ~DelayedFile() override { delete target_; }
+      Status Read(uint64_t offset, size_t n, Slice* result,
+                  char* scratch) const override {
+        while (env_->delay_readahead_reads_.load(std::memory_order_acquire)) {
+          DelayMilliseconds(10);
+        }
+        return target_->Read(offset, n, result, scratch);
+      }
+    };
+
+    Status s = target()->NewReadaheadRandomAccessFile(f, n, r);
+    if (s.ok()) {
+      *r = new DelayedFile(this, *r);
+    }
+    return s;
+  }
+
+  uint64_t NowMicros() override {
+    const uint64_t fake = fake_now_micros_.load(std::memory_order_acquire);
+    return fake != 0 ? fake : target()->NowMicros();
+  }
+
+  void SleepForMicroseconds(int micros) override {
+    if (fake_now_micros_.load(std::memory_order_acquire) == 0) {
+      target()->SleepForMicroseconds(micros);
+      return;
+    }
+    fake_now_micros_.fetch_add(micros, std::memory_order_acq_rel);
+    int max = max_fake_sleep_micros_.load(std::memory_order_relaxed);
+    while (micros > max && !max_fake_sleep_micros_.compare_exchange_weak(
+                               max, micros, std::memory_order_relaxed)) {
+    }
+  }
 };
 
 class DBTest : public testing::Test {
@@ -276,6 +349,26 @@ class DBTest : public testing::Test {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kPipelinedWrite:
+        options.enable_pipelined_write = true;
+        break;
+      case kConcurrentMemTableWrite:
+        options.allow_concurrent_memtable_write = true;
+        break;
+      case kPartitionedIndex:
+        options.filter_policy = filter_policy_;
+        options.partition_index_and_filters = true;
+        break;
+      case kWholeTableFilter:
+        options.filter_policy = filter_policy_;
+        options.whole_table_filter = true;
+        break;
+      case kDataBlockHashIndex:
+        options.data_block_hash_index = true;
+        break;
+      case kMultipleWriteBuffers:
+        options.max_write_buffer_number = 4;
+        break;
       default:
         break;
     }
@@ -532,7 +625,19 @@ class DBTest : public testing::Test {
 
  private:
   // Sequence of option configurations to try
-  enum OptionConfig { kDefault, kReuse, kFilter, kUncompressed, kEnd };
+  enum OptionConfig {
+    kDefault,
+    kReuse,
+    kFilter,
+    kUncompressed,
+    kPipelinedWrite,
+    kConcurrentMemTableWrite,
+    kPartitionedIndex,
+    kWholeTableFilter,
+    kDataBlockHashIndex,
+    kMultipleWriteBuffers,
+    kEnd
+  };
 
   const FilterPolicy* filter_policy_;
   int option_config_;
@@ -626,6 +731,64 @@ TEST_F(DBTest, GetMemUsage) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, GetWriteThrottle) {
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  std::string val;
+  ASSERT_TRUE(db_->GetProperty("leveldb.compaction-debt", &val));
+  ASSERT_EQ("0", val);
+  ASSERT_TRUE(db_->GetProperty("leveldb.delayed-write-rate", &val));
+  ASSERT_EQ("0", val);
+  ASSERT_TRUE(db_->GetProperty("leveldb.write-delay-micros", &val));
+  ASSERT_EQ("0", val);
+}
+
+TEST_F(DBTest, WriteThrottleDelaysWrites) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = 1 << 20;
+  options.compaction_readahead_size = 64 << 10;
+  options.delayed_write_rate = 1024;
+  Reopen(&options);
+
+  // Compactions cannot read their inputs, so level-0 files pile up.  The
+  // results are only checked once compactions are unblocked, so that a
+  // failure does not leave the DB unable to close.
+  env_->delay_readahead_reads_.store(true, std::memory_order_release);
+  for (int i = 0; i < 100 && NumTableFilesAtLevel(0) <
+                                 config::kL0_SlowdownWritesTrigger;
+       i++) {
+    EXPECT_LEVELDB_OK(Put("a", "v"));
+    EXPECT_LEVELDB_OK(Put("z", "v"));
+    EXPECT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  const int level0_files = NumTableFilesAtLevel(0);
+
+  env_->fake_now_micros_.store(env_->NowMicros(), std::memory_order_release);
+  std::string rate, val;
+  uint64_t delays[5];
+  for (int i = 0; i < 5; i++) {
+    EXPECT_LEVELDB_OK(Put("k" + std::to_string(i), std::string(10000, 'x')));
+    EXPECT_TRUE(db_->GetProperty("leveldb.delayed-write-rate", &rate));
+    EXPECT_TRUE(db_->GetProperty("leveldb.write-delay-micros", &val));
+    delays[i] = std::stoull(val);
+  }
+  const int max_sleep =
+      env_->max_fake_sleep_micros_.load(std::memory_order_relaxed);
+  env_->fake_now_micros_.store(0, std::memory_order_release);
+  env_->delay_readahead_reads_.store(false, std::memory_order_release);
+
+  ASSERT_EQ(config::kL0_SlowdownWritesTrigger, level0_files);
+  ASSERT_EQ("1024", rate);
+  for (int i = 1; i < 5; i++) {
+    // Each write waits for the one before it to be paid for.
+    ASSERT_GT(delays[i], delays[i - 1] + 9000000) << i;
+  }
+  // The delays were slept in short slices.
+  ASSERT_GT(max_sleep, 0);
+  ASSERT_LE(max_sleep, 1000);
+}
+
 TEST_F(DBTest, GetSnapshot) {
   do {
     // Try with both a short key and a long key
@@ -1098,6 +1261,104 @@ TEST_F(DBTest, RecoverWithLargeLog) {
   ASSERT_GT(NumTableFilesAtLevel(0), 1);
 }
 
+TEST_F(DBTest, ParallelRecovery) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000000;  // Large write buffer
+  Reopen(&options);
+
+  // Overwrite and delete the same keys many times, so that the result
+  // depends on the entries for a key ending up in sequence order.
+  Random rnd(301);
+  std::map<std::string, std::string> model;
+  for (int i = 0; i < 12000; i++) {
+    const std::string k = Key(rnd.Uniform(1000));
+    if (rnd.OneIn(5)) {
+      ASSERT_LEVELDB_OK(Delete(k));
+      model.erase(k);
+    } else {
+      const std::string v = RandomString(&rnd, 100);
+      ASSERT_LEVELDB_OK(Put(k, v));
+      model[k] = v;
+    }
+  }
+  ASSERT_EQ(TotalTableFiles(), 0);
+
+  options.recovery_threads = 4;
+  options.write_buffer_size = 200000;  // Flush in the middle of the log
+  const Snapshot* before = db_->GetSnapshot();
+  const SequenceNumber last_sequence =
+      static_cast<const SnapshotImpl*>(before)->sequence_number();
+  db_->ReleaseSnapshot(before);
+  Reopen(&options);
+  const Snapshot* after = db_->GetSnapshot();
+  ASSERT_EQ(last_sequence,
+            static_cast<const SnapshotImpl*>(after)->sequence_number());
+  db_->ReleaseSnapshot(after);
+  ASSERT_GT(TotalTableFiles(), 1);
+  for (int i = 0; i < 1000; i++) {
+    const std::string k = Key(i);
+    std::map<std::string, std::string>::iterator it = model.find(k);
+    ASSERT_EQ(it == model.end() ? "NOT_FOUND" : it->second, Get(k));
+  }
+}
+
+TEST_F(DBTest, WarmUp) {
+  Options options = CurrentOptions();
+  Reopen(&options);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "v"));
+    dbfull()->TEST_CompactMemTable();
+  }
+  const int tables = TotalTableFiles();
+  ASSERT_GT(tables, 1);
+
+  options.warm_up_threads = 4;
+  Reopen(&options);
+  std::string tables_property;
+  ASSERT_TRUE(db_->GetProperty("leveldb.warm-up-tables", &tables_property));
+  ASSERT_EQ(std::to_string(tables), tables_property);
+  std::string opened;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(db_->GetProperty("leveldb.warm-up-tables-opened", &opened));
+    if (opened == tables_property) break;
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_EQ(tables_property, opened);
+
+  // The tables are already open, so no new table files are opened to
+  // serve the reads.
+  env_->count_random_reads_ = true;
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ("v", Get(Key(i)));
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+}
+
+TEST_F(DBTest, ParallelCompression) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;
+  options.block_size = 1024;
+  options.compression_threads = 4;
+  Reopen(&options);
+
+  // Flushes and compactions share the pool of the DB.
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 1000; i++) {
+    values.push_back(RandomString(&rnd, 1000));
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_GT(TotalTableFiles(), 1);
+
+  Reopen(&options);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
 TEST_F(DBTest, CompactionsGenerateMultipleFiles) {
   Options options = CurrentOptions();
   options.write_buffer_size = 100000000;  // Large write buffer
@@ -1143,6 +1404,84 @@ TEST_F(DBTest, RepeatedWritesToSameKey) {
   }
 }
 
+TEST_F(DBTest, MultipleImmutableMemTables) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.max_write_buffer_number = 4;
+  Reopen(&options);
+
+  // Block memtable compactions and fill memtables until the writes
+  // would have to wait.
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  std::string property;
+  std::string value(1000, 'x');
+  int n = 0;
+  do {
+    ASSERT_LEVELDB_OK(Put(Key(n), value));
+    ASSERT_LEVELDB_OK(Put("last", Key(n)));
+    n++;
+    ASSERT_TRUE(db_->GetProperty("leveldb.num-immutable-mem-table", &property));
+  } while (property != "3" && n < 1000);
+  ASSERT_EQ("3", property);
+
+  // Reads see every memtable, newest first.
+  ASSERT_EQ(Key(n - 1), Get("last"));
+  for (int i = 0; i < n; i++) {
+    ASSERT_EQ(value, Get(Key(i)));
+  }
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(n + 1, count);
+  delete iter;
+
+  // The memtables queued behind the blocked compaction are merged into
+  // a single table.
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  for (int i = 0; i < 100 && property != "0"; i++) {
+    DelayMilliseconds(10);
+    ASSERT_TRUE(db_->GetProperty("leveldb.num-immutable-mem-table", &property));
+  }
+  ASSERT_EQ("0", property);
+  ASSERT_LE(TotalTableFiles(), 2);
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+
+  Reopen(&options);
+  ASSERT_EQ(Key(n - 1), Get("last"));
+  for (int i = 0; i < n; i++) {
+    ASSERT_EQ(value, Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, RateLimiter) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.rate_limiter = NewGenericRateLimiter(1 << 30);
+  Reopen(&options);
+
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), std::string(1000, 'x')));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const uint64_t flushed =
+      options.rate_limiter->GetTotalBytesThrough(RateLimiter::kHigh);
+  ASSERT_GE(flushed, 1000 * 1000);
+  ASSERT_EQ(0, options.rate_limiter->GetTotalBytesThrough(RateLimiter::kLow));
+
+  for (int i = 0; i < 1000; i += 2) {
+    ASSERT_LEVELDB_OK(Put(Key(i), std::string(1000, 'y')));
+  }
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_GE(options.rate_limiter->GetTotalBytesThrough(RateLimiter::kLow),
+            1000 * 1000);
+
+  Close();
+  delete options.rate_limiter;
+}
+
 TEST_F(DBTest, SparseMerge) {
   Options options = CurrentOptions();
   options.compression = kNoCompression;
@@ -1583,6 +1922,8 @@ TEST_F(DBTest, CustomComparator) {
   new_options.comparator = &cmp;
   new_options.filter_policy = nullptr;   // Cannot use bloom filters
   new_options.write_buffer_size = 1000;  // Compact more often
+  // Ignored, since "[10]" and "[0xa]" are equal but hash differently.
+  new_options.data_block_hash_index = true;
   DestroyAndReopen(&new_options);
   ASSERT_LEVELDB_OK(Put("[10]", "ten"));
   ASSERT_LEVELDB_OK(Put("[0x14]", "twenty"));
@@ -1604,6 +1945,12 @@ TEST_F(DBTest, CustomComparator) {
     }
     Compact("[0]", "[1000000]");
   }
+  for (int i = 0; i < 1000; i++) {
+    char key[100], value[100];
+    std::snprintf(key, sizeof(key), "[0x%x]", i * 10);
+    std::snprintf(value, sizeof(value), "[%d]", i * 10);
+    ASSERT_EQ(value, Get(key));
+  }
 }
 
 TEST_F(DBTest, ManualCompaction) {
@@ -1640,6 +1987,125 @@ TEST_F(DBTest, ManualCompaction) {
   ASSERT_EQ("0,0,1", FilesPerLevel());
 }
 
+TEST_F(DBTest, ConcurrentCompactions) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = 32 << 20;
+  options.max_background_compactions = 4;
+  options.compaction_readahead_size = 64 << 10;
+  Reopen(&options);
+
+  // Leave a level-1 file over "c0".."c9" with a level-2 file below it, and
+  // a level-2 file over "b0".."b9".
+  ASSERT_LEVELDB_OK(Put("b0", "v"));
+  ASSERT_LEVELDB_OK(Put("b9", "v"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(Put("c0", "v"));
+  ASSERT_LEVELDB_OK(Put("c9", "v"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(Put("c1", "v"));
+  ASSERT_LEVELDB_OK(Put("c8", "v"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,1,2", FilesPerLevel());
+
+  // A level-1 file over "b1..." pushes level-1 over its size limit, so it
+  // is compacted into level-2, and so is the file over "c0".."c9", which
+  // is disjoint from it.  The compactions cannot read their inputs, so
+  // they can only both be merging if they run in parallel.
+  env_->delay_readahead_reads_.store(true, std::memory_order_release);
+  Random rnd(301);
+  for (int i = 0; i < 11000; i++) {
+    char key[100];
+    std::snprintf(key, sizeof(key), "b1%06d", i);
+    ASSERT_LEVELDB_OK(Put(key, RandomString(&rnd, 1000)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  for (int i = 0; i < 1000; i++) {
+    if (dbfull()->TEST_PeakMergingCompactions() >= 2) break;
+    DelayMilliseconds(10);
+  }
+  env_->delay_readahead_reads_.store(false, std::memory_order_release);
+  ASSERT_EQ(2, dbfull()->TEST_PeakMergingCompactions());
+  ASSERT_EQ("v", Get("c8"));
+
+  options.write_buffer_size = 100000;
+  options.compaction_readahead_size = 0;
+  Reopen(&options);
+
+  // Write enough data to need compactions out of both level-0 and level-1,
+  // in an order that spreads every memtable over the whole key space.
+  const int kNumKeys = 60000;
+  std::vector<std::string> values(kNumKeys);
+  for (int i = 0; i < kNumKeys; i++) {
+    const int k = (i * 7919) % kNumKeys;
+    values[k] = RandomString(&rnd, 250);
+    ASSERT_LEVELDB_OK(Put(Key(k), values[k]));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_GT(NumTableFilesAtLevel(1) + NumTableFilesAtLevel(2), 0);
+  for (int k = 0; k < kNumKeys; k += 7) {
+    ASSERT_EQ(values[k], Get(Key(k)));
+  }
+
+  // A manual compaction must wait for the automatic ones to finish.
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+
+  Reopen(&options);
+  for (int k = 0; k < kNumKeys; k++) {
+    ASSERT_EQ(values[k], Get(Key(k)));
+  }
+}
+
+TEST_F(DBTest, Subcompactions) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;
+  options.max_subcompactions = 4;
+  Reopen(&options);
+
+  // Push several files worth of data down to level-2, so that later
+  // compactions out of level-0 have grandparents to split at.  Keys are
+  // written out of order so that every memtable spans the key space.
+  const int kNumKeys = 24000;
+  Random rnd(301);
+  std::vector<std::string> values(kNumKeys);
+  for (int i = 0; i < kNumKeys; i++) {
+    const int k = (i * 7919) % kNumKeys;
+    values[k] = RandomString(&rnd, 250);
+    ASSERT_LEVELDB_OK(Put(Key(k), values[k]));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_GT(NumTableFilesAtLevel(2), 1);
+
+  // Overwrite and delete keys across the whole key space.
+  for (int i = 0; i < kNumKeys; i += 3) {
+    const int k = (i * 7919) % kNumKeys;
+    if (k % 2 == 0) {
+      values[k] = RandomString(&rnd, 250);
+      ASSERT_LEVELDB_OK(Put(Key(k), values[k]));
+    } else {
+      values[k] = "NOT_FOUND";
+      ASSERT_LEVELDB_OK(Delete(Key(k)));
+    }
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  ASSERT_GT(NumTableFilesAtLevel(1), 1);
+  for (int k = 0; k < kNumKeys; k++) {
+    ASSERT_EQ(values[k], Get(Key(k)));
+  }
+
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(1));
+  Reopen(&options);
+  for (int k = 0; k < kNumKeys; k++) {
+    ASSERT_EQ(values[k], Get(Key(k)));
+  }
+}
+
 TEST_F(DBTest, DBOpen_Options) {
   std::string dbname = testing::TempDir() + "db_options_test";
   DestroyDB(dbname, Options());
@@ -1850,6 +2316,39 @@ TEST_F(DBTest, ManifestWriteError) {
   }
 }
 
+TEST_F(DBTest, PipelinedWriteLogError) {
+  for (int concurrent = 0; concurrent < 2; concurrent++) {
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.enable_pipelined_write = true;
+    options.allow_concurrent_memtable_write = (concurrent != 0);
+    options.create_if_missing = true;
+    DestroyAndReopen(&options);
+    ASSERT_LEVELDB_OK(Put("a", "v1"));
+
+    // The record reaches the log, but the write fails.  Its sequence
+    // number is used up, and the DB refuses later writes, which could
+    // otherwise reuse it.
+    const Snapshot* before = db_->GetSnapshot();
+    env_->log_flush_error_.store(true, std::memory_order_release);
+    ASSERT_TRUE(!Put("b", "v2").ok());
+    env_->log_flush_error_.store(false, std::memory_order_release);
+    const Snapshot* after = db_->GetSnapshot();
+    ASSERT_EQ(static_cast<const SnapshotImpl*>(before)->sequence_number() + 1,
+              static_cast<const SnapshotImpl*>(after)->sequence_number());
+    db_->ReleaseSnapshot(before);
+    db_->ReleaseSnapshot(after);
+    ASSERT_TRUE(!Put("c", "v3").ok());
+
+    Reopen(&options);
+    ASSERT_EQ("v1", Get("a"));
+    ASSERT_EQ("v2", Get("b"));
+    ASSERT_EQ("NOT_FOUND", Get("c"));
+    ASSERT_LEVELDB_OK(Put("c", "v3"));
+    ASSERT_EQ("v3", Get("c"));
+  }
+}
+
 TEST_F(DBTest, MissingSSTFile) {
   ASSERT_LEVELDB_OK(Put("foo", "bar"));
   ASSERT_EQ("bar", Get("foo"));
@@ -1894,12 +2393,148 @@ TEST_F(DBTest, FilesDeletedAfterCompaction) {
   ASSERT_EQ(CountFiles(), num_files);
 }
 
+TEST_F(DBTest, MultiGet) {
+  do {
+    // Spread the keys over the memtable, level-0 and a deeper level.
+    ASSERT_LEVELDB_OK(Put("a", "va"));
+    ASSERT_LEVELDB_OK(Put("c", "vc"));
+    ASSERT_LEVELDB_OK(Put("e", "ve"));
+    Compact("a", "e");
+    ASSERT_LEVELDB_OK(Put("c", "vc2"));
+    ASSERT_LEVELDB_OK(Delete("e"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_LEVELDB_OK(Put("b", "vb"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_LEVELDB_OK(Put("a", "va2"));
+
+    std::vector<Slice> keys = {"e", "a", "missing", "c", "b", "a"};
+    std::vector<std::string> values;
+    std::vector<Status> statuses;
+    db_->MultiGet(ReadOptions(), keys, &values, &statuses);
+    ASSERT_EQ(keys.size(), values.size());
+    ASSERT_EQ(keys.size(), statuses.size());
+    ASSERT_TRUE(statuses[0].IsNotFound());
+    ASSERT_TRUE(statuses[2].IsNotFound());
+    for (size_t i : {1, 3, 4, 5}) {
+      ASSERT_LEVELDB_OK(statuses[i]);
+      ASSERT_EQ(Get(keys[i].ToString()), values[i]);
+    }
+
+    ReadOptions options;
+    options.snapshot = snapshot;
+    db_->MultiGet(options, keys, &values, &statuses);
+    ASSERT_LEVELDB_OK(statuses[1]);
+    ASSERT_EQ("va", values[1]);
+    ASSERT_EQ("va", values[5]);
+    db_->ReleaseSnapshot(snapshot);
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, MultiGetReadsEachBlockOnce) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  Reopen(&options);
+
+  const int N = 50;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  ASSERT_EQ(1, TotalTableFiles());
+
+  std::vector<std::string> key_storage;
+  for (int i = N - 1; i >= 0; i -= 5) {
+    key_storage.push_back(Key(i));
+  }
+  std::vector<Slice> keys(key_storage.begin(), key_storage.end());
+
+  ReadOptions read_options;
+  read_options.fill_cache = false;
+  std::vector<std::string> values;
+  std::vector<Status> statuses;
+  env_->random_read_counter_.Reset();
+  db_->MultiGet(read_options, keys, &values, &statuses);
+  ASSERT_EQ(1, env_->random_read_counter_.Read());
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_LEVELDB_OK(statuses[i]);
+    ASSERT_EQ(key_storage[i], values[i]);
+  }
+}
+
 TEST_F(DBTest, BloomFilter) {
   env_->count_random_reads_ = true;
   Options options = CurrentOptions();
   options.env = env_;
   options.block_cache = NewLRUCache(0);  // Prevent cache hits
   options.filter_policy = NewBloomFilterPolicy(10);
+  options.create_if_missing = true;
+
+  // Check both the per-block and the whole-table filter layouts.
+  for (int whole_table = 0; whole_table < 2; whole_table++) {
+    options.whole_table_filter = (whole_table != 0);
+    DestroyAndReopen(&options);
+
+    // Populate multiple layers
+    const int N = 10000;
+    for (int i = 0; i < N; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+    }
+    Compact("a", "z");
+    for (int i = 0; i < N; i += 100) {
+      ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+    }
+    dbfull()->TEST_CompactMemTable();
+
+    // Prevent auto compactions triggered by seeks
+    env_->delay_data_sync_.store(true, std::memory_order_release);
+
+    // Lookup present keys.  Should rarely read from small sstable.
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ(Key(i), Get(Key(i)));
+    }
+    int reads = env_->random_read_counter_.Read();
+    std::fprintf(stderr, "%d present => %d reads\n", N, reads);
+    ASSERT_GE(reads, N);
+    ASSERT_LE(reads, N + 2 * N / 100);
+
+    // Lookup missing keys.  Should rarely read from either sstable.
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+    }
+    reads = env_->random_read_counter_.Read();
+    std::fprintf(stderr, "%d missing => %d reads\n", N, reads);
+    ASSERT_LE(reads, 3 * N / 100);
+
+    env_->delay_data_sync_.store(false, std::memory_order_release);
+
+    // Tables written in the other layout remain readable.
+    options.whole_table_filter = !options.whole_table_filter;
+    Reopen(&options);
+    for (int i = 0; i < N; i += 100) {
+      ASSERT_LEVELDB_OK(Put(Key(i), "v2"));
+    }
+    dbfull()->TEST_CompactMemTable();
+    options.whole_table_filter = !options.whole_table_filter;
+    Reopen(&options);
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ((i % 100) == 0 ? "v2" : Key(i), Get(Key(i)));
+    }
+  }
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST_F(DBTest, LevelFilterPolicy) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewOptimizedBloomFilterPolicy(10);
   Reopen(&options);
 
   // Populate multiple layers
@@ -1916,29 +2551,255 @@ TEST_F(DBTest, BloomFilter) {
   // Prevent auto compactions triggered by seeks
   env_->delay_data_sync_.store(true, std::memory_order_release);
 
-  // Lookup present keys.  Should rarely read from small sstable.
-  env_->random_read_counter_.Reset();
   for (int i = 0; i < N; i++) {
     ASSERT_EQ(Key(i), Get(Key(i)));
   }
-  int reads = env_->random_read_counter_.Read();
-  std::fprintf(stderr, "%d present => %d reads\n", N, reads);
-  ASSERT_GE(reads, N);
-  ASSERT_LE(reads, N + 2 * N / 100);
 
-  // Lookup present keys.  Should rarely read from either sstable.
+  // Lookup missing keys.  Should rarely read from either sstable.
   env_->random_read_counter_.Reset();
   for (int i = 0; i < N; i++) {
     ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
   }
-  reads = env_->random_read_counter_.Read();
+  int reads = env_->random_read_counter_.Read();
   std::fprintf(stderr, "%d missing => %d reads\n", N, reads);
   ASSERT_LE(reads, 3 * N / 100);
 
+  // Tables written with a uniform policy remain readable.
   env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.filter_policy;
+  options.filter_policy = NewBloomFilterPolicy(10);
+  Reopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST_F(DBTest, DirectReads) {
+  Options options = CurrentOptions();
+  options.use_direct_reads = true;
+  Reopen(&options);
+
+  const int N = 1000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i) + std::string(100, 'v')));
+  }
+  Compact("a", "z");
+  ASSERT_GT(NumTableFilesAtLevel(1) + NumTableFilesAtLevel(2), 0);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i) + std::string(100, 'v'), Get(Key(i)));
+  }
+  ASSERT_EQ("NOT_FOUND", Get("missing"));
+}
+
+TEST_F(DBTest, CompressionPerLevel) {
+  // Unsupported compression types fall back to storing blocks uncompressed,
+  // so this checks the data either way.
+  Options options = CurrentOptions();
+  options.compression = kNoCompression;
+  options.compression_per_level = {kNoCompression, kLz4Compression,
+                                   kZstdCompression};
+  options.zstd_dictionary = std::string(1000, 'x');
+  options.write_buffer_size = 100 << 10;
+  Reopen(&options);
+
+  Random rnd(301);
+  const int N = 2000;
+  std::vector<std::string> values;
+  std::string value;
+  for (int i = 0; i < N; i++) {
+    test::CompressibleString(&rnd, 0.25, 200, &value);
+    values.push_back(value);
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  Compact("a", "z");
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+
+  // Tables keep working when the options change.
+  options.compression_per_level.clear();
+  options.zstd_dictionary.clear();
+  Reopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, CompactionReadaheadAndWriteBuffers) {
+  Options options = CurrentOptions();
+  options.compaction_readahead_size = 1 << 20;
+  options.compaction_write_buffer_size = 1 << 20;
+  options.write_buffer_size = 100 << 10;
+  Reopen(&options);
+
+  Random rnd(301);
+  const int N = 2000;
+  std::vector<std::string> values;
+  for (int i = 0; i < N; i++) {
+    values.push_back(RandomString(&rnd, 200));
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  // Rewrite every other key, so that compactions merge the two versions.
+  for (int i = 0; i < N; i += 2) {
+    values[i] = RandomString(&rnd, 200);
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  Compact("a", "z");
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+
+  Reopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, IteratorPrefetch) {
+  Options options = CurrentOptions();
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.block_size = 256;
+  Reopen(&options);
+
+  const int N = 2000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 10) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "updated"));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  ReadOptions read_options;
+  read_options.prefetch_blocks = 8;
+  for (int reverse = 0; reverse < 2; reverse++) {
+    Iterator* iter = db_->NewIterator(read_options);
+    int count = 0;
+    if (reverse) {
+      iter->SeekToLast();
+    } else {
+      iter->SeekToFirst();
+    }
+    while (iter->Valid()) {
+      int i = reverse ? N - 1 - count : count;
+      ASSERT_EQ(Key(i), iter->key().ToString());
+      ASSERT_EQ((i % 10 == 0) ? "updated" : Key(i), iter->value().ToString());
+      count++;
+      if (reverse) {
+        iter->Prev();
+      } else {
+        iter->Next();
+      }
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+    ASSERT_EQ(N, count);
+  }
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST_F(DBTest, PrefixSeek) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.whole_table_filter = true;
+  options.prefix_extractor = NewDelimitedPrefixExtractor('|');
+  Reopen(&options);
+
+  // Every table holds the even tenants, so only the filters can show that
+  // an odd tenant is absent.
+  const int kObjects = 50;
+  for (int round = 0; round < 3; round++) {
+    for (int t = 0; t < 20; t += 2) {
+      for (int i = round; i < kObjects; i += 3) {
+        char key[100];
+        std::snprintf(key, sizeof(key), "t%02d|obj%04d", t, i);
+        ASSERT_LEVELDB_OK(Put(key, key));
+      }
+    }
+    if (round == 0) {
+      Compact("a", "z");
+    } else {
+      dbfull()->TEST_CompactMemTable();
+    }
+  }
+  ASSERT_LEVELDB_OK(Delete("t04|obj0000"));
+  ASSERT_LEVELDB_OK(Put("t04|", "empty"));
+  ASSERT_LEVELDB_OK(Put("t04", "no-prefix"));
+
+  ReadOptions ropts;
+  ropts.prefix = "t04|";
+  Iterator* iter = db_->NewIterator(ropts);
+  iter->SeekToFirst();
+  ASSERT_EQ(IterStatus(iter), "t04|->empty");
+  iter->Next();
+  ASSERT_EQ(IterStatus(iter), "t04|obj0001->t04|obj0001");
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(kObjects, count);
+  iter->SeekToLast();
+  ASSERT_EQ(IterStatus(iter), "t04|obj0049->t04|obj0049");
+  count = 0;
+  for (; iter->Valid(); iter->Prev()) {
+    count++;
+  }
+  ASSERT_EQ(kObjects, count);
+  iter->Seek("t04|obj0020");
+  ASSERT_EQ(IterStatus(iter), "t04|obj0020->t04|obj0020");
+  iter->Seek("t02|obj0020");
+  ASSERT_EQ(IterStatus(iter), "t04|->empty");
+  iter->Seek("t06|");
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  delete iter;
+
+  // Scan everything once so that all tables are open.
+  iter = db_->NewIterator(ReadOptions());
+  count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(10 * kObjects + 1, count);
+  delete iter;
+
+  // A missing tenant should be ruled out without reading any blocks.
+  env_->random_read_counter_.Reset();
+  ropts.prefix = "t05|";
+  iter = db_->NewIterator(ropts);
+  iter->SeekToFirst();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  iter->SeekToLast();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  delete iter;
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  iter = db_->NewIterator(ReadOptions());
+  iter->Seek("t05|");
+  ASSERT_EQ(IterStatus(iter), "t06|obj0000->t06|obj0000");
+  delete iter;
+  ASSERT_GT(env_->random_read_counter_.Read(), 0);
+
+  ASSERT_EQ("t08|obj0007", Get("t08|obj0007"));
+  ASSERT_EQ("NOT_FOUND", Get("t08|obj0077"));
+  ASSERT_EQ("NOT_FOUND", Get("t04|obj0000"));
+
   Close();
   delete options.block_cache;
   delete options.filter_policy;
+  delete options.prefix_extractor;
 }
 
 // Multi-threaded test:
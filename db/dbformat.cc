@@ -6,6 +6,7 @@
 
 #include <cstdio>
 #include <sstream>
+#include <vector>
 
 #include "port/port.h"
 #include "util/coding.h"
@@ -96,22 +97,74 @@ void InternalKeyComparator::FindShortSuccessor(std::string* key) const {
   }
 }
 
-const char* InternalFilterPolicy::Name() const { return user_policy_->Name(); }
+InternalFilterPolicy::InternalFilterPolicy(
+    const FilterPolicy* p, const PrefixExtractor* prefix_extractor,
+    bool whole_key_filtering)
+    : user_policy_(p),
+      prefix_extractor_(prefix_extractor),
+      whole_key_filtering_(whole_key_filtering || prefix_extractor == nullptr) {
+  if (user_policy_ != nullptr) {
+    // Filters that hold different sets of keys must have different names,
+    // so that tables are only checked against filters built the same way.
+    name_ = user_policy_->Name();
+    if (prefix_extractor_ != nullptr) {
+      name_.append(".prefix.");
+      name_.append(prefix_extractor_->Name());
+      if (!whole_key_filtering_) {
+        name_.append(".nowholekey");
+      }
+    }
+  }
+}
+
+const char* InternalFilterPolicy::Name() const { return name_.c_str(); }
 
 void InternalFilterPolicy::CreateFilter(const Slice* keys, int n,
                                         std::string* dst) const {
-  // We rely on the fact that the code in table.cc does not mind us
-  // adjusting keys[].
-  Slice* mkey = const_cast<Slice*>(keys);
+  if (prefix_extractor_ == nullptr) {
+    // We rely on the fact that the code in table.cc does not mind us
+    // adjusting keys[].
+    Slice* mkey = const_cast<Slice*>(keys);
+    for (int i = 0; i < n; i++) {
+      mkey[i] = ExtractUserKey(keys[i]);
+      // TODO(sanjay): Suppress dups?
+    }
+    user_policy_->CreateFilter(keys, n, dst);
+    return;
+  }
+
+  std::vector<Slice> filter_keys;
+  filter_keys.reserve(whole_key_filtering_ ? 2 * n : n);
+  Slice last_prefix;
+  bool have_prefix = false;
   for (int i = 0; i < n; i++) {
-    mkey[i] = ExtractUserKey(keys[i]);
-    // TODO(sanjay): Suppress dups?
+    Slice user_key = ExtractUserKey(keys[i]);
+    if (whole_key_filtering_) {
+      filter_keys.push_back(user_key);
+    }
+    if (prefix_extractor_->InDomain(user_key)) {
+      // Keys arrive in order, so keys with the same prefix are adjacent.
+      Slice prefix = prefix_extractor_->Transform(user_key);
+      if (!have_prefix || prefix != last_prefix) {
+        filter_keys.push_back(prefix);
+        last_prefix = prefix;
+        have_prefix = true;
+      }
+    }
   }
-  user_policy_->CreateFilter(keys, n, dst);
+  user_policy_->CreateFilter(filter_keys.data(),
+                             static_cast<int>(filter_keys.size()), dst);
 }
 
 bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const {
-  return user_policy_->KeyMayMatch(ExtractUserKey(key), f);
+  Slice user_key = ExtractUserKey(key);
+  if (whole_key_filtering_) {
+    return user_policy_->KeyMayMatch(user_key, f);
+  }
+  if (!prefix_extractor_->InDomain(user_key)) {
+    return true;  // Keys without a prefix are not in the filter
+  }
+  return user_policy_->KeyMayMatch(prefix_extractor_->Transform(user_key), f);
 }
 
 LookupKey::LookupKey(const Slice& user_key, SequenceNumber s) {
@@ -12,6 +12,7 @@
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/prefix_extractor.h"
 #include "leveldb/slice.h"
 #include "leveldb/table_builder.h"
 #include "util/coding.h"
@@ -116,13 +117,37 @@ class InternalKeyComparator : public Comparator {
   int Compare(const InternalKey& a, const InternalKey& b) const;
 };
 
-// Filter policy wrapper that converts from internal keys to user keys
+// Returns true iff "user_key" has prefix "prefix" in the sense of
+// ReadOptions::prefix: its prefix under "extractor" is "prefix", or, if
+// "extractor" is null, it starts with "prefix".
+inline bool UserKeyHasPrefix(const PrefixExtractor* extractor,
+                             const Slice& user_key, const Slice& prefix) {
+  if (extractor == nullptr) {
+    return user_key.starts_with(prefix);
+  }
+  return extractor->InDomain(user_key) &&
+         extractor->Transform(user_key) == prefix;
+}
+
+// Filter policy wrapper that converts from internal keys to user keys.
+// If "prefix_extractor" is non-null, the filters also hold the prefixes of
+// the user keys, and only those if "whole_key_filtering" is false.  Since
+// the prefix of a prefix is the prefix itself, KeyMayMatch() on an
+// internal key made from a prefix then checks for the prefix.
 class InternalFilterPolicy : public FilterPolicy {
  private:
   const FilterPolicy* const user_policy_;
+  const PrefixExtractor* const prefix_extractor_;
+  const bool whole_key_filtering_;
+  std::string name_;
 
  public:
-  explicit InternalFilterPolicy(const FilterPolicy* p) : user_policy_(p) {}
+  explicit InternalFilterPolicy(
+      const FilterPolicy* p, const PrefixExtractor* prefix_extractor = nullptr,
+      bool whole_key_filtering = true);
+  const FilterPolicy* user_policy() const { return user_policy_; }
+  const PrefixExtractor* prefix_extractor() const { return prefix_extractor_; }
+  bool whole_key_filtering() const { return whole_key_filtering_; }
   const char* Name() const override;
   void CreateFilter(const Slice* keys, int n, std::string* dst) const override;
   bool KeyMayMatch(const Slice& key, const Slice& filter) const override;
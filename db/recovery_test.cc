@@ -138,6 +138,11 @@ class RecoveryTest : public testing::Test {
 
   void CompactMemTable() { dbfull()->TEST_CompactMemTable(); }
 
+  void Destroy() {
+    Close();
+    ASSERT_LEVELDB_OK(DestroyDB(dbname_, Options()));
+  }
+
   // Directly construct a log file that sets key to val.
   void MakeLogFile(uint64_t lognum, SequenceNumber seq, Slice key, Slice val) {
     std::string fname = LogFileName(dbname_, lognum);
@@ -322,6 +327,68 @@ TEST_F(RecoveryTest, MultipleLogFiles) {
   ASSERT_EQ("there", Get("hi"));
 }
 
+// Directly construct a log file holding a batch that sets "a" to "va" at
+// sequence number seq, a malformed batch with a valid checksum, and then
+// batches that set Key(i) to "v" for i in [0,n).
+void MakeLogFileWithMalformedBatch(Env* env, const std::string& fname,
+                                   SequenceNumber seq, int n) {
+  WritableFile* file;
+  ASSERT_LEVELDB_OK(env->NewWritableFile(fname, &file));
+  log::Writer writer(file);
+  WriteBatch batch;
+  batch.Put("a", "va");
+  WriteBatchInternal::SetSequence(&batch, seq++);
+  ASSERT_LEVELDB_OK(writer.AddRecord(WriteBatchInternal::Contents(&batch)));
+
+  batch.Clear();
+  batch.Put("bad", "value");
+  WriteBatchInternal::SetSequence(&batch, seq++);
+  Slice contents = WriteBatchInternal::Contents(&batch);
+  // Drop the last byte of the value.
+  ASSERT_LEVELDB_OK(
+      writer.AddRecord(Slice(contents.data(), contents.size() - 1)));
+
+  for (int i = 0; i < n; i++) {
+    batch.Clear();
+    batch.Put("k" + NumberToString(i), "v");
+    WriteBatchInternal::SetSequence(&batch, seq++);
+    ASSERT_LEVELDB_OK(writer.AddRecord(WriteBatchInternal::Contents(&batch)));
+  }
+  ASSERT_LEVELDB_OK(file->Flush());
+  delete file;
+}
+
+TEST_F(RecoveryTest, MalformedBatch) {
+  for (int paranoid = 0; paranoid < 2; paranoid++) {
+    for (int threads = 1; threads <= 4; threads += 3) {
+      ASSERT_LEVELDB_OK(Put("foo", "bar"));
+      Close();
+      MakeLogFileWithMalformedBatch(env(), LogName(FirstLogFile() + 1), 1000,
+                                    100);
+
+      Options options;
+      options.paranoid_checks = paranoid;
+      options.recovery_threads = threads;
+      Status s = OpenWithStatus(&options);
+      if (paranoid) {
+        ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+      } else {
+        // The malformed batch is skipped, and all the batches after it
+        // are still applied.
+        ASSERT_LEVELDB_OK(s);
+        ASSERT_EQ("bar", Get("foo"));
+        ASSERT_EQ("va", Get("a"));
+        ASSERT_EQ("NOT_FOUND", Get("bad"));
+        for (int i = 0; i < 100; i++) {
+          ASSERT_EQ("v", Get("k" + NumberToString(i)));
+        }
+      }
+      Destroy();
+      Open();
+    }
+  }
+}
+
 TEST_F(RecoveryTest, ManifestMissing) {
   ASSERT_LEVELDB_OK(Put("foo", "bar"));
   Close();
@@ -37,6 +37,7 @@
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/scheduler.h"
 
 namespace leveldb {
 
@@ -48,10 +49,15 @@ class Repairer {
       : dbname_(dbname),
         env_(options.env),
         icmp_(options.comparator),
-        ipolicy_(options.filter_policy),
+        ipolicy_(options.filter_policy, options.prefix_extractor,
+                 options.whole_key_filtering),
         options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, options)),
         owns_info_log_(options_.info_log != options.info_log),
         owns_cache_(options_.block_cache != options.block_cache),
+        owns_compression_scheduler_(options_.compression_scheduler !=
+                                    options.compression_scheduler),
+        owns_prefetch_scheduler_(options_.prefetch_scheduler !=
+                                 options.prefetch_scheduler),
         next_file_number_(1) {
     // TableCache can be small since we expect each table to be opened once.
     table_cache_ = new TableCache(dbname_, options_, 10);
@@ -65,6 +71,12 @@ class Repairer {
     if (owns_cache_) {
       delete options_.block_cache;
     }
+    if (owns_compression_scheduler_) {
+      delete options_.compression_scheduler;
+    }
+    if (owns_prefetch_scheduler_) {
+      delete options_.prefetch_scheduler;
+    }
   }
 
   Status Run() {
@@ -432,6 +444,8 @@ class Repairer {
   const Options options_;
   bool owns_info_log_;
   bool owns_cache_;
+  bool owns_compression_scheduler_;
+  bool owns_prefetch_scheduler_;
   TableCache* table_cache_;
   VersionEdit edit_;
 
@@ -365,4 +365,73 @@ TEST(SkipTest, Concurrent3) { RunConcurrent(3); }
 TEST(SkipTest, Concurrent4) { RunConcurrent(4); }
 TEST(SkipTest, Concurrent5) { RunConcurrent(5); }
 
+// Several threads insert disjoint sets of keys through InsertConcurrently.
+class ConcurrentInsertState {
+ public:
+  static constexpr int kThreads = 4;
+  static constexpr int kKeysPerThread = 10000;
+
+  ConcurrentInsertState() : list_(cmp_, &arena_), done_cv_(&mu_), done_(0) {}
+
+  Comparator cmp_;
+  Arena arena_;
+  SkipList<Key, Comparator> list_;
+  std::atomic<int> next_thread_{0};
+
+  void MarkDone() LOCKS_EXCLUDED(mu_) {
+    mu_.Lock();
+    done_++;
+    done_cv_.Signal();
+    mu_.Unlock();
+  }
+
+  void WaitForAll() LOCKS_EXCLUDED(mu_) {
+    mu_.Lock();
+    while (done_ < kThreads) {
+      done_cv_.Wait();
+    }
+    mu_.Unlock();
+  }
+
+ private:
+  port::Mutex mu_;
+  port::CondVar done_cv_ GUARDED_BY(mu_);
+  int done_ GUARDED_BY(mu_);
+};
+
+// Needed when building in C++11 mode.
+constexpr int ConcurrentInsertState::kThreads;
+constexpr int ConcurrentInsertState::kKeysPerThread;
+
+static void ConcurrentInserter(void* arg) {
+  ConcurrentInsertState* state = reinterpret_cast<ConcurrentInsertState*>(arg);
+  const int id = state->next_thread_.fetch_add(1);
+  for (int i = 0; i < ConcurrentInsertState::kKeysPerThread; i++) {
+    // Interleave the key ranges of the threads so that they contend for
+    // the same splices.
+    Key key = static_cast<Key>(i) * ConcurrentInsertState::kThreads + id;
+    state->list_.InsertConcurrently(key);
+  }
+  state->MarkDone();
+}
+
+TEST(SkipTest, ConcurrentInserts) {
+  ConcurrentInsertState state;
+  for (int i = 0; i < ConcurrentInsertState::kThreads; i++) {
+    Env::Default()->StartThread(ConcurrentInserter, &state);
+  }
+  state.WaitForAll();
+
+  const int total =
+      ConcurrentInsertState::kThreads * ConcurrentInsertState::kKeysPerThread;
+  SkipList<Key, Comparator>::Iterator iter(&state.list_);
+  iter.SeekToFirst();
+  for (int i = 0; i < total; i++) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(static_cast<Key>(i), iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+}
+
 }  // namespace leveldb
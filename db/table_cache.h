@@ -38,17 +38,44 @@ class TableCache {
   Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
                         uint64_t file_size, Table** tableptr = nullptr);
 
+  // Like NewIterator(), but for a compaction input, which is read once from
+  // start to end.  If options.compaction_readahead_size is non-zero, the
+  // data blocks are read through a file from
+  // Env::NewReadaheadRandomAccessFile(), while the index and filter are
+  // those of the table in the cache.
+  Iterator* NewCompactionIterator(const ReadOptions& options,
+                                  uint64_t file_number, uint64_t file_size);
+
   // If a seek to internal key "k" in specified file finds an entry,
   // call (*handle_result)(arg, found_key, found_value).
   Status Get(const ReadOptions& options, uint64_t file_number,
              uint64_t file_size, const Slice& k, void* arg,
              void (*handle_result)(void*, const Slice&, const Slice&));
 
+  // Batched form of Get() for the "n" internal keys in keys[0..n-1], which
+  // must be sorted.  The table is looked up once for the whole batch and
+  // (*handle_result)(args[i], found_key, found_value) is called for every
+  // key whose seek finds an entry.
+  Status MultiGet(const ReadOptions& options, uint64_t file_number,
+                  uint64_t file_size, int n, const Slice* keys,
+                  void* const* args,
+                  void (*handle_result)(void*, const Slice&, const Slice&));
+
+  // Returns false if the whole-table filter of the specified file rules
+  // out internal key "k".  Returns true if the file has no such filter, or
+  // if it cannot be opened.
+  bool KeyMayMatch(uint64_t file_number, uint64_t file_size, const Slice& k);
+
+  // Open the specified file, reading its index and filter, and keep it in
+  // the cache so that later reads do not have to open it.
+  Status Warm(uint64_t file_number, uint64_t file_size);
+
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
  private:
   Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  Status OpenTableFile(const std::string& fname, RandomAccessFile** file);
 
   Env* const env_;
   const std::string dbname_;
@@ -219,6 +219,20 @@ static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
   }
 }
 
+static Iterator* GetCompactionFileIterator(void* arg,
+                                           const ReadOptions& options,
+                                           const Slice& file_value) {
+  TableCache* cache = reinterpret_cast<TableCache*>(arg);
+  if (file_value.size() != 16) {
+    return NewErrorIterator(
+        Status::Corruption("FileReader invoked with unexpected value"));
+  } else {
+    return cache->NewCompactionIterator(options,
+                                        DecodeFixed64(file_value.data()),
+                                        DecodeFixed64(file_value.data() + 8));
+  }
+}
+
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
   return NewTwoLevelIterator(
@@ -228,6 +242,11 @@ Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
 
 void Version::AddIterators(const ReadOptions& options,
                            std::vector<Iterator*>* iters) {
+  if (!options.prefix.empty()) {
+    AddPrefixIterators(options, iters);
+    return;
+  }
+
   // Merge all level zero files together since they may overlap
   for (size_t i = 0; i < files_[0].size(); i++) {
     iters->push_back(vset_->table_cache_->NewIterator(
@@ -244,6 +263,46 @@ void Version::AddIterators(const ReadOptions& options,
   }
 }
 
+void Version::AddPrefixIterators(const ReadOptions& options,
+                                 std::vector<Iterator*>* iters) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  const PrefixExtractor* extractor = vset_->options_->prefix_extractor;
+  const Slice prefix = options.prefix;
+  InternalKey prefix_key(prefix, kMaxSequenceNumber, kValueTypeForSeek);
+  const bool check_filters =
+      extractor != nullptr && vset_->options_->filter_policy != nullptr;
+
+  // The keys with the prefix sort together, at or after the prefix itself,
+  // so a file can only hold them if its range reaches the prefix and does
+  // not start past them.  Every such file is added on its own: there are
+  // usually only one or two per level.
+  for (int level = 0; level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& files = files_[level];
+    size_t i =
+        (level == 0) ? 0 : FindFile(vset_->icmp_, files, prefix_key.Encode());
+    for (; i < files.size(); i++) {
+      FileMetaData* f = files[i];
+      if (ucmp->Compare(f->largest.user_key(), prefix) < 0) {
+        continue;
+      }
+      const Slice smallest = f->smallest.user_key();
+      if (ucmp->Compare(smallest, prefix) > 0 &&
+          !UserKeyHasPrefix(extractor, smallest, prefix)) {
+        if (level > 0) {
+          break;  // So do the files after it
+        }
+        continue;
+      }
+      if (check_filters && !vset_->table_cache_->KeyMayMatch(
+                               f->number, f->file_size, prefix_key.Encode())) {
+        continue;
+      }
+      iters->push_back(
+          vset_->table_cache_->NewIterator(options, f->number, f->file_size));
+    }
+  }
+}
+
 // Callback from TableCache::Get()
 namespace {
 enum SaverState {
@@ -278,6 +337,75 @@ static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
   return a->number > b->number;
 }
 
+// Per-key state for Version::MultiGet().
+struct MultiGetKey {
+  Saver saver;
+  Slice ikey;
+  Version::GetStats* stats;
+  FileMetaData* last_file_read;
+  int last_file_read_level;
+  Status* status;
+  bool done;
+};
+
+// Probe table "f" once for every key in "batch" and mark the keys whose
+// lookup it settles as done.
+static void MultiGetFromFile(TableCache* table_cache,
+                             const ReadOptions& options, int level,
+                             FileMetaData* f,
+                             const std::vector<MultiGetKey*>& batch) {
+  std::vector<Slice> ikeys(batch.size());
+  std::vector<void*> args(batch.size());
+  for (size_t i = 0; i < batch.size(); i++) {
+    MultiGetKey* k = batch[i];
+    if (k->stats->seek_file == nullptr && k->last_file_read != nullptr) {
+      // We have had more than one seek for this read.  Charge the 1st file.
+      k->stats->seek_file = k->last_file_read;
+      k->stats->seek_file_level = k->last_file_read_level;
+    }
+    k->last_file_read = f;
+    k->last_file_read_level = level;
+    ikeys[i] = k->ikey;
+    args[i] = &k->saver;
+  }
+
+  Status s = table_cache->MultiGet(options, f->number, f->file_size,
+                                   static_cast<int>(batch.size()), &ikeys[0],
+                                   &args[0], SaveValue);
+  for (MultiGetKey* k : batch) {
+    if (!s.ok()) {
+      *k->status = s;
+      k->done = true;
+      continue;
+    }
+    switch (k->saver.state) {
+      case kNotFound:
+        break;  // Keep searching in other files
+      case kFound:
+        *k->status = Status::OK();
+        k->done = true;
+        break;
+      case kDeleted:
+        k->done = true;
+        break;
+      case kCorrupt:
+        *k->status = Status::Corruption("corrupted key for ", k->saver.user_key);
+        k->done = true;
+        break;
+    }
+  }
+}
+
+static void RemoveDoneKeys(std::vector<MultiGetKey*>* keys) {
+  size_t live = 0;
+  for (size_t i = 0; i < keys->size(); i++) {
+    if (!(*keys)[i]->done) {
+      (*keys)[live++] = (*keys)[i];
+    }
+  }
+  keys->resize(live);
+}
+
 void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
                                  bool (*func)(void*, int, FileMetaData*)) {
   const Comparator* ucmp = vset_->icmp_.user_comparator();
@@ -399,6 +527,83 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
   return state.found ? state.s : Status::NotFound(Slice());
 }
 
+void Version::MultiGet(const ReadOptions& options,
+                       const std::vector<const LookupKey*>& keys,
+                       const std::vector<std::string*>& values,
+                       std::vector<Status>* statuses,
+                       std::vector<GetStats>* stats) {
+  const size_t n = keys.size();
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  statuses->assign(n, Status::NotFound(Slice()));
+  stats->resize(n);
+
+  std::vector<MultiGetKey> state(n);
+  std::vector<MultiGetKey*> pending(n);
+  for (size_t i = 0; i < n; i++) {
+    MultiGetKey* k = &state[i];
+    k->saver.state = kNotFound;
+    k->saver.ucmp = ucmp;
+    k->saver.user_key = keys[i]->user_key();
+    k->saver.value = values[i];
+    k->ikey = keys[i]->internal_key();
+    k->stats = &(*stats)[i];
+    k->stats->seek_file = nullptr;
+    k->stats->seek_file_level = -1;
+    k->last_file_read = nullptr;
+    k->last_file_read_level = -1;
+    k->status = &(*statuses)[i];
+    k->done = false;
+    pending[i] = k;
+  }
+
+  // Search level-0 in order from newest to oldest.
+  std::vector<MultiGetKey*> batch;
+  std::vector<FileMetaData*> tmp(files_[0]);
+  std::sort(tmp.begin(), tmp.end(), NewestFirst);
+  for (uint32_t f = 0; f < tmp.size() && !pending.empty(); f++) {
+    batch.clear();
+    for (MultiGetKey* k : pending) {
+      if (ucmp->Compare(k->saver.user_key, tmp[f]->smallest.user_key()) >= 0 &&
+          ucmp->Compare(k->saver.user_key, tmp[f]->largest.user_key()) <= 0) {
+        batch.push_back(k);
+      }
+    }
+    if (!batch.empty()) {
+      MultiGetFromFile(vset_->table_cache_, options, 0, tmp[f], batch);
+      RemoveDoneKeys(&pending);
+    }
+  }
+
+  // Search other levels.  Files in these levels are disjoint and sorted,
+  // so the sorted keys split into one run of keys per file.
+  for (int level = 1; level < config::kNumLevels && !pending.empty();
+       level++) {
+    const std::vector<FileMetaData*>& files = files_[level];
+    size_t i = 0;
+    while (i < pending.size()) {
+      uint32_t index = FindFile(vset_->icmp_, files, pending[i]->ikey);
+      if (index >= files.size()) {
+        break;  // All remaining keys are past the last file of this level
+      }
+      FileMetaData* f = files[index];
+      batch.clear();
+      for (; i < pending.size(); i++) {
+        MultiGetKey* k = pending[i];
+        if (vset_->icmp_.Compare(k->ikey, f->largest.Encode()) > 0) {
+          break;
+        }
+        if (ucmp->Compare(k->saver.user_key, f->smallest.user_key()) >= 0) {
+          batch.push_back(k);
+        }
+      }
+      if (!batch.empty()) {
+        MultiGetFromFile(vset_->table_cache_, options, level, f, batch);
+      }
+    }
+    RemoveDoneKeys(&pending);
+  }
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
   FileMetaData* f = stats.seek_file;
   if (f != nullptr) {
@@ -1055,6 +1260,7 @@ void VersionSet::Finalize(Version* v) {
       score =
           static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
     }
+    v->compaction_scores_[level] = score;
 
     if (score > best_score) {
       best_level = level;
@@ -1064,6 +1270,30 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+
+  // Estimate the compaction debt.  Once level-0 is due for a compaction,
+  // all of it is merged into level-1, and whatever each level then holds
+  // beyond its target is merged into the next level down, which holds
+  // about ten times as many bytes in the overlapping key range.
+  uint64_t debt = 0;
+  uint64_t pushed_down = 0;  // Bytes moved into the current level
+  if (static_cast<int>(v->files_[0].size()) >=
+      config::kL0_CompactionTrigger) {
+    pushed_down = TotalFileSize(v->files_[0]);
+    debt += pushed_down + TotalFileSize(v->files_[1]);
+  }
+  for (int level = 1; level < config::kNumLevels - 1; level++) {
+    const uint64_t level_bytes = TotalFileSize(v->files_[level]) + pushed_down;
+    const uint64_t max_bytes =
+        static_cast<uint64_t>(MaxBytesForLevel(options_, level));
+    if (level_bytes > max_bytes) {
+      pushed_down = level_bytes - max_bytes;
+      debt += pushed_down * 11;
+    } else {
+      pushed_down = 0;
+    }
+  }
+  v->compaction_debt_ = debt;
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -1232,14 +1462,14 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
       if (c->level() + which == 0) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
-          list[num++] = table_cache_->NewIterator(options, files[i]->number,
-                                                  files[i]->file_size);
+          list[num++] = table_cache_->NewCompactionIterator(
+              options, files[i]->number, files[i]->file_size);
         }
       } else {
         // Create concatenating iterator for the files from this level
         list[num++] = NewTwoLevelIterator(
             new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
-            &GetFileIterator, table_cache_, options);
+            &GetCompactionFileIterator, table_cache_, options);
       }
     }
   }
@@ -1250,42 +1480,87 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
 }
 
 Compaction* VersionSet::PickCompaction() {
-  Compaction* c;
-  int level;
-
   // We prefer compactions triggered by too much data in a level over
-  // the compactions triggered by seeks.
-  const bool size_compaction = (current_->compaction_score_ >= 1);
-  const bool seek_compaction = (current_->file_to_compact_ != nullptr);
-  if (size_compaction) {
-    level = current_->compaction_level_;
-    assert(level >= 0);
-    assert(level + 1 < config::kNumLevels);
-    c = new Compaction(options_, level);
-
-    // Pick the first file that comes after compact_pointer_[level]
-    for (size_t i = 0; i < current_->files_[level].size(); i++) {
-      FileMetaData* f = current_->files_[level][i];
-      if (compact_pointer_[level].empty() ||
-          icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
-        c->inputs_[0].push_back(f);
-        break;
+  // the compactions triggered by seeks.  Levels that need a compaction
+  // are tried in decreasing order of their score, so that a level whose
+  // files are all busy with running compactions does not hold up others.
+  int levels[config::kNumLevels];
+  int num_levels = 0;
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    const double score = current_->compaction_scores_[level];
+    if (score >= 1) {
+      int i = num_levels++;
+      while (i > 0 && current_->compaction_scores_[levels[i - 1]] < score) {
+        levels[i] = levels[i - 1];
+        i--;
       }
+      levels[i] = level;
     }
-    if (c->inputs_[0].empty()) {
-      // Wrap-around to the beginning of the key space
-      c->inputs_[0].push_back(current_->files_[level][0]);
+  }
+  for (int i = 0; i < num_levels; i++) {
+    Compaction* c = PickCompactionAtLevel(levels[i]);
+    if (c != nullptr) {
+      return c;
     }
-  } else if (seek_compaction) {
-    level = current_->file_to_compact_level_;
-    c = new Compaction(options_, level);
-    c->inputs_[0].push_back(current_->file_to_compact_);
-  } else {
+  }
+
+  FileMetaData* f = current_->file_to_compact_;
+  if (f != nullptr && !f->being_compacted) {
+    return SetupCompaction(current_->file_to_compact_level_, f);
+  }
+  return nullptr;
+}
+
+Compaction* VersionSet::PickCompactionAtLevel(int level) {
+  assert(level >= 0);
+  assert(level + 1 < config::kNumLevels);
+  const std::vector<FileMetaData*>& files = current_->files_[level];
+  if (files.empty()) {
     return nullptr;
   }
 
+  // Start with the first file that comes after compact_pointer_[level],
+  // wrapping around to the beginning of the key space.
+  size_t start = 0;
+  if (!compact_pointer_[level].empty()) {
+    while (start < files.size() &&
+           icmp_.Compare(files[start]->largest.Encode(),
+                         compact_pointer_[level]) <= 0) {
+      start++;
+    }
+    if (start == files.size()) {
+      start = 0;
+    }
+  }
+  for (size_t i = 0; i < files.size(); i++) {
+    FileMetaData* f = files[(start + i) % files.size()];
+    if (f->being_compacted) {
+      continue;
+    }
+    Compaction* c = SetupCompaction(level, f);
+    if (c != nullptr) {
+      return c;
+    }
+  }
+  return nullptr;
+}
+
+Compaction* VersionSet::SetupCompaction(int level, FileMetaData* f) {
+  // Level-0 files may overlap each other, so at most one compaction
+  // out of level-0 runs at a time.
+  if (level == 0) {
+    const std::vector<FileMetaData*>& files = current_->files_[0];
+    for (size_t i = 0; i < files.size(); i++) {
+      if (files[i]->being_compacted) {
+        return nullptr;
+      }
+    }
+  }
+
+  Compaction* c = new Compaction(options_, level);
   c->input_version_ = current_;
   c->input_version_->Ref();
+  c->inputs_[0].push_back(f);
 
   // Files in level 0 may overlap each other, so pick up all overlapping ones
   if (level == 0) {
@@ -1300,6 +1575,11 @@ Compaction* VersionSet::PickCompaction() {
 
   SetupOtherInputs(c);
 
+  if (c->InputsBeingCompacted()) {
+    delete c;
+    return nullptr;
+  }
+  StartCompaction(c);
   return c;
 }
 
@@ -1436,6 +1716,12 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
     current_->GetOverlappingInputs(level + 2, &all_start, &all_limit,
                                    &c->grandparents_);
   }
+}
+
+void VersionSet::StartCompaction(Compaction* c) {
+  const int level = c->level();
+  InternalKey smallest, largest;
+  GetRange(c->inputs_[0], &smallest, &largest);
 
   // Update the place where we will do the next compaction for this level.
   // We update this immediately instead of waiting for the VersionEdit
@@ -1443,6 +1729,8 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
   // key range next time.
   compact_pointer_[level] = largest.Encode().ToString();
   c->edit_.SetCompactPointer(level, largest);
+
+  c->SetInputsBeingCompacted(true);
 }
 
 Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
@@ -1475,25 +1763,43 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
   c->input_version_->Ref();
   c->inputs_[0] = inputs;
   SetupOtherInputs(c);
+  StartCompaction(c);
   return c;
 }
 
+Compaction::Position::Position()
+    : grandparent_index(0), seen_key(false), overlapped_bytes(0) {
+  for (int i = 0; i < config::kNumLevels; i++) {
+    level_ptrs[i] = 0;
+  }
+}
+
 Compaction::Compaction(const Options* options, int level)
     : level_(level),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
       input_version_(nullptr),
-      grandparent_index_(0),
-      seen_key_(false),
-      overlapped_bytes_(0) {
-  for (int i = 0; i < config::kNumLevels; i++) {
-    level_ptrs_[i] = 0;
+      inputs_marked_(false) {}
+
+Compaction::~Compaction() { ReleaseInputs(); }
+
+bool Compaction::InputsBeingCompacted() const {
+  for (int which = 0; which < 2; which++) {
+    for (size_t i = 0; i < inputs_[which].size(); i++) {
+      if (inputs_[which][i]->being_compacted) {
+        return true;
+      }
+    }
   }
+  return false;
 }
 
-Compaction::~Compaction() {
-  if (input_version_ != nullptr) {
-    input_version_->Unref();
+void Compaction::SetInputsBeingCompacted(bool value) {
+  for (int which = 0; which < 2; which++) {
+    for (size_t i = 0; i < inputs_[which].size(); i++) {
+      inputs_[which][i]->being_compacted = value;
+    }
   }
+  inputs_marked_ = value;
 }
 
 bool Compaction::IsTrivialMove() const {
@@ -1514,13 +1820,14 @@ void Compaction::AddInputDeletions(VersionEdit* edit) {
   }
 }
 
-bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
+bool Compaction::IsBaseLevelForKey(const Slice& user_key,
+                                   Position* pos) const {
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
   for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
-    while (level_ptrs_[lvl] < files.size()) {
-      FileMetaData* f = files[level_ptrs_[lvl]];
+    while (pos->level_ptrs[lvl] < files.size()) {
+      FileMetaData* f = files[pos->level_ptrs[lvl]];
       if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
         // We've advanced far enough
         if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0) {
@@ -1529,38 +1836,87 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
         }
         break;
       }
-      level_ptrs_[lvl]++;
+      pos->level_ptrs[lvl]++;
     }
   }
   return true;
 }
 
-bool Compaction::ShouldStopBefore(const Slice& internal_key) {
+bool Compaction::ShouldStopBefore(const Slice& internal_key,
+                                  Position* pos) const {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
   const InternalKeyComparator* icmp = &vset->icmp_;
-  while (grandparent_index_ < grandparents_.size() &&
+  while (pos->grandparent_index < grandparents_.size() &&
          icmp->Compare(internal_key,
-                       grandparents_[grandparent_index_]->largest.Encode()) >
+                       grandparents_[pos->grandparent_index]->largest.Encode()) >
              0) {
-    if (seen_key_) {
-      overlapped_bytes_ += grandparents_[grandparent_index_]->file_size;
+    if (pos->seen_key) {
+      pos->overlapped_bytes += grandparents_[pos->grandparent_index]->file_size;
     }
-    grandparent_index_++;
+    pos->grandparent_index++;
   }
-  seen_key_ = true;
+  pos->seen_key = true;
 
-  if (overlapped_bytes_ > MaxGrandParentOverlapBytes(vset->options_)) {
+  if (pos->overlapped_bytes > MaxGrandParentOverlapBytes(vset->options_)) {
     // Too much overlap for current output; start new output
-    overlapped_bytes_ = 0;
+    pos->overlapped_bytes = 0;
     return true;
   } else {
     return false;
   }
 }
 
+void Compaction::SplitKeyRange(int max_ranges,
+                               std::vector<std::string>* boundaries) const {
+  boundaries->clear();
+  if (max_ranges <= 1 || grandparents_.empty()) {
+    return;
+  }
+  const VersionSet* vset = input_version_->vset_;
+  const Comparator* user_cmp = vset->icmp_.user_comparator();
+
+  // Only split strictly inside the user key range of the inputs.
+  Slice smallest_user_key = inputs_[0][0]->smallest.user_key();
+  Slice largest_user_key = inputs_[0][0]->largest.user_key();
+  for (int which = 0; which < 2; which++) {
+    for (size_t i = 0; i < inputs_[which].size(); i++) {
+      const FileMetaData* f = inputs_[which][i];
+      if (user_cmp->Compare(f->smallest.user_key(), smallest_user_key) < 0) {
+        smallest_user_key = f->smallest.user_key();
+      }
+      if (user_cmp->Compare(f->largest.user_key(), largest_user_key) > 0) {
+        largest_user_key = f->largest.user_key();
+      }
+    }
+  }
+
+  // Grandparent files do not overlap, so their smallest keys are sorted.
+  std::vector<Slice> candidates;
+  for (size_t i = 0; i < grandparents_.size(); i++) {
+    const Slice key = grandparents_[i]->smallest.user_key();
+    if (user_cmp->Compare(key, smallest_user_key) > 0 &&
+        user_cmp->Compare(key, largest_user_key) <= 0 &&
+        (candidates.empty() || user_cmp->Compare(key, candidates.back()) > 0)) {
+      candidates.push_back(key);
+    }
+  }
+
+  // Pick evenly spaced boundaries if there are more candidates than needed.
+  const size_t num_boundaries =
+      std::min(candidates.size(), static_cast<size_t>(max_ranges - 1));
+  for (size_t i = 0; i < num_boundaries; i++) {
+    const size_t index = ((i + 1) * candidates.size()) / (num_boundaries + 1);
+    boundaries->push_back(candidates[index].ToString());
+  }
+}
+
 void Compaction::ReleaseInputs() {
   if (input_version_ != nullptr) {
+    if (inputs_marked_) {
+      // The input files are kept alive by input_version_.
+      SetInputsBeingCompacted(false);
+    }
     input_version_->Unref();
     input_version_ = nullptr;
   }
@@ -66,6 +66,9 @@ class Version {
 
   // Append to *iters a sequence of iterators that will
   // yield the contents of this Version when merged together.
+  // If options.prefix is non-empty, they may yield only the entries
+  // whose user keys have that prefix, and leave out the files that
+  // cannot hold any such entry.
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
   void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
@@ -75,6 +78,16 @@ class Version {
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
              GetStats* stats);
 
+  // Batched form of Get().  Looks up *keys[i] for every i, storing the
+  // value in *values[i] and the outcome in (*statuses)[i], and fills
+  // (*stats)[i] as Get() would.  Each table file is probed once for all
+  // of the keys that fall in its range.
+  // REQUIRES: keys are sorted by user key and share a sequence number.
+  // REQUIRES: lock is not held
+  void MultiGet(const ReadOptions&, const std::vector<const LookupKey*>& keys,
+                const std::vector<std::string*>& values,
+                std::vector<Status>* statuses, std::vector<GetStats>* stats);
+
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
   // REQUIRES: lock is held
@@ -128,7 +141,12 @@ class Version {
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1),
+        compaction_debt_(0) {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      compaction_scores_[level] = -1;
+    }
+  }
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
@@ -137,6 +155,9 @@ class Version {
 
   Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
 
+  // AddIterators() for a non-empty options.prefix.
+  void AddPrefixIterators(const ReadOptions&, std::vector<Iterator*>* iters);
+
   // Call func(arg, level, f) for every file that overlaps user_key in
   // order from newest to oldest.  If an invocation of func returns
   // false, makes no more calls.
@@ -162,6 +183,14 @@ class Version {
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Compaction score of every level, so that another level can be picked
+  // when the best one is busy with running compactions.
+  double compaction_scores_[config::kNumLevels];
+
+  // Estimated number of bytes that compactions have to rewrite to bring
+  // every level back within its target size.  Initialized by Finalize().
+  uint64_t compaction_debt_;
 };
 
 class VersionSet {
@@ -208,6 +237,10 @@ class VersionSet {
   // Return the combined file size of all files at the specified level.
   int64_t NumLevelBytes(int level) const;
 
+  // Return the estimated number of bytes that compactions have to rewrite
+  // to bring every level back within its target size.
+  uint64_t CompactionDebt() const { return current_->compaction_debt_; }
+
   // Return the last sequence number.
   uint64_t LastSequence() const { return last_sequence_; }
 
@@ -227,7 +260,8 @@ class VersionSet {
   // being compacted, or zero if there is no such log file.
   uint64_t PrevLogNumber() const { return prev_log_number_; }
 
-  // Pick level and inputs for a new compaction.
+  // Pick level and inputs for a new compaction.  Files that are inputs
+  // to compactions that have not been deleted yet are never picked.
   // Returns nullptr if there is no compaction to be done.
   // Otherwise returns a pointer to a heap-allocated object that
   // describes the compaction.  Caller should delete the result.
@@ -286,8 +320,21 @@ class VersionSet {
                  const std::vector<FileMetaData*>& inputs2,
                  InternalKey* smallest, InternalKey* largest);
 
+  // Pick a size-triggered compaction at "level", starting with the first
+  // file after compact_pointer_[level].  Returns nullptr if every candidate
+  // file at that level conflicts with a running compaction.
+  Compaction* PickCompactionAtLevel(int level);
+
+  // Build a compaction of "f" at "level" and the files it overlaps.
+  // Returns nullptr if any of those files is already being compacted.
+  Compaction* SetupCompaction(int level, FileMetaData* f);
+
   void SetupOtherInputs(Compaction* c);
 
+  // Mark the inputs of "c" as being compacted and advance the compaction
+  // pointer of its level past them.
+  void StartCompaction(Compaction* c);
+
   // Save current contents to *log
   Status WriteSnapshot(log::Writer* log);
 
@@ -318,6 +365,24 @@ class VersionSet {
 // A Compaction encapsulates information about a compaction.
 class Compaction {
  public:
+  // State of one pass over the keys of the compaction in increasing order,
+  // used by IsBaseLevelForKey() and ShouldStopBefore().  Passes over
+  // disjoint key ranges may run concurrently, each with its own Position.
+  struct Position {
+    Position();
+
+    size_t grandparent_index;  // Index in grandparents_
+    bool seen_key;             // Some output key has been seen
+    int64_t overlapped_bytes;  // Bytes of overlap between current output
+                               // and grandparent files
+
+    // level_ptrs holds indices into input_version_->levels_: our state
+    // is that we are positioned at one of the file ranges for each
+    // higher level than the ones involved in this compaction (i.e. for
+    // all L >= level_ + 2).
+    size_t level_ptrs[config::kNumLevels];
+  };
+
   ~Compaction();
 
   // Return the level that is being compacted.  Inputs from "level"
@@ -347,14 +412,20 @@ class Compaction {
   // Returns true if the information we have available guarantees that
   // the compaction is producing data in "level+1" for which no data exists
   // in levels greater than "level+1".
-  bool IsBaseLevelForKey(const Slice& user_key);
+  bool IsBaseLevelForKey(const Slice& user_key, Position* pos) const;
 
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
-  bool ShouldStopBefore(const Slice& internal_key);
+  bool ShouldStopBefore(const Slice& internal_key, Position* pos) const;
+
+  // Split the key range of this compaction into at most "max_ranges"
+  // ranges that start at the boundaries of grandparent files, so that
+  // they can be compacted independently.  Stores the user key at which
+  // every range but the first starts in *boundaries, in increasing order.
+  void SplitKeyRange(int max_ranges, std::vector<std::string>* boundaries) const;
 
   // Release the input version for the compaction, once the compaction
-  // is successful.
+  // is successful.  The inputs become eligible for other compactions.
   void ReleaseInputs();
 
  private:
@@ -363,6 +434,12 @@ class Compaction {
 
   Compaction(const Options* options, int level);
 
+  // Returns true iff some input file belongs to another compaction.
+  bool InputsBeingCompacted() const;
+
+  // Set the being_compacted flag of every input file to "value".
+  void SetInputsBeingCompacted(bool value);
+
   int level_;
   uint64_t max_output_file_size_;
   Version* input_version_;
@@ -374,18 +451,8 @@ class Compaction {
   // State used to check for number of overlapping grandparent files
   // (parent == level_ + 1, grandparent == level_ + 2)
   std::vector<FileMetaData*> grandparents_;
-  size_t grandparent_index_;  // Index in grandparent_starts_
-  bool seen_key_;             // Some output key has been seen
-  int64_t overlapped_bytes_;  // Bytes of overlap between current output
-                              // and grandparent files
-
-  // State for implementing IsBaseLevelForKey
-
-  // level_ptrs_ holds indices into input_version_->levels_: our state
-  // is that we are positioned at one of the file ranges for each
-  // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
-  size_t level_ptrs_[config::kNumLevels];
+
+  bool inputs_marked_;  // Inputs are flagged as being compacted
 };
 
 }  // namespace leveldb
@@ -0,0 +1,85 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "db/dbformat.h"
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+// Writes are never throttled below this rate (bytes per second), so that
+// compactions that are stuck do not stall writers indefinitely before the
+// hard limits are reached.
+static const uint64_t kMinDelayedWriteRate = 16 * 1024;
+
+// The bucket holds at most this many microseconds worth of writes, so a
+// writer that was idle cannot then write a large burst without waiting.
+static const uint64_t kMaxBurstMicros = 1000;
+
+WriteController::WriteController(const Options* options)
+    : options_(options), rate_(0), credit_(0), last_refill_micros_(0) {}
+
+void WriteController::Update(int level0_files, uint64_t compaction_debt,
+                             uint64_t now_micros) {
+  const uint64_t max_rate = options_->delayed_write_rate;
+  const uint64_t soft_limit = options_->soft_pending_compaction_bytes_limit;
+  const bool too_many_files =
+      level0_files >= config::kL0_SlowdownWritesTrigger;
+  const bool too_much_debt = soft_limit > 0 && compaction_debt > soft_limit;
+  uint64_t rate = 0;
+  if (max_rate > 0 && (too_many_files || too_much_debt)) {
+    double r = static_cast<double>(max_rate);
+    if (too_many_files) {
+      // Halve the rate for every file past the slowdown trigger.
+      r = std::ldexp(r, config::kL0_SlowdownWritesTrigger - level0_files);
+    }
+    if (too_much_debt) {
+      r *= static_cast<double>(soft_limit) / compaction_debt;
+    }
+    rate = std::max(static_cast<uint64_t>(r),
+                    std::min(kMinDelayedWriteRate, max_rate));
+  }
+
+  if (rate_ == 0) {
+    // Start throttling with an empty bucket.
+    credit_ = 0;
+    last_refill_micros_ = now_micros;
+  } else {
+    // Credit the time spent at the old rate.
+    Refill(now_micros);
+  }
+  rate_ = rate;
+}
+
+uint64_t WriteController::GetDelay(uint64_t now_micros) {
+  if (rate_ == 0) {
+    return 0;
+  }
+  Refill(now_micros);
+  if (credit_ >= 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(std::ceil(-credit_ * 1e6 / rate_));
+}
+
+void WriteController::Charge(uint64_t bytes) {
+  if (rate_ != 0) {
+    credit_ -= static_cast<double>(bytes);
+  }
+}
+
+void WriteController::Refill(uint64_t now_micros) {
+  if (now_micros > last_refill_micros_) {
+    const double max_credit = rate_ * (kMaxBurstMicros / 1e6);
+    credit_ += (now_micros - last_refill_micros_) * (rate_ / 1e6);
+    credit_ = std::min(credit_, max_credit);
+    last_refill_micros_ = now_micros;
+  }
+}
+
+}  // namespace leveldb
@@ -0,0 +1,56 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+#define STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+
+#include <cstdint>
+
+namespace leveldb {
+
+struct Options;
+
+// Throttles writes while compactions are falling behind.  The rate at
+// which writes are admitted is derived from the number of level-0 files
+// and from the compaction debt (see VersionSet::CompactionDebt()), and
+// drops gradually as they grow.  Writes are then paid for out of a token
+// bucket: each write consumes its size in bytes, and a write that finds
+// the bucket in deficit waits until it has been refilled.
+//
+// Not thread-safe; the DB calls it with its mutex held.
+class WriteController {
+ public:
+  explicit WriteController(const Options* options);
+
+  WriteController(const WriteController&) = delete;
+  WriteController& operator=(const WriteController&) = delete;
+
+  // Recompute the write rate for a database with "level0_files" files in
+  // level-0 and "compaction_debt" bytes of compaction debt.
+  void Update(int level0_files, uint64_t compaction_debt, uint64_t now_micros);
+
+  // Return the number of microseconds the next write has to wait for the
+  // earlier writes to be paid for.  Zero if writes are not throttled.
+  uint64_t GetDelay(uint64_t now_micros);
+
+  // Record that "bytes" bytes have been written.
+  void Charge(uint64_t bytes);
+
+  // Rate, in bytes per second, at which writes are admitted, or zero if
+  // writes are not throttled.
+  uint64_t delayed_write_rate() const { return rate_; }
+
+ private:
+  // Add the bytes that accrued since the last refill to credit_.
+  void Refill(uint64_t now_micros);
+
+  const Options* const options_;
+  uint64_t rate_;
+  double credit_;  // Bytes that may be written without waiting
+  uint64_t last_refill_micros_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
@@ -0,0 +1,78 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include "gtest/gtest.h"
+#include "db/dbformat.h"
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+static const int kSlowdown = config::kL0_SlowdownWritesTrigger;
+
+TEST(WriteControllerTest, NotThrottled) {
+  Options options;
+  WriteController controller(&options);
+  controller.Update(kSlowdown - 1, options.soft_pending_compaction_bytes_limit,
+                    0);
+  ASSERT_EQ(0, controller.delayed_write_rate());
+  controller.Charge(1 << 30);
+  ASSERT_EQ(0, controller.GetDelay(0));
+
+  // Throttling can be disabled.
+  options.delayed_write_rate = 0;
+  controller.Update(kSlowdown + 3, 0, 0);
+  ASSERT_EQ(0, controller.delayed_write_rate());
+}
+
+TEST(WriteControllerTest, Rate) {
+  Options options;
+  const uint64_t rate = options.delayed_write_rate;
+  const uint64_t limit = options.soft_pending_compaction_bytes_limit;
+  WriteController controller(&options);
+
+  controller.Update(kSlowdown, 0, 0);
+  ASSERT_EQ(rate, controller.delayed_write_rate());
+  controller.Update(kSlowdown + 2, 0, 0);
+  ASSERT_EQ(rate / 4, controller.delayed_write_rate());
+
+  controller.Update(0, 2 * limit, 0);
+  ASSERT_EQ(rate / 2, controller.delayed_write_rate());
+  controller.Update(kSlowdown + 1, 4 * limit, 0);
+  ASSERT_EQ(rate / 8, controller.delayed_write_rate());
+
+  // The rate never drops to zero.
+  controller.Update(kSlowdown + 3, 1000 * limit, 0);
+  ASSERT_LT(0, controller.delayed_write_rate());
+  ASSERT_GT(rate / 1000, controller.delayed_write_rate());
+
+  controller.Update(0, limit, 0);
+  ASSERT_EQ(0, controller.delayed_write_rate());
+}
+
+TEST(WriteControllerTest, Delay) {
+  Options options;
+  options.delayed_write_rate = 1 << 20;
+  WriteController controller(&options);
+  controller.Update(kSlowdown, 0, 0);
+
+  // Writes are paid for by the writes that follow them.
+  ASSERT_EQ(0, controller.GetDelay(0));
+  controller.Charge(1 << 20);
+  ASSERT_EQ(1000000, controller.GetDelay(0));
+  ASSERT_EQ(500000, controller.GetDelay(500000));
+  ASSERT_EQ(0, controller.GetDelay(1000000));
+
+  // Idle time only buys a small burst.
+  ASSERT_EQ(0, controller.GetDelay(60000000));
+  controller.Charge(1 << 20);
+  ASSERT_NEAR(999000, controller.GetDelay(60000000), 1);
+
+  // Changing the rate keeps the debt of earlier writes.
+  controller.Update(kSlowdown + 1, 0, 60000000);
+  ASSERT_NEAR(1998000, controller.GetDelay(60000000), 2);
+}
+
+}  // namespace leveldb
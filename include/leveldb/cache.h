@@ -31,6 +31,27 @@ class LEVELDB_EXPORT Cache;
 // of Cache uses a least-recently-used eviction policy.
 LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity);
 
+// Create a new cache with a fixed size capacity and a scan-resistant
+// segmented least-recently-used eviction policy.  Entries start out in a
+// probationary segment and move to a protected segment, which may hold up
+// to protected_ratio of the capacity, when they are looked up again.
+// Entries that are never looked up again, like the blocks read by a long
+// iterator scan, are evicted before any protected entry.
+//
+// REQUIRES: 0 <= protected_ratio < 1
+LEVELDB_EXPORT Cache* NewSegmentedLRUCache(size_t capacity,
+                                           double protected_ratio);
+
+// Create a new cache with a fixed size capacity, split into
+// 2^num_shard_bits independently locked shards.  This implementation
+// approximates least-recently-used eviction with the CLOCK algorithm, so a
+// hit does not reorder any list, and releasing a handle does not take a
+// lock.  It suits block caches shared by many reading threads; around 6
+// shard bits is a reasonable choice for a few dozen threads.
+//
+// REQUIRES: 0 <= num_shard_bits <= 16
+LEVELDB_EXPORT Cache* NewClockCache(size_t capacity, int num_shard_bits);
+
 class LEVELDB_EXPORT Cache {
  public:
   Cache() = default;
@@ -64,6 +85,13 @@ class LEVELDB_EXPORT Cache {
   // longer needed.
   virtual Handle* Lookup(const Slice& key) = 0;
 
+  // Return true if the cache has a mapping for "key".  Unlike Lookup(),
+  // this does not count as a use of the entry, so it does not change the
+  // order in which entries are evicted.  The default implementation of
+  // Contains() calls Lookup() and Release(); subclasses are encouraged to
+  // override it.
+  virtual bool Contains(const Slice& key);
+
   // Release a mapping returned by a previous Lookup().
   // REQUIRES: handle must not have been released yet.
   // REQUIRES: handle must have been returned by a method on *this.
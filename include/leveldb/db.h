@@ -7,6 +7,7 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
@@ -87,6 +88,18 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options, const Slice& key,
                      std::string* value) = 0;
 
+  // Look up every key in "keys" as if by Get(), resizing "*values" and
+  // "*statuses" to keys.size() and storing the outcome for keys[i] in
+  // (*values)[i] and (*statuses)[i].  All of the lookups observe the same
+  // snapshot of the database.
+  //
+  // The default implementation simply calls Get() once per key.  A DB
+  // implementation may override it to share work between the keys.
+  virtual void MultiGet(const ReadOptions& options,
+                        const std::vector<Slice>& keys,
+                        std::vector<std::string>* values,
+                        std::vector<Status>* statuses);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -119,6 +132,20 @@ class LEVELDB_EXPORT DB {
   //     about the internal operation of the DB.
   //  "leveldb.sstables" - returns a multi-line string that describes all
   //     of the sstables that make up the db contents.
+  //  "leveldb.num-immutable-mem-table" - returns the number of full write
+  //     buffers that are waiting to be written to disk.
+  //  "leveldb.compaction-debt" - returns the estimated number of bytes that
+  //     compactions have to rewrite to bring every level back within its
+  //     target size.
+  //  "leveldb.delayed-write-rate" - returns the rate, in bytes per second,
+  //     at which writes are currently admitted, or 0 if writes are not
+  //     being throttled (see Options::delayed_write_rate).
+  //  "leveldb.write-delay-micros" - returns the total number of
+  //     microseconds that writes have been delayed by throttling.
+  //  "leveldb.warm-up-tables" - returns the number of tables that the
+  //     warm-up started by DB::Open() opens (see Options::warm_up_threads).
+  //  "leveldb.warm-up-tables-opened" - returns the number of those tables
+  //     that have been opened so far.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
@@ -85,6 +85,28 @@ class LEVELDB_EXPORT Env {
   virtual Status NewRandomAccessFile(const std::string& fname,
                                      RandomAccessFile** result) = 0;
 
+  // Like NewRandomAccessFile(), but reads should bypass the operating
+  // system's page cache where the platform supports it (e.g. with
+  // O_DIRECT), so that data is only cached by the caller.  Reads may be
+  // slower, and the file may be opened with buffered I/O if the file
+  // system does not support direct I/O.
+  //
+  // The default implementation calls NewRandomAccessFile().
+  virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result);
+
+  // Like NewRandomAccessFile(), but for a file that is read mostly in
+  // increasing order of offset, such as a compaction input.  A read that
+  // misses the buffer refills it with the next "readahead_size" bytes of
+  // the file in one request, and the operating system may be told not to
+  // keep the data that has been read in its page cache.  The returned file
+  // is meant to be used by one reader at a time.
+  //
+  // The default implementation calls NewRandomAccessFile().
+  virtual Status NewReadaheadRandomAccessFile(const std::string& fname,
+                                              size_t readahead_size,
+                                              RandomAccessFile** result);
+
   // Create an object that writes to a new file with the specified
   // name.  Deletes any existing file with the same name and creates a
   // new file.  On success, stores a pointer to the new file in
@@ -95,6 +117,17 @@ class LEVELDB_EXPORT Env {
   virtual Status NewWritableFile(const std::string& fname,
                                  WritableFile** result) = 0;
 
+  // Like NewWritableFile(), but for a large file that is written in one
+  // go, such as a compaction output.  Appended data is buffered until
+  // "buffer_size" bytes have accumulated, and the operating system may be
+  // asked to start writing each buffer back to the device right away, so
+  // that little is left to do when the file is synced.
+  //
+  // The default implementation calls NewWritableFile().
+  virtual Status NewBufferedWritableFile(const std::string& fname,
+                                         size_t buffer_size,
+                                         WritableFile** result);
+
   // Create an object that either appends to an existing file, or
   // writes to a new file (if the file does not exist to begin with).
   // On success, stores a pointer to the new file in *result and
@@ -197,6 +230,15 @@ class LEVELDB_EXPORT Env {
   // serialized.
   virtual void Schedule(void (*function)(void* arg), void* arg) = 0;
 
+  // Allow up to "number" of the functions passed to Schedule() to run at
+  // the same time.  Implementations only ever grow the number of
+  // background threads, so this is a lower bound requested by a caller
+  // rather than an exact setting.
+  //
+  // The default implementation does nothing, which keeps background
+  // work serialized on whatever threads the Env already uses.
+  virtual void SetBackgroundThreads(int number);
+
   // Start a new thread, invoking "function(arg)" within the new thread.
   // When "function(arg)" returns, the thread will be destroyed.
   virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
@@ -349,9 +391,21 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
                              RandomAccessFile** r) override {
     return target_->NewRandomAccessFile(f, r);
   }
+  Status NewDirectRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) override {
+    return target_->NewDirectRandomAccessFile(f, r);
+  }
+  Status NewReadaheadRandomAccessFile(const std::string& f, size_t n,
+                                      RandomAccessFile** r) override {
+    return target_->NewReadaheadRandomAccessFile(f, n, r);
+  }
   Status NewWritableFile(const std::string& f, WritableFile** r) override {
     return target_->NewWritableFile(f, r);
   }
+  Status NewBufferedWritableFile(const std::string& f, size_t n,
+                                 WritableFile** r) override {
+    return target_->NewBufferedWritableFile(f, n, r);
+  }
   Status NewAppendableFile(const std::string& f, WritableFile** r) override {
     return target_->NewAppendableFile(f, r);
   }
@@ -384,6 +438,9 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   void Schedule(void (*f)(void*), void* a) override {
     return target_->Schedule(f, a);
   }
+  void SetBackgroundThreads(int number) override {
+    return target_->SetBackgroundThreads(number);
+  }
   void StartThread(void (*f)(void*), void* a) override {
     return target_->StartThread(f, a);
   }
@@ -16,7 +16,9 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
 #define STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include "leveldb/export.h"
 
@@ -49,6 +51,19 @@ class LEVELDB_EXPORT FilterPolicy {
   // This method may return true or false if the key was not on the
   // list, but it should aim to return false with a high probability.
   virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const = 0;
+
+  // Return the policy to build the filters of a table with, when the
+  // table is written to the specified level of the database and
+  // level_bytes[0,num_levels-1] holds the current number of bytes in each
+  // level.  This allows, e.g., spending more bits per key on the smaller
+  // levels.  The filters built by the result must be understood by the
+  // KeyMayMatch() method of this policy, and the result must remain live
+  // for as long as this policy.
+  //
+  // The default implementation returns this policy for every level.
+  virtual const FilterPolicy* PolicyForLevel(int level,
+                                             const uint64_t* level_bytes,
+                                             int num_levels) const;
 };
 
 // Return a new filter policy that uses a bloom filter with approximately
@@ -67,6 +82,56 @@ class LEVELDB_EXPORT FilterPolicy {
 // trailing spaces in keys.
 LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+// Return a new filter policy that uses bloom filters with bits_per_key[i]
+// bits per key for the tables of level i.  Levels past the end of the
+// vector use its last element.  Tables built without a level, e.g. by
+// RepairDB(), use the last element as well.
+//
+// Filters built by this policy, by NewOptimizedBloomFilterPolicy() and by
+// NewBloomFilterPolicy() are compatible with each other, so the policy can
+// be changed between these without losing the filters of existing tables.
+//
+// REQUIRES: bits_per_key is not empty
+LEVELDB_EXPORT const FilterPolicy* NewLevelBloomFilterPolicy(
+    const std::vector<int>& bits_per_key);
+
+// Return a new filter policy that uses bloom filters with approximately
+// the specified number of bits per key on average, but distributes them
+// across the levels so as to minimize the expected number of unnecessary
+// disk reads for a key that is not in the database.  Since the deepest
+// level holds most of the keys, its filters get slightly fewer bits per
+// key, and the smaller levels get more.  The allocation is recomputed
+// from the sizes of the levels whenever a table is written.
+LEVELDB_EXPORT const FilterPolicy* NewOptimizedBloomFilterPolicy(
+    int bits_per_key);
+
+// Return a new filter policy that uses a blocked bloom filter with
+// approximately the specified number of bits per key.  All of the bits
+// for a key are kept within a single 64-byte block, so that a lookup
+// touches one cache line rather than one per probe, at the cost of a
+// slightly higher false positive rate than NewBloomFilterPolicy() for
+// the same number of bits per key.  Probes use AVX2 when the CPU
+// supports it.
+//
+// The filters are not compatible with those of NewBloomFilterPolicy();
+// tables written with one policy are read without filters by the other.
+// The same caveats about custom comparators apply.
+LEVELDB_EXPORT const FilterPolicy* NewBlockedBloomFilterPolicy(
+    int bits_per_key);
+
+// Return a new filter policy that uses an xor filter with fingerprints of
+// the specified number of bits, either 8 or 16 (other values are rounded
+// up to one of these).  The filter uses about 1.23 * fingerprint_bits bits
+// per key, and has a false positive rate of about 2^-fingerprint_bits:
+// with 8 bits, ~0.4% for ~9.9 bits per key, where a bloom filter needs
+// ~11.5 bits per key for the same rate.
+//
+// An xor filter has a fixed overhead of about 45 bytes, so it is best used
+// with Options::whole_table_filter rather than with one filter per 2KB of
+// data.  Building one takes more CPU time than a bloom filter.  The same
+// caveats about custom comparators as for NewBloomFilterPolicy() apply.
+LEVELDB_EXPORT const FilterPolicy* NewXorFilterPolicy(int fingerprint_bits);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
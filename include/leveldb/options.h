@@ -6,8 +6,12 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 #include "leveldb/export.h"
+#include "leveldb/slice.h"
 
 namespace leveldb {
 
@@ -16,6 +20,9 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class PrefixExtractor;
+class RateLimiter;
+class Scheduler;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -26,7 +33,9 @@ enum CompressionType {
   // NOTE: do not change the values of existing entries, as these are
   // part of the persistent format on disk.
   kNoCompression = 0x0,
-  kSnappyCompression = 0x1
+  kSnappyCompression = 0x1,
+  kZstdCompression = 0x2,
+  kLz4Compression = 0x3
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -75,12 +84,34 @@ struct LEVELDB_EXPORT Options {
   // on disk) before converting to a sorted on-disk file.
   //
   // Larger values increase performance, especially during bulk loads.
-  // Up to two write buffers may be held in memory at the same time,
-  // so you may wish to adjust this parameter to control memory usage.
-  // Also, a larger write buffer will result in a longer recovery time
-  // the next time the database is opened.
+  // Up to max_write_buffer_number write buffers may be held in memory at
+  // the same time, so you may wish to adjust this parameter to control
+  // memory usage.  Also, a larger write buffer will result in a longer
+  // recovery time the next time the database is opened.
   size_t write_buffer_size = 4 * 1024 * 1024;
 
+  // Maximum number of write buffers held in memory, including the one
+  // being filled.  A full write buffer is queued to be written to disk
+  // while writes go to a new one; writes only wait when this many are
+  // held.  Larger values absorb longer bursts of writes, and the queued
+  // write buffers are merged into a single level-0 file when they are
+  // written.
+  int max_write_buffer_number = 2;
+
+  // Rate, in bytes per second, at which writes are admitted once
+  // compactions fall behind: when level-0 reaches its slowdown trigger of
+  // files, or when the compaction debt (the bytes that compactions must
+  // rewrite to bring every level back within its target size) exceeds
+  // soft_pending_compaction_bytes_limit.  The rate is lowered further the
+  // further behind compactions are, so that writes slow down gradually
+  // rather than stopping abruptly once level-0 is full.  Zero disables
+  // this throttling.
+  uint64_t delayed_write_rate = 16 * 1024 * 1024;
+
+  // Compaction debt, in bytes, above which writes are throttled (see
+  // delayed_write_rate).  Zero means the debt is ignored.
+  uint64_t soft_pending_compaction_bytes_limit = 256 * 1024 * 1024;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
@@ -93,6 +124,21 @@ struct LEVELDB_EXPORT Options {
   // If null, leveldb will automatically create and use an 8MB internal cache.
   Cache* block_cache = nullptr;
 
+  // If non-null, use the specified cache as a second tier beneath
+  // block_cache that holds blocks in their compressed form.  Blocks that
+  // miss in block_cache are looked up here before being read from the
+  // file, and compressed blocks read from a file are added here.  Since
+  // entries are charged their compressed size, a cache of a given
+  // capacity covers several times as much data as block_cache would.
+  // Blocks that are stored uncompressed are never added.
+  Cache* compressed_block_cache = nullptr;
+
+  // If true, table files are opened with Env::NewDirectRandomAccessFile(),
+  // so that their blocks are not also cached by the operating system.
+  // The block caches then account for all of the memory spent on caching
+  // table contents, and should be sized accordingly.
+  bool use_direct_reads = false;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -104,6 +150,21 @@ struct LEVELDB_EXPORT Options {
   // leave this parameter alone.
   int block_restart_interval = 16;
 
+  // If true, each data block ends with a small hash index from the keys
+  // in the block to their restart points, so that Get() can go straight
+  // to the right restart interval instead of searching the block.  It
+  // costs about one byte per key.  Blocks with more than 253 restart
+  // points are written without an index.
+  //
+  // The index finds keys by their bytes, so it is only written and used
+  // if the comparator is BytewiseComparator().  With any other comparator
+  // this option has no effect.
+  //
+  // Tables written with this option cannot be read by older versions
+  // of leveldb.  Tables in either format can be read regardless of the
+  // value of this option.
+  bool data_block_hash_index = false;
+
   // Leveldb will write up to this amount of bytes to a file before
   // switching to a new one.
   // Most clients should leave this parameter alone.  However if your
@@ -114,6 +175,53 @@ struct LEVELDB_EXPORT Options {
   // initially populating a large database.
   size_t max_file_size = 2 * 1024 * 1024;
 
+  // Maximum number of compactions that may run at the same time.
+  // Compactions only run concurrently when they read and write disjoint
+  // sets of files, and at most one of them may involve level-0.  Memtable
+  // compactions are scheduled separately, so a long compaction of deeper
+  // levels never holds up writing the memtable to disk.
+  //
+  // Default: 1, i.e. compactions are serialized.
+  int max_background_compactions = 1;
+
+  // Maximum number of threads that a single compaction may use.  A large
+  // compaction is split into key ranges at the boundaries of the files in
+  // the level below its output level, and each range is merged and written
+  // on its own thread.  The resulting files are installed together.
+  //
+  // Default: 1, i.e. every compaction runs on a single thread.
+  int max_subcompactions = 1;
+
+  // If non-zero, compactions read their input tables through buffers of
+  // this many bytes, each filled by a single read, instead of one block at
+  // a time, and do not leave the data they read in the operating system's
+  // page cache.  A few megabytes suit disks that are limited by the number
+  // of requests rather than by bandwidth.
+  size_t compaction_readahead_size = 0;
+
+  // If non-zero, compactions write their output tables through buffers of
+  // this many bytes, and start writing each buffer back to the device as
+  // soon as it is full instead of waiting for the file to be synced.
+  size_t compaction_write_buffer_size = 0;
+
+  // If non-null, the table files written by memtable compactions and by
+  // compactions are written no faster than this allows, with memtable
+  // compactions taking priority.  A single RateLimiter may be shared by
+  // several databases.  See leveldb/rate_limiter.h.
+  RateLimiter* rate_limiter = nullptr;
+
+  // If true, a group of writes is applied to the memtable while the next
+  // group is already being appended to the log.  This mostly helps
+  // workloads with many small writes that use WriteOptions::sync, where
+  // the log sync would otherwise also hold up the memtable inserts.
+  bool enable_pipelined_write = false;
+
+  // If true, the writers of a group of concurrent writes each apply their
+  // own batch to the memtable, in parallel, once the group has been
+  // logged.  Otherwise a single thread applies the whole group.  Setting
+  // this also selects the pipelined write path (see above).
+  bool allow_concurrent_memtable_write = false;
+
   // Compress blocks using the specified compression algorithm.  This
   // parameter can be changed dynamically.
   //
@@ -128,18 +236,131 @@ struct LEVELDB_EXPORT Options {
   // worth switching to kNoCompression.  Even if the input data is
   // incompressible, the kSnappyCompression implementation will
   // efficiently detect that and will switch to uncompressed mode.
+  //
+  // kZstdCompression compresses better than kSnappyCompression but is
+  // slower, and kLz4Compression is comparable to kSnappyCompression.  A
+  // block whose compression type is not supported by the build is stored
+  // uncompressed.
   CompressionType compression = kSnappyCompression;
 
+  // If non-empty, tables written to level L are compressed with
+  // compression_per_level[L] instead of "compression", or with the last
+  // element if L is past the end.  Memtables are written with the first
+  // element.  For example, {kLz4Compression, kLz4Compression,
+  // kZstdCompression} uses fast compression where data is rewritten
+  // often, and dense compression for the deeper levels that hold most of
+  // the data.
+  std::vector<CompressionType> compression_per_level;
+
+  // Compression level for kZstdCompression.  Levels from -5 (fastest) to
+  // 22 (smallest) are supported.
+  int zstd_compression_level = 1;
+
+  // If non-empty, data blocks compressed with kZstdCompression use this
+  // dictionary, which helps when blocks are small and similar to each
+  // other.  It may be raw sample content, or a dictionary trained on
+  // samples of the data with "zstd --train".  Each table stores a copy of
+  // the dictionary it was written with, so the dictionary may be changed
+  // at any time.
+  std::string zstd_dictionary;
+
+  // Number of threads that compress and checksum the data blocks of the
+  // tables being built.  With the default of 1, blocks are compressed by
+  // the thread that builds the table.  Larger values let a flush or
+  // compaction that is limited by compression speed use more CPUs.  The
+  // threads are shared by all the tables the DB builds.  The contents of
+  // the table do not depend on this setting.
+  int compression_threads = 1;
+
+  // If non-null and compression_threads > 1, blocks are compressed by
+  // this scheduler (see leveldb/scheduler.h), which may be shared with
+  // other databases.  If null, the DB creates a scheduler of
+  // compression_threads threads on env.  TableBuilder compresses blocks
+  // inline unless this is set.
+  Scheduler* compression_scheduler = nullptr;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
   // Default: currently false, but may become true later.
   bool reuse_logs = false;
 
+  // Number of threads that apply the records of a log file to the
+  // memtable while the database is recovered in DB::Open().  With the
+  // default of 1, the opening thread reads and applies each record in
+  // turn.  Larger values leave only the reading and checksumming of the
+  // log to the opening thread, which can shorten the recovery of large
+  // logs.  The recovered contents and sequence numbers do not depend on
+  // this setting.
+  int recovery_threads = 1;
+
+  // If greater than zero, DB::Open() starts this many threads that open
+  // the table files of the database, and read their index and filter
+  // blocks, in the background.  Otherwise each table is opened by the
+  // first read that needs it, which can make the reads that follow a
+  // restart slow.  Only as many tables as fit in the table cache (see
+  // max_open_files) are opened, lower levels first.  The progress is
+  // reported by the "leveldb.warm-up-tables" and
+  // "leveldb.warm-up-tables-opened" properties.
+  int warm_up_threads = 0;
+
+  // Number of threads that read data blocks ahead of the iterators that
+  // set ReadOptions::prefetch_blocks.  The threads are shared by all such
+  // iterators, so this bounds the number of prefetch reads in progress at
+  // any time.  They are started by the first iterator that prefetches.
+  int prefetch_threads = 8;
+
+  // If non-null, prefetch reads are run by this scheduler (see
+  // leveldb/scheduler.h), which may be shared with other databases, and
+  // prefetch_threads is ignored.  If null, the DB creates a scheduler of
+  // prefetch_threads threads on env.  Tables opened with Table::Open() do
+  // not prefetch unless this is set.
+  Scheduler* prefetch_scheduler = nullptr;
+
   // If non-null, use the specified filter policy to reduce disk reads.
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
+
+  // If true, new tables are written with a two-level index: a small
+  // top-level index that stays in memory while the table is open, and
+  // index partitions of about block_size bytes each.  The filter, if any,
+  // is partitioned along the same boundaries.  Partitions are loaded on
+  // demand through block_cache, so that they are charged against its
+  // capacity instead of being pinned for as long as the table is open.
+  // This mostly matters for large values of max_file_size.
+  //
+  // Tables written with this option cannot be read by older versions
+  // of leveldb.  Tables in either format can be read regardless of the
+  // value of this option.
+  bool partition_index_and_filters = false;
+
+  // If true, and filter_policy is non-null, new tables store a single
+  // filter over all of their keys, which is checked before the index
+  // block is searched.  A lookup for a key that is not in the table then
+  // costs a single filter probe.  The filter is held in memory while the
+  // table is open, and takes precedence over the partitioned filters of
+  // partition_index_and_filters.  Building a table holds a copy of all of
+  // its keys in memory until the filter is written.
+  //
+  // Tables in either format can be read regardless of the value of this
+  // option.
+  bool whole_table_filter = false;
+
+  // If non-null, and filter_policy is non-null, the filters of new tables
+  // also record the prefix of each key that has one, so that iterators
+  // bounded to a prefix (see ReadOptions::prefix) can leave out the tables
+  // that hold no keys with it.  Only whole-table filters are checked for
+  // prefixes, so this is best combined with whole_table_filter.
+  //
+  // Filters built with a different extractor, or without one, are not
+  // used until compactions have rewritten their tables.
+  const PrefixExtractor* prefix_extractor = nullptr;
+
+  // If false, and prefix_extractor is non-null, filters record only the
+  // prefixes of keys.  This makes them smaller, but Get() can then only
+  // rule out keys whose prefix is absent.
+  bool whole_key_filtering = true;
 };
 
 // Options that control read operations
@@ -157,6 +378,20 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // If positive, an iterator that moves sequentially from one data block
+  // of a table to the next reads up to this many of the following blocks
+  // in the background, so that a long scan does not wait for each block
+  // in turn.  Useful for range scans over data that is not cached.
+  int prefetch_blocks = 0;
+
+  // If non-empty, an iterator only returns the keys with this prefix: the
+  // keys whose prefix under Options::prefix_extractor is "prefix", or,
+  // without an extractor, the keys that start with "prefix".  Seeking to
+  // a key before them positions the iterator at the first of them.  The
+  // tables whose key ranges or filters show that they hold none of them
+  // are left out of the iterator altogether.  Ignored by Get().
+  Slice prefix;
 };
 
 // Options that control write operations
@@ -0,0 +1,63 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PrefixExtractor maps a key to a prefix of it, such as the tenant in
+// keys of the form "tenant|object".  When Options::prefix_extractor is
+// set, the filters of a database also record the prefixes of its keys,
+// so that iterators bounded to one prefix (see ReadOptions::prefix) can
+// skip the tables that hold no keys with that prefix.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PREFIX_EXTRACTOR_H_
+#define STORAGE_LEVELDB_INCLUDE_PREFIX_EXTRACTOR_H_
+
+#include <cstddef>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+// Implementations must be thread-safe, and must be consistent with the
+// comparator of the database: the keys that have a given prefix must sort
+// at or after the prefix itself, and together, with no other keys between
+// them.  Extracting the prefix of a prefix must return it unchanged.
+class LEVELDB_EXPORT PrefixExtractor {
+ public:
+  virtual ~PrefixExtractor();
+
+  // Return the name of this extractor.  The name is recorded with the
+  // filters built using it, and must change whenever the prefixes it
+  // extracts change.
+  virtual const char* Name() const = 0;
+
+  // Return true iff "key" has a prefix.  Keys without one are never
+  // matched by prefix filters or by prefix iterators.
+  virtual bool InDomain(const Slice& key) const = 0;
+
+  // Return the prefix of "key", which must refer to the start of the
+  // bytes of "key".
+  // REQUIRES: InDomain(key)
+  virtual Slice Transform(const Slice& key) const = 0;
+};
+
+// Return a new extractor whose prefixes are the first "length" bytes of
+// keys.  Shorter keys have no prefix.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const PrefixExtractor* NewFixedPrefixExtractor(size_t length);
+
+// Return a new extractor whose prefixes run up to and including the first
+// occurrence of "delimiter" in keys.  Keys that do not contain it have no
+// prefix.  For example, the prefix of "tenant|object" is "tenant|" with a
+// delimiter of '|'.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const PrefixExtractor* NewDelimitedPrefixExtractor(
+    char delimiter);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PREFIX_EXTRACTOR_H_
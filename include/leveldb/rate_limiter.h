@@ -0,0 +1,66 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A RateLimiter bounds the rate at which a database writes table files in
+// the background, so that memtable compactions and compactions do not
+// saturate the device and drive up the latency of foreground reads.  A
+// single RateLimiter may be shared by several databases to bound their
+// combined rate.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+#define STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "leveldb/env.h"
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT RateLimiter {
+ public:
+  enum Priority {
+    kLow = 0,   // Compactions
+    kHigh = 1,  // Memtable compactions, which writers may be waiting for
+    kNumPriorities = 2
+  };
+
+  virtual ~RateLimiter();
+
+  // Block until "bytes" bytes may be written at the given priority.
+  virtual void Request(size_t bytes, Priority priority) = 0;
+
+  // Return the current limit in bytes per second.
+  virtual uint64_t GetBytesPerSecond() const = 0;
+
+  // Change the limit to "bytes_per_second".  For an auto-tuned limiter,
+  // this changes the maximum that the limit is tuned up to.
+  virtual void SetBytesPerSecond(uint64_t bytes_per_second) = 0;
+
+  // Return the total number of bytes requested at the given priority.
+  virtual uint64_t GetTotalBytesThrough(Priority priority) const = 0;
+};
+
+// Return a new rate limiter that hands out "bytes_per_second" bytes per
+// second in periodic refills of a token bucket.  Requests that cannot be
+// satisfied are queued, and each refill serves the queued high priority
+// requests before the low priority ones, except for an occasional refill
+// that serves low priority first so that they are not starved.
+//
+// If "auto_tuned" is true, the limit is adjusted between a twentieth of
+// "bytes_per_second" and "bytes_per_second" from the observed backlog:
+// it is raised while requests keep having to wait for refills, and
+// lowered while they rarely do, so that bursts of background writes are
+// spread out without letting compactions fall behind.
+//
+// "env" supplies the clock and the sleeps; it must remain live while the
+// result is in use.
+LEVELDB_EXPORT RateLimiter* NewGenericRateLimiter(
+    uint64_t bytes_per_second, bool auto_tuned = false,
+    Env* env = Env::Default());
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
@@ -0,0 +1,40 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Scheduler runs functions on threads of its own, apart from the
+// background thread behind Env::Schedule(), so that the work it runs
+// neither waits for nor holds up compactions.  A database uses one to
+// read blocks ahead of iterators and to compress the blocks of the
+// tables it builds.  A single Scheduler may be shared by several
+// databases to bound their combined number of threads.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SCHEDULER_H_
+#define STORAGE_LEVELDB_INCLUDE_SCHEDULER_H_
+
+#include "leveldb/env.h"
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT Scheduler {
+ public:
+  virtual ~Scheduler();
+
+  // Arrange to run "(*function)(arg)" once on some thread.  "function"
+  // may block, but must not wait for other functions scheduled here.
+  virtual void Schedule(void (*function)(void* arg), void* arg) = 0;
+};
+
+// Return a new scheduler that runs the scheduled functions in FIFO order
+// on "num_threads" threads, which are started through env->StartThread()
+// the first time a function is scheduled.  Deleting the result runs the
+// functions that are still queued, then waits for the threads to exit.
+//
+// "env" must remain live while the result is in use.
+LEVELDB_EXPORT Scheduler* NewThreadPoolScheduler(int num_threads,
+                                                 Env* env = Env::Default());
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SCHEDULER_H_
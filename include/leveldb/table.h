@@ -13,6 +13,7 @@
 namespace leveldb {
 
 class Block;
+struct BlockContents;
 class BlockHandle;
 class Footer;
 struct Options;
@@ -61,11 +62,53 @@ class LEVELDB_EXPORT Table {
  private:
   friend class TableCache;
   struct Rep;
+  class Prefetcher;
+
+  struct DataFileReader;
 
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
 
+  // Like NewIterator(), but reads the data blocks that are not in the
+  // block cache through *data_file, which must hold the same contents as
+  // the file the table was opened with.  The index and filter are those
+  // already held by the table.  Does not take ownership of *data_file,
+  // which must remain live while the result is in use.  Blocks are not
+  // prefetched.
+  Iterator* NewIterator(const ReadOptions&, RandomAccessFile* data_file) const;
+
+  // Returns an iterator over the block that "index_value" points to.  If
+  // the block is not in the block cache, its contents are taken from
+  // "prefetcher" when it has read them, and read from the file otherwise.
+  // If "point_lookup" is true, the iterator is only used to look up keys
+  // for InternalGet() and InternalMultiGet() (see Block::NewIterator()).
+  // If "data_file" is non-null, the block is read through it instead of
+  // the table's own file.
+  Iterator* NewBlockIterator(const ReadOptions&, const Slice& index_value,
+                             Prefetcher* prefetcher, bool point_lookup = false,
+                             RandomAccessFile* data_file = nullptr) const;
+
   explicit Table(Rep* rep) : rep_(rep) {}
 
+  // Reads the contents of the block identified by "handle", from
+  // options.compressed_block_cache if it is there, and from "file" (or
+  // the table's own file if "file" is null) otherwise.
+  Status ReadBlockContents(const ReadOptions&, const BlockHandle& handle,
+                           BlockContents* contents,
+                           RandomAccessFile* file = nullptr) const;
+
+  // Returns an iterator over the index entries of the data blocks, reading
+  // index partitions as needed if the index is partitioned.
+  Iterator* NewIndexIterator(const ReadOptions&) const;
+
+  // Returns false if the filter for the data block at "block_offset" rules
+  // out "key", reading the filter partition as needed.
+  bool KeyMayMatch(const ReadOptions&, const Slice& key,
+                   uint64_t block_offset) const;
+
+  // Returns false if the whole-table filter rules out "key".  Returns true
+  // if the table has no whole-table filter.
+  bool TableMayMatch(const Slice& key) const;
+
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
   // that key is not present.
@@ -73,8 +116,18 @@ class LEVELDB_EXPORT Table {
                      void (*handle_result)(void* arg, const Slice& k,
                                            const Slice& v));
 
+  // Batched form of InternalGet() for the "n" keys in keys[0..n-1], which
+  // must be sorted in increasing order.  Calls (*handle_result)(args[i], ...)
+  // with the entry found after a Seek(keys[i]).  Each data block is read
+  // at most once even if several of the keys fall inside it.
+  Status InternalMultiGet(const ReadOptions&, int n, const Slice* keys,
+                          void* const* args,
+                          void (*handle_result)(void* arg, const Slice& k,
+                                                const Slice& v));
+
   void ReadMeta(const Footer& footer);
-  void ReadFilter(const Slice& filter_handle_value);
+  void ReadFilter(const Slice& filter_handle_value, bool full_filter);
+  void ReadDictionary(const Slice& dictionary_handle_value);
 
   Rep* const rep_;
 };
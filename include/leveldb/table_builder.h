@@ -14,6 +14,7 @@
 #define STORAGE_LEVELDB_INCLUDE_TABLE_BUILDER_H_
 
 #include <cstdint>
+#include <string>
 
 #include "leveldb/export.h"
 #include "leveldb/options.h"
@@ -76,13 +77,23 @@ class LEVELDB_EXPORT TableBuilder {
   uint64_t NumEntries() const;
 
   // Size of the file generated so far.  If invoked after a successful
-  // Finish() call, returns the size of the final generated file.
+  // Finish() call, returns the size of the final generated file.  With
+  // options.compression_threads > 1, this does not include the few blocks
+  // still being compressed.
   uint64_t FileSize() const;
 
  private:
   bool ok() const { return status().ok(); }
   void WriteBlock(BlockBuilder* block, BlockHandle* handle);
+  void CompressAndWriteBlock(const Slice& raw, bool use_dictionary,
+                             BlockHandle* handle);
+  void AddIndexEntry(std::string* last_key, const Slice& next_key);
+  void FinishIndexPartition(const std::string& last_key);
+  void WriteIndexPartitions();
   void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+  void AppendBlock(const Slice& data, const char* trailer, BlockHandle* handle);
+  void SchedulePendingBlock();
+  void WritePendingBlocks(size_t max_pending);
 
   struct Rep;
   Rep* rep_;
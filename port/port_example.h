@@ -81,6 +81,69 @@ bool Snappy_GetUncompressedLength(const char* input, size_t length,
 bool Snappy_Uncompress(const char* input_data, size_t input_length,
                        char* output);
 
+// A zstd dictionary, "data[0,length-1]", prepared once for compressing
+// many inputs at the given compression level.  Thread-safe.
+class ZstdCompressDictionary {
+ public:
+  ZstdCompressDictionary(const char* data, size_t length, int level);
+  ~ZstdCompressDictionary();
+};
+
+// A zstd dictionary, "data[0,length-1]", prepared once for uncompressing
+// many inputs.  Thread-safe.
+class ZstdUncompressDictionary {
+ public:
+  ZstdUncompressDictionary(const char* data, size_t length);
+  ~ZstdUncompressDictionary();
+};
+
+// Store the zstd compression of "input[0,input_length-1]" in *output,
+// at the given compression level, or with "*dictionary" and the level it
+// was prepared for if "dictionary" is non-null.  Returns false if zstd is
+// not supported by this port.  Implementations should reuse the
+// compression state of the calling thread between calls.
+bool Zstd_Compress(int level, const char* input, size_t input_length,
+                   const ZstdCompressDictionary* dictionary,
+                   std::string* output);
+
+// If input[0,input_length-1] looks like a valid zstd compressed
+// buffer, store the size of the uncompressed data in *result and
+// return true.  Else return false.
+bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                size_t* result);
+
+// Attempt to zstd uncompress input[0,input_length-1] into *output, with
+// the dictionary that it was compressed with, if any.  Returns true if
+// successful, false if the input is invalid zstd compressed data.
+//
+// REQUIRES: at least the first "n" bytes of output[] must be writable
+// where "n" is the result of a successful call to
+// Zstd_GetUncompressedLength.
+bool Zstd_Uncompress(const char* input_data, size_t input_length,
+                     const ZstdUncompressDictionary* dictionary,
+                     char* output);
+
+// Store the lz4 compression of "input[0,input_length-1]" in *output.
+// Returns false if lz4 is not supported by this port.
+bool Lz4_Compress(const char* input, size_t input_length,
+                  std::string* output);
+
+// If input[0,input_length-1] looks like a valid lz4 compressed
+// buffer, store the size of the uncompressed data in *result and
+// return true.  Else return false.
+bool Lz4_GetUncompressedLength(const char* input, size_t length,
+                               size_t* result);
+
+// Attempt to lz4 uncompress input[0,input_length-1] into *output.
+// Returns true if successful, false if the input is invalid lz4
+// compressed data.
+//
+// REQUIRES: at least the first "n" bytes of output[] must be writable
+// where "n" is the result of a successful call to
+// Lz4_GetUncompressedLength.
+bool Lz4_Uncompress(const char* input_data, size_t input_length,
+                    char* output);
+
 // ------------------ Miscellaneous -------------------
 
 // If heap profiling is not supported, returns false.
@@ -28,6 +28,12 @@
 #if HAVE_SNAPPY
 #include <snappy.h>
 #endif  // HAVE_SNAPPY
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif  // HAVE_ZSTD
+#if HAVE_LZ4
+#include <lz4.h>
+#endif  // HAVE_LZ4
 
 #include <cassert>
 #include <condition_variable>  // NOLINT
@@ -126,6 +132,249 @@ inline bool Snappy_Uncompress(const char* input, size_t length, char* output) {
 #endif  // HAVE_SNAPPY
 }
 
+#if HAVE_ZSTD
+// Setting up a zstd context costs more than compressing a small block, so
+// each thread keeps one context for compression and one for decompression.
+inline ZSTD_CCtx* ZstdCompressContext() {
+  struct Context {
+    Context() : ctx(ZSTD_createCCtx()) {}
+    ~Context() { ZSTD_freeCCtx(ctx); }
+    ZSTD_CCtx* const ctx;
+  };
+  static thread_local Context context;
+  return context.ctx;
+}
+
+inline ZSTD_DCtx* ZstdUncompressContext() {
+  struct Context {
+    Context() : ctx(ZSTD_createDCtx()) {}
+    ~Context() { ZSTD_freeDCtx(ctx); }
+    ZSTD_DCtx* const ctx;
+  };
+  static thread_local Context context;
+  return context.ctx;
+}
+#endif  // HAVE_ZSTD
+
+// A zstd dictionary prepared for compression at one level.
+class ZstdCompressDictionary {
+ public:
+  ZstdCompressDictionary(const char* data, size_t length, int level) {
+#if HAVE_ZSTD
+    dict_ = ZSTD_createCDict(data, length, level);
+#else
+    // Silence compiler warnings about unused arguments.
+    (void)data;
+    (void)length;
+    (void)level;
+#endif  // HAVE_ZSTD
+  }
+
+  ZstdCompressDictionary(const ZstdCompressDictionary&) = delete;
+  ZstdCompressDictionary& operator=(const ZstdCompressDictionary&) = delete;
+
+  ~ZstdCompressDictionary() {
+#if HAVE_ZSTD
+    ZSTD_freeCDict(dict_);
+#endif  // HAVE_ZSTD
+  }
+
+#if HAVE_ZSTD
+  const ZSTD_CDict* dict() const { return dict_; }
+
+ private:
+  ZSTD_CDict* dict_;
+#endif  // HAVE_ZSTD
+};
+
+// A zstd dictionary prepared for decompression.
+class ZstdUncompressDictionary {
+ public:
+  ZstdUncompressDictionary(const char* data, size_t length) {
+#if HAVE_ZSTD
+    dict_ = ZSTD_createDDict(data, length);
+#else
+    // Silence compiler warnings about unused arguments.
+    (void)data;
+    (void)length;
+#endif  // HAVE_ZSTD
+  }
+
+  ZstdUncompressDictionary(const ZstdUncompressDictionary&) = delete;
+  ZstdUncompressDictionary& operator=(const ZstdUncompressDictionary&) =
+      delete;
+
+  ~ZstdUncompressDictionary() {
+#if HAVE_ZSTD
+    ZSTD_freeDDict(dict_);
+#endif  // HAVE_ZSTD
+  }
+
+#if HAVE_ZSTD
+  const ZSTD_DDict* dict() const { return dict_; }
+
+ private:
+  ZSTD_DDict* dict_;
+#endif  // HAVE_ZSTD
+};
+
+inline bool Zstd_Compress(int level, const char* input, size_t length,
+                          const ZstdCompressDictionary* dictionary,
+                          std::string* output) {
+#if HAVE_ZSTD
+  size_t outlen = ZSTD_compressBound(length);
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  ZSTD_CCtx* ctx = ZstdCompressContext();
+  if (ctx == nullptr) {
+    return false;
+  }
+  if (dictionary == nullptr) {
+    outlen = ZSTD_compressCCtx(ctx, &(*output)[0], output->size(), input,
+                               length, level);
+  } else if (dictionary->dict() != nullptr) {
+    outlen = ZSTD_compress_usingCDict(ctx, &(*output)[0], output->size(),
+                                      input, length, dictionary->dict());
+  } else {
+    return false;
+  }
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)level;
+  (void)input;
+  (void)length;
+  (void)dictionary;
+  (void)output;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) {
+#if HAVE_ZSTD
+  unsigned long long size = ZSTD_getFrameContentSize(input, length);
+  if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+    return false;
+  }
+  *result = static_cast<size_t>(size);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)result;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_Uncompress(const char* input, size_t length,
+                            const ZstdUncompressDictionary* dictionary,
+                            char* output) {
+#if HAVE_ZSTD
+  size_t outlen;
+  if (!Zstd_GetUncompressedLength(input, length, &outlen)) {
+    return false;
+  }
+  ZSTD_DCtx* ctx = ZstdUncompressContext();
+  if (ctx == nullptr) {
+    return false;
+  }
+  size_t result;
+  if (dictionary == nullptr) {
+    result = ZSTD_decompressDCtx(ctx, output, outlen, input, length);
+  } else if (dictionary->dict() != nullptr) {
+    result = ZSTD_decompress_usingDDict(ctx, output, outlen, input, length,
+                                        dictionary->dict());
+  } else {
+    return false;
+  }
+  return !ZSTD_isError(result) && result == outlen;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)dictionary;
+  (void)output;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+// The LZ4 block format does not record the uncompressed length, so it is
+// stored in front of the compressed data as a 32-bit little-endian value.
+inline bool Lz4_Compress(const char* input, size_t length,
+                         std::string* output) {
+#if HAVE_LZ4
+  if (length > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+    return false;
+  }
+  const int bound = LZ4_compressBound(static_cast<int>(length));
+  output->resize(4 + bound);
+  for (int i = 0; i < 4; i++) {
+    (*output)[i] = static_cast<char>((length >> (8 * i)) & 0xff);
+  }
+  const int outlen = LZ4_compress_default(input, &(*output)[4],
+                                          static_cast<int>(length), bound);
+  if (outlen <= 0) {
+    return false;
+  }
+  output->resize(4 + outlen);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_LZ4
+}
+
+inline bool Lz4_GetUncompressedLength(const char* input, size_t length,
+                                      size_t* result) {
+#if HAVE_LZ4
+  if (length < 4) {
+    return false;
+  }
+  *result = 0;
+  for (int i = 0; i < 4; i++) {
+    *result |= static_cast<size_t>(static_cast<unsigned char>(input[i]))
+               << (8 * i);
+  }
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)result;
+  return false;
+#endif  // HAVE_LZ4
+}
+
+inline bool Lz4_Uncompress(const char* input, size_t length, char* output) {
+#if HAVE_LZ4
+  size_t outlen;
+  if (!Lz4_GetUncompressedLength(input, length, &outlen)) {
+    return false;
+  }
+  const int result =
+      LZ4_decompress_safe(input + 4, output, static_cast<int>(length - 4),
+                          static_cast<int>(outlen));
+  return result >= 0 && static_cast<size_t>(result) == outlen;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_LZ4
+}
+
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg) {
   // Silence compiler warnings about unused arguments.
   (void)func;
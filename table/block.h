@@ -26,17 +26,25 @@ class Block {
   ~Block();
 
   size_t size() const { return size_; }
-  Iterator* NewIterator(const Comparator* comparator);
+
+  // If "point_lookup" is true, the iterator is only used to find the
+  // first entry at or after a sought key with the same user key, and
+  // Seek() may leave it invalid, or positioned at any entry with a
+  // different user key, when there is no such entry.  This allows Seek()
+  // to use the hash index of the block, if any.
+  Iterator* NewIterator(const Comparator* comparator,
+                        bool point_lookup = false);
 
  private:
   class Iter;
 
-  uint32_t NumRestarts() const;
-
   const char* data_;
   size_t size_;
   uint32_t restart_offset_;  // Offset in data_ of restart array
-  bool owned_;               // Block owns data_[]
+  uint32_t num_restarts_;
+  const uint8_t* hash_buckets_;  // Hash index, or nullptr if none
+  uint32_t num_buckets_;
+  bool owned_;                   // Block owns data_[]
 };
 
 }  // namespace leveldb
@@ -25,6 +25,16 @@
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// A block with a hash index has instead:
+//     restarts: uint32[num_restarts]
+//     buckets: uint8[num_buckets]
+//     num_buckets: uint32
+//     num_restarts | kBlockHashIndexFlag: uint32
+// buckets[hash(user key) % num_buckets] is the restart index of the
+// interval where that user key first appears, kBlockHashIndexEmpty if no
+// user key hashes to the bucket, or kBlockHashIndexCollision if user keys
+// from different intervals do.
 
 #include "table/block_builder.h"
 
@@ -33,12 +43,17 @@
 
 #include "leveldb/comparator.h"
 #include "leveldb/options.h"
+#include "table/format.h"
 #include "util/coding.h"
 
 namespace leveldb {
 
-BlockBuilder::BlockBuilder(const Options* options)
-    : options_(options), restarts_(), counter_(0), finished_(false) {
+BlockBuilder::BlockBuilder(const Options* options, bool hash_index)
+    : options_(options),
+      hash_index_(hash_index),
+      restarts_(),
+      counter_(0),
+      finished_(false) {
   assert(options->block_restart_interval >= 1);
   restarts_.push_back(0);  // First restart point is at offset 0
 }
@@ -47,15 +62,27 @@ void BlockBuilder::Reset() {
   buffer_.clear();
   restarts_.clear();
   restarts_.push_back(0);  // First restart point is at offset 0
+  hashed_keys_.clear();
   counter_ = 0;
   finished_ = false;
   last_key_.clear();
 }
 
+// Returns the number of buckets in the hash index for "num_keys" keys:
+// about four buckets for every three keys, and odd so that the bucket
+// does not depend on just the low bits of the hash.
+static uint32_t NumHashBuckets(size_t num_keys) {
+  return static_cast<uint32_t>(num_keys * 4 / 3) | 1;
+}
+
 size_t BlockBuilder::CurrentSizeEstimate() const {
-  return (buffer_.size() +                       // Raw data buffer
-          restarts_.size() * sizeof(uint32_t) +  // Restart array
-          sizeof(uint32_t));                     // Restart array length
+  size_t estimate = (buffer_.size() +                       // Raw data buffer
+                     restarts_.size() * sizeof(uint32_t) +  // Restart array
+                     sizeof(uint32_t));  // Restart array length
+  if (hash_index_) {
+    estimate += NumHashBuckets(hashed_keys_.size()) + sizeof(uint32_t);
+  }
+  return estimate;
 }
 
 Slice BlockBuilder::Finish() {
@@ -63,7 +90,26 @@ Slice BlockBuilder::Finish() {
   for (size_t i = 0; i < restarts_.size(); i++) {
     PutFixed32(&buffer_, restarts_[i]);
   }
-  PutFixed32(&buffer_, restarts_.size());
+  uint32_t num_restarts = restarts_.size();
+  if (hash_index_ && num_restarts <= kBlockHashIndexMaxRestarts) {
+    // Append hash index
+    const uint32_t num_buckets = NumHashBuckets(hashed_keys_.size());
+    const size_t buckets_offset = buffer_.size();
+    buffer_.append(num_buckets, static_cast<char>(kBlockHashIndexEmpty));
+    for (size_t i = 0; i < hashed_keys_.size(); i++) {
+      char* bucket =
+          &buffer_[buckets_offset + hashed_keys_[i].first % num_buckets];
+      const uint8_t restart_index = hashed_keys_[i].second;
+      if (static_cast<uint8_t>(*bucket) == kBlockHashIndexEmpty) {
+        *bucket = static_cast<char>(restart_index);
+      } else if (static_cast<uint8_t>(*bucket) != restart_index) {
+        *bucket = static_cast<char>(kBlockHashIndexCollision);
+      }
+    }
+    PutFixed32(&buffer_, num_buckets);
+    num_restarts |= kBlockHashIndexFlag;
+  }
+  PutFixed32(&buffer_, num_restarts);
   finished_ = true;
   return Slice(buffer_);
 }
@@ -86,6 +132,14 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
     restarts_.push_back(buffer_.size());
     counter_ = 0;
   }
+  if (hash_index_) {
+    // A key that hashes like the key before it, usually another version
+    // of the same user key, is found by scanning on from the earlier key.
+    const uint32_t hash = BlockHashIndexHash(key);
+    if (hashed_keys_.empty() || hash != hashed_keys_.back().first) {
+      hashed_keys_.emplace_back(hash, restarts_.size() - 1);
+    }
+  }
   const size_t non_shared = key.size() - shared;
 
   // Add "<shared><non_shared><value_size>" to buffer_
@@ -4,6 +4,10 @@
 
 #include "table/format.h"
 
+#include <cstring>
+
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "table/block.h"
@@ -33,8 +37,10 @@ void Footer::EncodeTo(std::string* dst) const {
   metaindex_handle_.EncodeTo(dst);
   index_handle_.EncodeTo(dst);
   dst->resize(2 * BlockHandle::kMaxEncodedLength);  // Padding
-  PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber & 0xffffffffu));
-  PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber >> 32));
+  const uint64_t magic =
+      partitioned_index_ ? kPartitionedTableMagicNumber : kTableMagicNumber;
+  PutFixed32(dst, static_cast<uint32_t>(magic & 0xffffffffu));
+  PutFixed32(dst, static_cast<uint32_t>(magic >> 32));
   assert(dst->size() == original_size + kEncodedLength);
   (void)original_size;  // Disable unused variable warning.
 }
@@ -45,7 +51,11 @@ Status Footer::DecodeFrom(Slice* input) {
   const uint32_t magic_hi = DecodeFixed32(magic_ptr + 4);
   const uint64_t magic = ((static_cast<uint64_t>(magic_hi) << 32) |
                           (static_cast<uint64_t>(magic_lo)));
-  if (magic != kTableMagicNumber) {
+  if (magic == kPartitionedTableMagicNumber) {
+    partitioned_index_ = true;
+  } else if (magic == kTableMagicNumber) {
+    partitioned_index_ = false;
+  } else {
     return Status::Corruption("not an sstable (bad magic number)");
   }
 
@@ -61,8 +71,70 @@ Status Footer::DecodeFrom(Slice* input) {
   return result;
 }
 
+// Uncompress the n bytes at data, compressed as indicated by "type", into
+// a new heap-allocated buffer.
+static Status UncompressContents(
+    char type, const char* data, size_t n,
+    const port::ZstdUncompressDictionary* dictionary, BlockContents* result) {
+  size_t ulength = 0;
+  char* ubuf = nullptr;
+  switch (type) {
+    case kSnappyCompression: {
+      if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
+        return Status::Corruption("corrupted snappy compressed block contents");
+      }
+      ubuf = new char[ulength];
+      if (!port::Snappy_Uncompress(data, n, ubuf)) {
+        delete[] ubuf;
+        return Status::Corruption("corrupted snappy compressed block contents");
+      }
+      break;
+    }
+    case kZstdCompression: {
+      if (!port::Zstd_GetUncompressedLength(data, n, &ulength)) {
+        return Status::Corruption("corrupted zstd compressed block contents");
+      }
+      ubuf = new char[ulength];
+      if (!port::Zstd_Uncompress(data, n, dictionary, ubuf)) {
+        delete[] ubuf;
+        return Status::Corruption("corrupted zstd compressed block contents");
+      }
+      break;
+    }
+    case kLz4Compression: {
+      if (!port::Lz4_GetUncompressedLength(data, n, &ulength)) {
+        return Status::Corruption("corrupted lz4 compressed block contents");
+      }
+      ubuf = new char[ulength];
+      if (!port::Lz4_Uncompress(data, n, ubuf)) {
+        delete[] ubuf;
+        return Status::Corruption("corrupted lz4 compressed block contents");
+      }
+      break;
+    }
+    default:
+      return Status::Corruption("bad block type");
+  }
+  result->data = Slice(ubuf, ulength);
+  result->heap_allocated = true;
+  result->cachable = true;
+  return Status::OK();
+}
+
+bool BlockHashIndexSupported(const Comparator* comparator) {
+  // Tables written by a DB are ordered by an InternalKeyComparator, which
+  // compares user keys with the comparator that it wraps.
+  if (std::strcmp(comparator->Name(), "leveldb.InternalKeyComparator") == 0) {
+    comparator =
+        static_cast<const InternalKeyComparator*>(comparator)->user_comparator();
+  }
+  return comparator == BytewiseComparator();
+}
+
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result) {
+                 const BlockHandle& handle, BlockContents* result,
+                 std::string* compressed,
+                 const port::ZstdUncompressDictionary* dictionary) {
   result->data = Slice();
   result->cachable = false;
   result->heap_allocated = false;
@@ -112,30 +184,29 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
 
       // Ok
       break;
-    case kSnappyCompression: {
-      size_t ulength = 0;
-      if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
-        delete[] buf;
-        return Status::Corruption("corrupted compressed block contents");
-      }
-      char* ubuf = new char[ulength];
-      if (!port::Snappy_Uncompress(data, n, ubuf)) {
-        delete[] buf;
-        delete[] ubuf;
-        return Status::Corruption("corrupted compressed block contents");
-      }
-      delete[] buf;
-      result->data = Slice(ubuf, ulength);
-      result->heap_allocated = true;
-      result->cachable = true;
-      break;
-    }
     default:
+      s = UncompressContents(data[n], data, n, dictionary, result);
+      if (s.ok() && compressed != nullptr) {
+        compressed->assign(data, n + 1);
+      }
       delete[] buf;
-      return Status::Corruption("bad block type");
+      return s;
   }
 
   return Status::OK();
 }
 
+Status UncompressBlock(const Slice& compressed, BlockContents* result,
+                       const port::ZstdUncompressDictionary* dictionary) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+  if (compressed.empty()) {
+    return Status::Corruption("empty compressed block");
+  }
+  const size_t n = compressed.size() - 1;
+  return UncompressContents(compressed[n], compressed.data(), n, dictionary,
+                            result);
+}
+
 }  // namespace leveldb
@@ -11,9 +11,13 @@
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 #include "leveldb/table_builder.h"
+#include "port/port.h"
+#include "util/hash.h"
 
 namespace leveldb {
 
+class Comparator;
+
 class Block;
 class RandomAccessFile;
 struct ReadOptions;
@@ -52,7 +56,7 @@ class Footer {
   // of two block handles and a magic number.
   enum { kEncodedLength = 2 * BlockHandle::kMaxEncodedLength + 8 };
 
-  Footer() = default;
+  Footer() : partitioned_index_(false) {}
 
   // The block handle for the metaindex block of the table
   const BlockHandle& metaindex_handle() const { return metaindex_handle_; }
@@ -62,12 +66,19 @@ class Footer {
   const BlockHandle& index_handle() const { return index_handle_; }
   void set_index_handle(const BlockHandle& h) { index_handle_ = h; }
 
+  // True iff the index block is the top level of a partitioned index.
+  // Such tables are written with a different magic number so that older
+  // readers refuse them instead of misreading the index.
+  bool partitioned_index() const { return partitioned_index_; }
+  void set_partitioned_index(bool p) { partitioned_index_ = p; }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(Slice* input);
 
  private:
   BlockHandle metaindex_handle_;
   BlockHandle index_handle_;
+  bool partitioned_index_;
 };
 
 // kTableMagicNumber was picked by running
@@ -75,9 +86,41 @@ class Footer {
 // and taking the leading 64 bits.
 static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 
+// kPartitionedTableMagicNumber was picked by running
+//    echo http://code.google.com/p/leveldb/#partitioned | sha1sum
+// and taking the leading 64 bits.
+static const uint64_t kPartitionedTableMagicNumber = 0x9675b0ddcc07146eull;
+
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// A data block may end with a hash index that maps the user key of each
+// entry to the restart interval in which that key first appears.  Such
+// blocks set kBlockHashIndexFlag in their restart count.  Each bucket of
+// the index holds a restart index, or one of the two values below.  A
+// block with more than kBlockHashIndexMaxRestarts restart points is
+// written without an index.
+static const uint32_t kBlockHashIndexFlag = 1u << 31;
+static const uint8_t kBlockHashIndexEmpty = 255;
+static const uint8_t kBlockHashIndexCollision = 254;
+static const uint32_t kBlockHashIndexMaxRestarts = 253;
+
+// Returns the hash under which "key" is stored in a block hash index.
+// Data blocks written by a DB hold internal keys, and only their user key
+// part (see db/dbformat.h) is hashed, so that a lookup finds every
+// version of a key.
+inline uint32_t BlockHashIndexHash(const Slice& key) {
+  const size_t n = key.size() >= 8 ? key.size() - 8 : key.size();
+  return Hash(key.data(), n, 0x6b7c5a39);
+}
+
+// Returns true if block hash indexes may be written and used for keys
+// ordered by "comparator".  The index finds keys by the hash of their
+// bytes, which only works if keys are equal exactly when their bytes are,
+// so this is only true for BytewiseComparator() and for the internal key
+// comparator of a DB that uses it.
+bool BlockHashIndexSupported(const Comparator* comparator);
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
@@ -85,9 +128,21 @@ struct BlockContents {
 };
 
 // Read the block identified by "handle" from "file".  On failure
-// return non-OK.  On success fill *result and return OK.
+// return non-OK.  On success fill *result and return OK.  If
+// "compressed" is non-null and the block is stored compressed, the
+// compressed contents followed by the compression type byte are also
+// stored in *compressed; otherwise *compressed is left unchanged.
+// "dictionary" is the table's zstd dictionary, if it has one.
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result);
+                 const BlockHandle& handle, BlockContents* result,
+                 std::string* compressed = nullptr,
+                 const port::ZstdUncompressDictionary* dictionary = nullptr);
+
+// Uncompress a block saved by ReadBlock() into *compressed.  On failure
+// return non-OK.  On success fill *result and return OK.
+Status UncompressBlock(
+    const Slice& compressed, BlockContents* result,
+    const port::ZstdUncompressDictionary* dictionary = nullptr);
 
 // Implementation details follow.  Clients should ignore,
 
@@ -4,16 +4,20 @@
 
 #include "leveldb/table.h"
 
+#include <deque>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/scheduler.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -22,17 +26,39 @@ struct Table::Rep {
     delete filter;
     delete[] filter_data;
     delete index_block;
+    delete zstd_dictionary;
   }
 
   Options options;
   Status status;
   RandomAccessFile* file;
   uint64_t cache_id;
+  uint64_t compressed_cache_id;
   FilterBlockReader* filter;
   const char* filter_data;
 
+  // Filter over all keys of the table, if it was built with
+  // whole_table_filter.  Points into filter_data when that is non-null.
+  bool has_full_filter;
+  Slice full_filter;
+
+  // Whether point lookups may use the hash indexes of data blocks.  They
+  // are ignored unless the comparator orders keys bytewise.
+  bool hash_index_supported;
+
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
+
+  // If partitioned_index, index_block is the top-level index, whose
+  // entries point to index partitions.  If partitioned_filter as well,
+  // each entry also points to the filter partition for the same data
+  // blocks.  Partitions are read through the block cache when needed.
+  bool partitioned_index;
+  bool partitioned_filter;
+
+  // The dictionary that zstd compressed data blocks were compressed with,
+  // if the table has one, or nullptr.
+  port::ZstdUncompressDictionary* zstd_dictionary;
 };
 
 Status Table::Open(const Options& options, RandomAccessFile* file,
@@ -67,10 +93,19 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     Rep* rep = new Table::Rep;
     rep->options = options;
     rep->file = file;
+    rep->hash_index_supported = BlockHashIndexSupported(options.comparator);
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
+    rep->partitioned_index = footer.partitioned_index();
+    rep->partitioned_filter = false;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+    rep->compressed_cache_id =
+        (options.compressed_block_cache
+             ? options.compressed_block_cache->NewId()
+             : 0);
     rep->filter_data = nullptr;
+    rep->zstd_dictionary = nullptr;
+    rep->has_full_filter = false;
     rep->filter = nullptr;
     *table = new Table(rep);
     (*table)->ReadMeta(footer);
@@ -80,10 +115,6 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
 }
 
 void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
-  }
-
   // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
   // it is an empty block.
   ReadOptions opt;
@@ -98,17 +129,56 @@ void Table::ReadMeta(const Footer& footer) {
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  iter->Seek("zstd.dictionary");
+  if (iter->Valid() && iter->key() == Slice("zstd.dictionary")) {
+    ReadDictionary(iter->value());
+  }
+  if (rep_->options.filter_policy != nullptr) {
+    std::string key = "fullfilter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value(), true);
+    } else {
+      key = rep_->partitioned_index ? "partitionedfilter." : "filter.";
+      key.append(rep_->options.filter_policy->Name());
+      iter->Seek(key);
+      if (iter->Valid() && iter->key() == Slice(key)) {
+        if (rep_->partitioned_index) {
+          rep_->partitioned_filter = true;
+        } else {
+          ReadFilter(iter->value(), false);
+        }
+      }
+    }
   }
   delete iter;
   delete meta;
 }
 
-void Table::ReadFilter(const Slice& filter_handle_value) {
+void Table::ReadDictionary(const Slice& dictionary_handle_value) {
+  Slice v = dictionary_handle_value;
+  BlockHandle dictionary_handle;
+  if (!dictionary_handle.DecodeFrom(&v).ok()) {
+    return;  // Blocks that need the dictionary will fail to uncompress
+  }
+
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents block;
+  if (!ReadBlock(rep_->file, opt, dictionary_handle, &block).ok()) {
+    return;
+  }
+  rep_->zstd_dictionary = new port::ZstdUncompressDictionary(
+      block.data.data(), block.data.size());
+  if (block.heap_allocated) {
+    delete[] block.data.data();
+  }
+}
+
+void Table::ReadFilter(const Slice& filter_handle_value, bool full_filter) {
   Slice v = filter_handle_value;
   BlockHandle filter_handle;
   if (!filter_handle.DecodeFrom(&v).ok()) {
@@ -128,7 +198,13 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   if (block.heap_allocated) {
     rep_->filter_data = block.data.data();  // Will need to delete later
   }
-  rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
+  if (full_filter) {
+    rep_->has_full_filter = true;
+    rep_->full_filter = block.data;
+  } else {
+    rep_->filter =
+        new FilterBlockReader(rep_->options.filter_policy, block.data);
+  }
 }
 
 Table::~Table() { delete rep_; }
@@ -148,12 +224,284 @@ static void ReleaseBlock(void* arg, void* h) {
   cache->Release(handle);
 }
 
+static void DeleteCachedCompressedBlock(const Slice& key, void* value) {
+  std::string* compressed = reinterpret_cast<std::string*>(value);
+  delete compressed;
+}
+
+Status Table::ReadBlockContents(const ReadOptions& options,
+                                const BlockHandle& handle,
+                                BlockContents* contents,
+                                RandomAccessFile* file) const {
+  if (file == nullptr) {
+    file = rep_->file;
+  }
+  Cache* compressed_cache = rep_->options.compressed_block_cache;
+  if (compressed_cache == nullptr) {
+    return ReadBlock(file, options, handle, contents, nullptr,
+                     rep_->zstd_dictionary);
+  }
+
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, rep_->compressed_cache_id);
+  EncodeFixed64(cache_key_buffer + 8, handle.offset());
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  Cache::Handle* cache_handle = compressed_cache->Lookup(key);
+  if (cache_handle != nullptr) {
+    const std::string* compressed = reinterpret_cast<std::string*>(
+        compressed_cache->Value(cache_handle));
+    Status s = UncompressBlock(*compressed, contents, rep_->zstd_dictionary);
+    compressed_cache->Release(cache_handle);
+    return s;
+  }
+
+  std::string* compressed = new std::string;
+  Status s = ReadBlock(file, options, handle, contents, compressed,
+                       rep_->zstd_dictionary);
+  if (s.ok() && !compressed->empty() && options.fill_cache) {
+    compressed_cache->Release(compressed_cache->Insert(
+        key, compressed, compressed->size(), &DeleteCachedCompressedBlock));
+  } else {
+    delete compressed;
+  }
+  return s;
+}
+
+// A filter partition, as held in the block cache.
+struct FilterPartition {
+  FilterPartition(const FilterPolicy* policy, const BlockContents& contents)
+      : contents(contents), reader(policy, contents.data) {}
+  ~FilterPartition() {
+    if (contents.heap_allocated) {
+      delete[] contents.data.data();
+    }
+  }
+
+  BlockContents contents;
+  FilterBlockReader reader;
+};
+
+static void DeleteCachedFilterPartition(const Slice& key, void* value) {
+  delete reinterpret_cast<FilterPartition*>(value);
+}
+
+// Reads data blocks on options.prefetch_scheduler for an iterator that moves
+// through the table sequentially, and holds on to their contents until the
+// iterator reaches them.  Blocks that are in the block cache are not read.
+class Table::Prefetcher {
+ public:
+  Prefetcher(const Table* table, const ReadOptions& options)
+      : table_(table), options_(options), read_cv_(&mu_), pending_(0) {}
+
+  Prefetcher(const Prefetcher&) = delete;
+  Prefetcher& operator=(const Prefetcher&) = delete;
+
+  // Waits for the reads in progress, since they use the table.
+  ~Prefetcher() {
+    MutexLock l(&mu_);
+    while (!slots_.empty()) {
+      Abandon(slots_.front());
+      slots_.pop_front();
+    }
+    while (pending_ > 0) {
+      read_cv_.Wait();
+    }
+  }
+
+  // The functions for NewPrefetchingTwoLevelIterator(), whose "arg" is
+  // the Prefetcher.
+  static Iterator* BlockReader(void* arg, const ReadOptions& options,
+                               const Slice& index_value) {
+    Prefetcher* prefetcher = reinterpret_cast<Prefetcher*>(arg);
+    return prefetcher->table_->NewBlockIterator(options, index_value,
+                                                prefetcher);
+  }
+  static void Prefetch(void* arg, const Slice& index_value);
+
+  // Cleanup function for the iterator.
+  static void Delete(void* arg, void* ignored) {
+    delete reinterpret_cast<Prefetcher*>(arg);
+  }
+
+  // If the block at "handle" has been prefetched, waits for its read to
+  // finish.  Returns true and stores the block in *contents if the read
+  // succeeded.
+  bool Take(const BlockHandle& handle, BlockContents* contents);
+
+ private:
+  // A block that has been or is being read in the background.
+  struct Slot {
+    Prefetcher* prefetcher;
+    BlockHandle handle;
+    bool done;       // The read has finished
+    bool abandoned;  // The slot is no longer wanted: free it when done
+    Status status;
+    BlockContents contents;
+  };
+
+  static void ReadSlot(void* arg);
+  void Abandon(Slot* slot) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const Table* const table_;
+  const ReadOptions options_;
+
+  port::Mutex mu_;
+  port::CondVar read_cv_ GUARDED_BY(mu_);  // Signalled when a read finishes
+  std::deque<Slot*> slots_ GUARDED_BY(mu_);  // In the order they were issued
+  int pending_ GUARDED_BY(mu_);              // Number of reads in progress
+};
+
+static void FreeContents(const BlockContents& contents) {
+  if (contents.heap_allocated) {
+    delete[] contents.data.data();
+  }
+}
+
+void Table::Prefetcher::Prefetch(void* arg, const Slice& index_value) {
+  Prefetcher* prefetcher = reinterpret_cast<Prefetcher*>(arg);
+  const Table* table = prefetcher->table_;
+  BlockHandle handle;
+  Slice input = index_value;
+  if (!handle.DecodeFrom(&input).ok()) {
+    return;  // The error will be reported when the block is needed
+  }
+
+  Cache* block_cache = table->rep_->options.block_cache;
+  if (block_cache != nullptr) {
+    char cache_key_buffer[16];
+    EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
+    EncodeFixed64(cache_key_buffer + 8, handle.offset());
+    // Contains() rather than Lookup(), so that probing does not count as
+    // a use of the block: under a segmented cache, a lookup would promote
+    // blocks that the scan then reads only once.
+    if (block_cache->Contains(
+            Slice(cache_key_buffer, sizeof(cache_key_buffer)))) {
+      return;
+    }
+  }
+
+  Slot* slot;
+  {
+    MutexLock l(&prefetcher->mu_);
+    std::deque<Slot*>& slots = prefetcher->slots_;
+    for (size_t i = 0; i < slots.size(); i++) {
+      if (slots[i]->handle.offset() == handle.offset()) {
+        return;  // Already prefetched
+      }
+    }
+    // Bound the memory held by blocks that the iterator skipped over.
+    while (slots.size() >=
+           2 * static_cast<size_t>(prefetcher->options_.prefetch_blocks)) {
+      prefetcher->Abandon(slots.front());
+      slots.pop_front();
+    }
+    slot = new Slot;
+    slot->prefetcher = prefetcher;
+    slot->handle = handle;
+    slot->done = false;
+    slot->abandoned = false;
+    slots.push_back(slot);
+    prefetcher->pending_++;
+  }
+  table->rep_->options.prefetch_scheduler->Schedule(&Prefetcher::ReadSlot,
+                                                    slot);
+}
+
+void Table::Prefetcher::ReadSlot(void* arg) {
+  Slot* slot = reinterpret_cast<Slot*>(arg);
+  Prefetcher* prefetcher = slot->prefetcher;
+  BlockContents contents;
+  Status s = prefetcher->table_->ReadBlockContents(prefetcher->options_,
+                                                   slot->handle, &contents);
+
+  MutexLock l(&prefetcher->mu_);
+  if (slot->abandoned) {
+    if (s.ok()) {
+      FreeContents(contents);
+    }
+    delete slot;
+  } else {
+    slot->status = s;
+    slot->contents = contents;
+    slot->done = true;
+  }
+  prefetcher->pending_--;
+  prefetcher->read_cv_.SignalAll();
+}
+
+void Table::Prefetcher::Abandon(Slot* slot) {
+  if (slot->done) {
+    if (slot->status.ok()) {
+      FreeContents(slot->contents);
+    }
+    delete slot;
+  } else {
+    slot->abandoned = true;
+  }
+}
+
+bool Table::Prefetcher::Take(const BlockHandle& handle,
+                             BlockContents* contents) {
+  Slot* slot = nullptr;
+  {
+    MutexLock l(&mu_);
+    size_t i = 0;
+    while (i < slots_.size() && slots_[i]->handle.offset() != handle.offset()) {
+      i++;
+    }
+    if (i == slots_.size()) {
+      return false;
+    }
+    slot = slots_[i];
+    while (!slot->done) {
+      read_cv_.Wait();
+    }
+    // Blocks prefetched before this one were skipped by the iterator.
+    for (size_t j = 0; j < i; j++) {
+      Abandon(slots_.front());
+      slots_.pop_front();
+    }
+    slots_.pop_front();
+  }
+
+  bool ok = slot->status.ok();
+  if (ok) {
+    *contents = slot->contents;
+  }
+  delete slot;
+  return ok;
+}
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
-  Table* table = reinterpret_cast<Table*>(arg);
-  Cache* block_cache = table->rep_->options.block_cache;
+  return reinterpret_cast<Table*>(arg)->NewBlockIterator(options, index_value,
+                                                          nullptr);
+}
+
+// The "arg" of the BlockReader for NewIterator(options, data_file).
+struct Table::DataFileReader {
+  const Table* table;
+  RandomAccessFile* file;
+
+  static Iterator* BlockReader(void* arg, const ReadOptions& options,
+                               const Slice& index_value) {
+    DataFileReader* reader = reinterpret_cast<DataFileReader*>(arg);
+    return reader->table->NewBlockIterator(options, index_value, nullptr,
+                                           false, reader->file);
+  }
+
+  static void Delete(void* arg, void* ignored) {
+    delete reinterpret_cast<DataFileReader*>(arg);
+  }
+};
+
+Iterator* Table::NewBlockIterator(const ReadOptions& options,
+                                  const Slice& index_value,
+                                  Prefetcher* prefetcher, bool point_lookup,
+                                  RandomAccessFile* data_file) const {
+  Cache* block_cache = rep_->options.block_cache;
   Block* block = nullptr;
   Cache::Handle* cache_handle = nullptr;
 
@@ -167,14 +515,16 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
     BlockContents contents;
     if (block_cache != nullptr) {
       char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
+      EncodeFixed64(cache_key_buffer, rep_->cache_id);
       EncodeFixed64(cache_key_buffer + 8, handle.offset());
       Slice key(cache_key_buffer, sizeof(cache_key_buffer));
       cache_handle = block_cache->Lookup(key);
       if (cache_handle != nullptr) {
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        if (prefetcher == nullptr || !prefetcher->Take(handle, &contents)) {
+          s = ReadBlockContents(options, handle, &contents, data_file);
+        }
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
@@ -184,7 +534,9 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
         }
       }
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      if (prefetcher == nullptr || !prefetcher->Take(handle, &contents)) {
+        s = ReadBlockContents(options, handle, &contents, data_file);
+      }
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -193,7 +545,8 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 
   Iterator* iter;
   if (block != nullptr) {
-    iter = block->NewIterator(table->rep_->options.comparator);
+    iter = block->NewIterator(rep_->options.comparator,
+                              point_lookup && rep_->hash_index_supported);
     if (cache_handle == nullptr) {
       iter->RegisterCleanup(&DeleteBlock, block, nullptr);
     } else {
@@ -205,27 +558,132 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
   return iter;
 }
 
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const {
+  Iterator* iter = rep_->index_block->NewIterator(rep_->options.comparator);
+  if (rep_->partitioned_index) {
+    // The values of the top-level index start with the handle of an index
+    // partition, so BlockReader can load the partitions like data blocks.
+    iter = NewTwoLevelIterator(iter, &Table::BlockReader,
+                               const_cast<Table*>(this), options);
+  }
+  return iter;
+}
+
+bool Table::KeyMayMatch(const ReadOptions& options, const Slice& key,
+                        uint64_t block_offset) const {
+  if (!rep_->partitioned_index) {
+    return rep_->filter == nullptr ||
+           rep_->filter->KeyMayMatch(block_offset, key);
+  }
+  if (!rep_->partitioned_filter) {
+    return true;
+  }
+
+  // Find the filter partition through the top-level index.
+  BlockHandle index_handle, filter_handle;
+  uint64_t filter_base = 0;
+  bool found = false;
+  Iterator* iter = rep_->index_block->NewIterator(rep_->options.comparator);
+  iter->Seek(key);
+  if (iter->Valid()) {
+    Slice input = iter->value();
+    found = index_handle.DecodeFrom(&input).ok() &&
+            filter_handle.DecodeFrom(&input).ok() &&
+            GetVarint64(&input, &filter_base) && block_offset >= filter_base;
+  }
+  delete iter;
+  if (!found) {
+    return true;  // Errors are treated as potential matches
+  }
+
+  Cache* block_cache = rep_->options.block_cache;
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, rep_->cache_id);
+  EncodeFixed64(cache_key_buffer + 8, filter_handle.offset());
+  Slice cache_key(cache_key_buffer, sizeof(cache_key_buffer));
+  Cache::Handle* cache_handle = nullptr;
+  FilterPartition* partition = nullptr;
+  if (block_cache != nullptr) {
+    cache_handle = block_cache->Lookup(cache_key);
+  }
+  if (cache_handle != nullptr) {
+    partition =
+        reinterpret_cast<FilterPartition*>(block_cache->Value(cache_handle));
+  } else {
+    BlockContents contents;
+    if (!ReadBlock(rep_->file, options, filter_handle, &contents).ok()) {
+      return true;
+    }
+    partition = new FilterPartition(rep_->options.filter_policy, contents);
+    if (block_cache != nullptr && contents.cachable && options.fill_cache) {
+      cache_handle =
+          block_cache->Insert(cache_key, partition, contents.data.size(),
+                              &DeleteCachedFilterPartition);
+    }
+  }
+
+  bool result = partition->reader.KeyMayMatch(block_offset - filter_base, key);
+  if (cache_handle != nullptr) {
+    block_cache->Release(cache_handle);
+  } else {
+    delete partition;
+  }
+  return result;
+}
+
 Iterator* Table::NewIterator(const ReadOptions& options) const {
-  return NewTwoLevelIterator(
-      rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+  if (options.prefetch_blocks <= 0 ||
+      rep_->options.prefetch_scheduler == nullptr) {
+    return NewTwoLevelIterator(NewIndexIterator(options), &Table::BlockReader,
+                               const_cast<Table*>(this), options);
+  }
+
+  // The prefetcher is deleted by the first cleanup function that runs,
+  // so its reads finish while the table is still alive.
+  Prefetcher* prefetcher = new Prefetcher(this, options);
+  Iterator* iter = NewPrefetchingTwoLevelIterator(
+      NewIndexIterator(options), NewIndexIterator(options),
+      &Prefetcher::BlockReader, &Prefetcher::Prefetch, prefetcher, options);
+  iter->RegisterCleanup(&Prefetcher::Delete, prefetcher, nullptr);
+  return iter;
+}
+
+Iterator* Table::NewIterator(const ReadOptions& options,
+                             RandomAccessFile* data_file) const {
+  DataFileReader* reader = new DataFileReader;
+  reader->table = this;
+  reader->file = data_file;
+  Iterator* iter =
+      NewTwoLevelIterator(NewIndexIterator(options), &DataFileReader::BlockReader,
+                          reader, options);
+  iter->RegisterCleanup(&DataFileReader::Delete, reader, nullptr);
+  return iter;
+}
+
+bool Table::TableMayMatch(const Slice& key) const {
+  return !rep_->has_full_filter ||
+         rep_->options.filter_policy->KeyMayMatch(key, rep_->full_filter);
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
                           void (*handle_result)(void*, const Slice&,
                                                 const Slice&)) {
   Status s;
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  if (rep_->has_full_filter &&
+      !rep_->options.filter_policy->KeyMayMatch(k, rep_->full_filter)) {
+    return s;  // Not found, without touching the index
+  }
+  Iterator* iiter = NewIndexIterator(options);
   iiter->Seek(k);
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
-    FilterBlockReader* filter = rep_->filter;
     BlockHandle handle;
-    if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
-        !filter->KeyMayMatch(handle.offset(), k)) {
+    if (handle.DecodeFrom(&handle_value).ok() &&
+        !KeyMayMatch(options, k, handle.offset())) {
       // Not found
     } else {
-      Iterator* block_iter = BlockReader(this, options, iiter->value());
+      Iterator* block_iter =
+          NewBlockIterator(options, iiter->value(), nullptr, true);
       block_iter->Seek(k);
       if (block_iter->Valid()) {
         (*handle_result)(arg, block_iter->key(), block_iter->value());
@@ -241,9 +699,61 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
   return s;
 }
 
+Status Table::InternalMultiGet(const ReadOptions& options, int n,
+                               const Slice* keys, void* const* args,
+                               void (*handle_result)(void*, const Slice&,
+                                                     const Slice&)) {
+  Status s;
+  const Comparator* cmp = rep_->options.comparator;
+  Iterator* iiter = NewIndexIterator(options);
+  Iterator* block_iter = nullptr;
+  uint64_t block_offset = ~static_cast<uint64_t>(0);
+  for (int i = 0; i < n && s.ok(); i++) {
+    if (rep_->has_full_filter &&
+        !rep_->options.filter_policy->KeyMayMatch(keys[i], rep_->full_filter)) {
+      continue;  // Not found
+    }
+
+    // Keys are sorted, so if keys[i] is still covered by the index entry
+    // found for the previous key we can skip the index seek altogether.
+    if (i == 0 || !iiter->Valid() || cmp->Compare(keys[i], iiter->key()) > 0) {
+      iiter->Seek(keys[i]);
+    }
+    if (!iiter->Valid()) {
+      break;  // keys[i..n-1] are all past the last key in the table
+    }
+
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    s = handle.DecodeFrom(&handle_value);
+    if (!s.ok()) {
+      break;
+    }
+    if (!KeyMayMatch(options, keys[i], handle.offset())) {
+      continue;  // Not found
+    }
+
+    if (block_iter == nullptr || handle.offset() != block_offset) {
+      delete block_iter;
+      block_iter = NewBlockIterator(options, iiter->value(), nullptr, true);
+      block_offset = handle.offset();
+    }
+    block_iter->Seek(keys[i]);
+    if (block_iter->Valid()) {
+      (*handle_result)(args[i], block_iter->key(), block_iter->value());
+    }
+    s = block_iter->status();
+  }
+  delete block_iter;
+  if (s.ok()) {
+    s = iiter->status();
+  }
+  delete iiter;
+  return s;
+}
+
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
-  Iterator* index_iter =
-      rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* index_iter = NewIndexIterator(ReadOptions());
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) {
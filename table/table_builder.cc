@@ -5,36 +5,90 @@
 #include "leveldb/table_builder.h"
 
 #include <cassert>
+#include <deque>
+#include <string>
+#include <vector>
 
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/scheduler.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
+namespace {
+
+// A data block handed to the compression threads, along with what is
+// needed to add its index and filter entries once it has been written.
+struct PendingBlock {
+  port::Mutex* mu;
+  port::CondVar* cv;
+  CompressionType compression;
+  int zstd_compression_level;
+  const port::ZstdCompressDictionary* dictionary;  // Null if none
+  std::string raw;         // Uncompressed contents of the block
+  std::string first_key;   // First key in the block
+  std::string last_key;    // Last key in the block
+  std::string keys;        // Keys for the filter block, concatenated
+  std::vector<size_t> key_starts;  // Offset of each key in "keys"
+
+  // Filled in by the compression thread.
+  std::string compressed;
+  Slice contents;  // Either raw or compressed
+  CompressionType type;
+  char trailer[kBlockTrailerSize];
+  bool done;  // Guarded by *mu
+};
+
+}  // namespace
+
 struct TableBuilder::Rep {
   Rep(const Options& opt, WritableFile* f)
       : options(opt),
         index_block_options(opt),
         file(f),
         offset(0),
-        data_block(&options),
+        data_block(&options, opt.data_block_hash_index &&
+                                 BlockHashIndexSupported(opt.comparator)),
         index_block(&index_block_options),
         num_entries(0),
         closed(false),
-        filter_block(opt.filter_policy == nullptr
+        filter_block(opt.filter_policy == nullptr || opt.whole_table_filter
                          ? nullptr
                          : new FilterBlockBuilder(opt.filter_policy)),
-        pending_index_entry(false) {
+        full_filter_block(
+            opt.filter_policy == nullptr || !opt.whole_table_filter
+                ? nullptr
+                : new FullFilterBlockBuilder(opt.filter_policy)),
+        pending_index_entry(false),
+        partitioned(opt.partition_index_and_filters),
+        partition_base(0),
+        zstd_dictionary(opt.zstd_dictionary),
+        used_dictionary(false),
+        prepared_level(0),
+        scheduler(opt.compression_threads > 1 ? opt.compression_scheduler
+                                              : nullptr),
+        max_pending(2 * static_cast<size_t>(opt.compression_threads)),
+        pending_cv(&pending_mu) {
     index_block_options.block_restart_interval = 1;
   }
 
+  // An index partition, and the filter partition for the same data blocks,
+  // set aside until Finish() writes them out.
+  struct IndexPartition {
+    std::string last_key;  // Index key of the last data block
+    std::string index;     // Contents of the index partition
+    std::string filter;    // Contents of the filter partition, if any
+    uint64_t filter_base;  // Offset of the first data block in the partition
+  };
+
   Options options;
   Options index_block_options;
   WritableFile* file;
@@ -46,6 +100,7 @@ struct TableBuilder::Rep {
   int64_t num_entries;
   bool closed;  // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
+  FullFilterBlockBuilder* full_filter_block;
 
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
@@ -60,8 +115,114 @@ struct TableBuilder::Rep {
   BlockHandle pending_handle;  // Handle to add to index block
 
   std::string compressed_output;
+
+  // If partitioned, index_block only holds the entries of the current
+  // index partition, and filter_block only covers the data blocks starting
+  // at partition_base.  Finished partitions are kept in "partitions".
+  const bool partitioned;
+  uint64_t partition_base;
+  std::vector<IndexPartition> partitions;
+
+  // The dictionary for zstd compressed data blocks, and whether any block
+  // has been compressed with it.  If so, Finish() stores a copy of it in
+  // the table.
+  const std::string zstd_dictionary;
+  bool used_dictionary;
+
+  // zstd_dictionary prepared for compression at prepared_level, last in
+  // prepared_dictionaries.  Blocks that are still being compressed may use
+  // the earlier entries, prepared for other levels, so all are kept until
+  // the builder is destroyed.
+  std::vector<port::ZstdCompressDictionary*> prepared_dictionaries;
+  int prepared_level;
+
+  // If non-null, data blocks are compressed and checksummed by
+  // "scheduler", which is options.compression_scheduler and may be shared
+  // with other tables, and written in order by WritePendingBlocks().  The index and filter
+  // entries for a block depend on where it is written, so they are added
+  // when it is written instead of in Add().  At most "max_pending" blocks
+  // are in flight at a time.
+  Scheduler* scheduler;
+  const size_t max_pending;
+  std::deque<PendingBlock*> pending;
+  port::Mutex pending_mu;
+  port::CondVar pending_cv;
+  std::string first_key;             // First key of data_block
+  std::string block_keys;            // Keys of data_block, for filter_block
+  std::vector<size_t> block_key_starts;
+  std::string written_last_key;      // Last key of the last block written
+
+  // Returns the dictionary to compress data blocks with, prepared for
+  // the current zstd_compression_level, or nullptr if there is none.
+  const port::ZstdCompressDictionary* PreparedDictionary() {
+    if (zstd_dictionary.empty()) {
+      return nullptr;
+    }
+    const int level = options.zstd_compression_level;
+    if (prepared_dictionaries.empty() || prepared_level != level) {
+      prepared_dictionaries.push_back(new port::ZstdCompressDictionary(
+          zstd_dictionary.data(), zstd_dictionary.size(), level));
+      prepared_level = level;
+    }
+    return prepared_dictionaries.back();
+  }
 };
 
+// Returns the contents to store for the block "raw", which are either
+// "raw" itself or its compressed form in *compressed, and sets *type to
+// match.
+static Slice CompressBlock(CompressionType compression, int zstd_level,
+                           const port::ZstdCompressDictionary* dictionary,
+                           const Slice& raw, std::string* compressed,
+                           CompressionType* type) {
+  bool compressed_ok = false;
+  switch (compression) {
+    case kNoCompression:
+      break;
+
+    case kSnappyCompression:
+      compressed_ok = port::Snappy_Compress(raw.data(), raw.size(), compressed);
+      break;
+
+    case kZstdCompression:
+      compressed_ok = port::Zstd_Compress(zstd_level, raw.data(), raw.size(),
+                                          dictionary, compressed);
+      break;
+
+    case kLz4Compression:
+      compressed_ok = port::Lz4_Compress(raw.data(), raw.size(), compressed);
+      break;
+  }
+
+  if (compressed_ok && compressed->size() < raw.size() - (raw.size() / 8u)) {
+    *type = compression;
+    return *compressed;
+  }
+  // Compression not requested or not supported, or compressed less
+  // than 12.5%, so just store uncompressed form
+  *type = kNoCompression;
+  return raw;
+}
+
+static void ComputeBlockTrailer(const Slice& contents, CompressionType type,
+                                char* trailer) {
+  trailer[0] = type;
+  uint32_t crc = crc32c::Value(contents.data(), contents.size());
+  crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
+  EncodeFixed32(trailer + 1, crc32c::Mask(crc));
+}
+
+static void CompressPendingBlock(void* arg) {
+  PendingBlock* block = reinterpret_cast<PendingBlock*>(arg);
+  block->contents = CompressBlock(
+      block->compression, block->zstd_compression_level, block->dictionary,
+      block->raw, &block->compressed, &block->type);
+  ComputeBlockTrailer(block->contents, block->type, block->trailer);
+  MutexLock l(block->mu);
+  block->done = true;
+  block->cv->SignalAll();
+}
+
 TableBuilder::TableBuilder(const Options& options, WritableFile* file)
     : rep_(new Rep(options, file)) {
   if (rep_->filter_block != nullptr) {
@@ -71,7 +232,24 @@ TableBuilder::TableBuilder(const Options& options, WritableFile* file)
 
 TableBuilder::~TableBuilder() {
   assert(rep_->closed);  // Catch errors where caller forgot to call Finish()
+  // Wait for the compression threads before freeing the blocks they use.
+  {
+    MutexLock l(&rep_->pending_mu);
+    for (PendingBlock* block : rep_->pending) {
+      while (!block->done) {
+        rep_->pending_cv.Wait();
+      }
+    }
+  }
+  for (PendingBlock* block : rep_->pending) {
+    delete block;
+  }
+  for (port::ZstdCompressDictionary* dictionary :
+       rep_->prepared_dictionaries) {
+    delete dictionary;
+  }
   delete rep_->filter_block;
+  delete rep_->full_filter_block;
   delete rep_;
 }
 
@@ -82,6 +260,30 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   if (options.comparator != rep_->options.comparator) {
     return Status::InvalidArgument("changing comparator while building table");
   }
+  if (options.whole_table_filter != rep_->options.whole_table_filter) {
+    return Status::InvalidArgument(
+        "changing whole_table_filter while building table");
+  }
+  if (options.partition_index_and_filters != rep_->partitioned) {
+    return Status::InvalidArgument(
+        "changing partition_index_and_filters while building table");
+  }
+  if (options.zstd_dictionary != rep_->zstd_dictionary) {
+    return Status::InvalidArgument(
+        "changing zstd_dictionary while building table");
+  }
+  if (options.compression_threads != rep_->options.compression_threads) {
+    return Status::InvalidArgument(
+        "changing compression_threads while building table");
+  }
+  if (options.compression_scheduler != rep_->options.compression_scheduler) {
+    return Status::InvalidArgument(
+        "changing compression_scheduler while building table");
+  }
+  if (options.data_block_hash_index != rep_->options.data_block_hash_index) {
+    return Status::InvalidArgument(
+        "changing data_block_hash_index while building table");
+  }
 
   // Note that any live BlockBuilders point to rep_->options and therefore
   // will automatically pick up the updated options.
@@ -99,17 +301,28 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
     assert(r->options.comparator->Compare(key, Slice(r->last_key)) > 0);
   }
 
-  if (r->pending_index_entry) {
-    assert(r->data_block.empty());
-    r->options.comparator->FindShortestSeparator(&r->last_key, key);
-    std::string handle_encoding;
-    r->pending_handle.EncodeTo(&handle_encoding);
-    r->index_block.Add(r->last_key, Slice(handle_encoding));
-    r->pending_index_entry = false;
+  if (r->scheduler != nullptr) {
+    // Save what WritePendingBlocks() needs to add the index and filter
+    // entries for this block.
+    if (r->data_block.empty()) {
+      r->first_key.assign(key.data(), key.size());
+    }
+    if (r->filter_block != nullptr) {
+      r->block_key_starts.push_back(r->block_keys.size());
+      r->block_keys.append(key.data(), key.size());
+    }
+  } else {
+    if (r->pending_index_entry) {
+      assert(r->data_block.empty());
+      AddIndexEntry(&r->last_key, key);
+    }
+    if (r->filter_block != nullptr) {
+      r->filter_block->AddKey(key);
+    }
   }
 
-  if (r->filter_block != nullptr) {
-    r->filter_block->AddKey(key);
+  if (r->full_filter_block != nullptr) {
+    r->full_filter_block->AddKey(key);
   }
 
   r->last_key.assign(key.data(), key.size());
@@ -127,6 +340,11 @@ void TableBuilder::Flush() {
   assert(!r->closed);
   if (!ok()) return;
   if (r->data_block.empty()) return;
+  if (r->scheduler != nullptr) {
+    SchedulePendingBlock();
+    WritePendingBlocks(r->max_pending);
+    return;
+  }
   assert(!r->pending_index_entry);
   WriteBlock(&r->data_block, &r->pending_handle);
   if (ok()) {
@@ -134,7 +352,7 @@ void TableBuilder::Flush() {
     r->status = r->file->Flush();
   }
   if (r->filter_block != nullptr) {
-    r->filter_block->StartBlock(r->offset);
+    r->filter_block->StartBlock(r->offset - r->partition_base);
   }
 }
 
@@ -144,48 +362,44 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
   //    type: uint8
   //    crc: uint32
   assert(ok());
-  Rep* r = rep_;
-  Slice raw = block->Finish();
-
-  Slice block_contents;
-  CompressionType type = r->options.compression;
-  // TODO(postrelease): Support more compression options: zlib?
-  switch (type) {
-    case kNoCompression:
-      block_contents = raw;
-      break;
+  // Only data blocks use the zstd dictionary, so that the index and
+  // metaindex can be read before the dictionary is loaded.
+  CompressAndWriteBlock(block->Finish(), block == &rep_->data_block, handle);
+  block->Reset();
+}
 
-    case kSnappyCompression: {
-      std::string* compressed = &r->compressed_output;
-      if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
-          compressed->size() < raw.size() - (raw.size() / 8u)) {
-        block_contents = *compressed;
-      } else {
-        // Snappy not supported, or compressed less than 12.5%, so just
-        // store uncompressed form
-        block_contents = raw;
-        type = kNoCompression;
-      }
-      break;
-    }
+void TableBuilder::CompressAndWriteBlock(const Slice& raw, bool use_dictionary,
+                                         BlockHandle* handle) {
+  Rep* r = rep_;
+  const port::ZstdCompressDictionary* dictionary = nullptr;
+  if (use_dictionary && r->options.compression == kZstdCompression) {
+    dictionary = r->PreparedDictionary();
+  }
+  CompressionType type;
+  Slice block_contents =
+      CompressBlock(r->options.compression, r->options.zstd_compression_level,
+                    dictionary, raw, &r->compressed_output, &type);
+  if (type == kZstdCompression && dictionary != nullptr) {
+    r->used_dictionary = true;
   }
   WriteRawBlock(block_contents, type, handle);
   r->compressed_output.clear();
-  block->Reset();
 }
 
 void TableBuilder::WriteRawBlock(const Slice& block_contents,
                                  CompressionType type, BlockHandle* handle) {
+  char trailer[kBlockTrailerSize];
+  ComputeBlockTrailer(block_contents, type, trailer);
+  AppendBlock(block_contents, trailer, handle);
+}
+
+void TableBuilder::AppendBlock(const Slice& block_contents,
+                               const char* trailer, BlockHandle* handle) {
   Rep* r = rep_;
   handle->set_offset(r->offset);
   handle->set_size(block_contents.size());
   r->status = r->file->Append(block_contents);
   if (r->status.ok()) {
-    char trailer[kBlockTrailerSize];
-    trailer[0] = type;
-    uint32_t crc = crc32c::Value(block_contents.data(), block_contents.size());
-    crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
-    EncodeFixed32(trailer + 1, crc32c::Mask(crc));
     r->status = r->file->Append(Slice(trailer, kBlockTrailerSize));
     if (r->status.ok()) {
       r->offset += block_contents.size() + kBlockTrailerSize;
@@ -193,26 +407,195 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents,
   }
 }
 
+void TableBuilder::SchedulePendingBlock() {
+  Rep* r = rep_;
+  PendingBlock* block = new PendingBlock;
+  block->mu = &r->pending_mu;
+  block->cv = &r->pending_cv;
+  block->compression = r->options.compression;
+  block->zstd_compression_level = r->options.zstd_compression_level;
+  block->dictionary = (block->compression == kZstdCompression)
+                          ? r->PreparedDictionary()
+                          : nullptr;
+  block->raw = r->data_block.Finish().ToString();
+  r->data_block.Reset();
+  block->first_key.swap(r->first_key);
+  block->last_key = r->last_key;
+  block->keys.swap(r->block_keys);
+  block->key_starts.swap(r->block_key_starts);
+  block->done = false;
+  r->pending.push_back(block);
+  r->scheduler->Schedule(&CompressPendingBlock, block);
+}
+
+void TableBuilder::WritePendingBlocks(size_t max_pending) {
+  Rep* r = rep_;
+  while (!r->pending.empty()) {
+    PendingBlock* block = r->pending.front();
+    {
+      MutexLock l(&r->pending_mu);
+      while (!block->done) {
+        if (r->pending.size() <= max_pending) {
+          return;
+        }
+        r->pending_cv.Wait();
+      }
+    }
+    r->pending.pop_front();
+
+    // Blocks are written in the order they were built, so this adds the
+    // index and filter entries in the same order as Add() and Flush() do
+    // when blocks are compressed inline.
+    if (ok()) {
+      if (r->pending_index_entry) {
+        AddIndexEntry(&r->written_last_key, block->first_key);
+      }
+      if (r->filter_block != nullptr) {
+        for (size_t i = 0; i < block->key_starts.size(); i++) {
+          const size_t start = block->key_starts[i];
+          const size_t limit = (i + 1 < block->key_starts.size())
+                                   ? block->key_starts[i + 1]
+                                   : block->keys.size();
+          r->filter_block->AddKey(
+              Slice(block->keys.data() + start, limit - start));
+        }
+      }
+      AppendBlock(block->contents, block->trailer, &r->pending_handle);
+      if (ok()) {
+        if (block->type == kZstdCompression && !r->zstd_dictionary.empty()) {
+          r->used_dictionary = true;
+        }
+        r->pending_index_entry = true;
+        r->status = r->file->Flush();
+      }
+      if (r->filter_block != nullptr) {
+        r->filter_block->StartBlock(r->offset - r->partition_base);
+      }
+      r->written_last_key.swap(block->last_key);
+    }
+    delete block;
+  }
+}
+
+void TableBuilder::AddIndexEntry(std::string* last_key, const Slice& next_key) {
+  Rep* r = rep_;
+  r->options.comparator->FindShortestSeparator(last_key, next_key);
+  std::string handle_encoding;
+  r->pending_handle.EncodeTo(&handle_encoding);
+  r->index_block.Add(*last_key, Slice(handle_encoding));
+  r->pending_index_entry = false;
+  if (r->partitioned &&
+      r->index_block.CurrentSizeEstimate() >= r->options.block_size) {
+    FinishIndexPartition(*last_key);
+  }
+}
+
+void TableBuilder::FinishIndexPartition(const std::string& last_key) {
+  Rep* r = rep_;
+  r->partitions.emplace_back();
+  Rep::IndexPartition& partition = r->partitions.back();
+  partition.last_key = last_key;
+  partition.index = r->index_block.Finish().ToString();
+  r->index_block.Reset();
+  partition.filter_base = r->partition_base;
+  if (r->filter_block != nullptr) {
+    partition.filter = r->filter_block->Finish().ToString();
+    delete r->filter_block;
+    r->filter_block = new FilterBlockBuilder(r->options.filter_policy);
+    r->filter_block->StartBlock(0);
+  }
+  r->partition_base = r->offset;
+}
+
+void TableBuilder::WriteIndexPartitions() {
+  Rep* r = rep_;
+  assert(r->index_block.empty());
+  for (size_t i = 0; i < r->partitions.size() && ok(); i++) {
+    const Rep::IndexPartition& partition = r->partitions[i];
+    BlockHandle filter_handle, index_handle;
+    if (r->filter_block != nullptr) {
+      WriteRawBlock(partition.filter, kNoCompression, &filter_handle);
+      if (!ok()) break;
+    }
+    CompressAndWriteBlock(partition.index, false, &index_handle);
+    if (!ok()) break;
+
+    // The top-level index entry points to the index partition, followed by
+    // the filter partition and the offset that its filters are relative to.
+    std::string handle_encoding;
+    index_handle.EncodeTo(&handle_encoding);
+    if (r->filter_block != nullptr) {
+      filter_handle.EncodeTo(&handle_encoding);
+      PutVarint64(&handle_encoding, partition.filter_base);
+    }
+    r->index_block.Add(partition.last_key, Slice(handle_encoding));
+  }
+  r->partitions.clear();
+}
+
 Status TableBuilder::status() const { return rep_->status; }
 
 Status TableBuilder::Finish() {
   Rep* r = rep_;
   Flush();
+  if (r->scheduler != nullptr) {
+    WritePendingBlocks(0);
+  }
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle,
+      dictionary_handle;
+
+  // Add the index entry for the last data block
+  if (ok() && r->pending_index_entry) {
+    r->options.comparator->FindShortSuccessor(&r->last_key);
+    std::string handle_encoding;
+    r->pending_handle.EncodeTo(&handle_encoding);
+    r->index_block.Add(r->last_key, Slice(handle_encoding));
+    r->pending_index_entry = false;
+  }
+
+  // Write index and filter partitions.  This leaves the top-level
+  // index in r->index_block.
+  if (ok() && r->partitioned) {
+    if (!r->index_block.empty()) {
+      FinishIndexPartition(r->last_key);
+    }
+    WriteIndexPartitions();
+  }
 
   // Write filter block
-  if (ok() && r->filter_block != nullptr) {
+  if (ok() && r->filter_block != nullptr && !r->partitioned) {
     WriteRawBlock(r->filter_block->Finish(), kNoCompression,
                   &filter_block_handle);
+  } else if (ok() && r->full_filter_block != nullptr) {
+    WriteRawBlock(r->full_filter_block->Finish(), kNoCompression,
+                  &filter_block_handle);
+  }
+
+  // Write the zstd dictionary
+  if (ok() && r->used_dictionary) {
+    WriteRawBlock(r->zstd_dictionary, kNoCompression, &dictionary_handle);
   }
 
   // Write metaindex block
   if (ok()) {
     BlockBuilder meta_index_block(&r->options);
-    if (r->filter_block != nullptr) {
+    if (r->full_filter_block != nullptr) {
+      // Add mapping from "fullfilter.Name" to location of filter data
+      std::string key = "fullfilter.";
+      key.append(r->options.filter_policy->Name());
+      std::string handle_encoding;
+      filter_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(key, handle_encoding);
+    } else if (r->filter_block != nullptr && r->partitioned) {
+      // Record that the index entries carry filter partitions built by
+      // the named policy.
+      std::string key = "partitionedfilter.";
+      key.append(r->options.filter_policy->Name());
+      meta_index_block.Add(key, Slice());
+    } else if (r->filter_block != nullptr) {
       // Add mapping from "filter.Name" to location of filter data
       std::string key = "filter.";
       key.append(r->options.filter_policy->Name());
@@ -220,6 +603,13 @@ Status TableBuilder::Finish() {
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    if (r->used_dictionary) {
+      // Add mapping from "zstd.dictionary" to location of the dictionary.
+      // Keys must be added in order, and this sorts after the filters.
+      std::string handle_encoding;
+      dictionary_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add("zstd.dictionary", handle_encoding);
+    }
 
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -227,13 +617,6 @@ Status TableBuilder::Finish() {
 
   // Write index block
   if (ok()) {
-    if (r->pending_index_entry) {
-      r->options.comparator->FindShortSuccessor(&r->last_key);
-      std::string handle_encoding;
-      r->pending_handle.EncodeTo(&handle_encoding);
-      r->index_block.Add(r->last_key, Slice(handle_encoding));
-      r->pending_index_entry = false;
-    }
     WriteBlock(&r->index_block, &index_block_handle);
   }
 
@@ -242,6 +625,7 @@ Status TableBuilder::Finish() {
     Footer footer;
     footer.set_metaindex_handle(metaindex_block_handle);
     footer.set_index_handle(index_block_handle);
+    footer.set_partitioned_index(r->partitioned);
     std::string footer_encoding;
     footer.EncodeTo(&footer_encoding);
     r->status = r->file->Append(footer_encoding);
@@ -4,6 +4,7 @@
 
 #include "leveldb/table.h"
 
+#include <atomic>
 #include <map>
 #include <string>
 
@@ -11,9 +12,12 @@
 #include "db/dbformat.h"
 #include "db/memtable.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
+#include "leveldb/scheduler.h"
 #include "leveldb/table_builder.h"
 #include "table/block.h"
 #include "table/block_builder.h"
@@ -109,11 +113,12 @@ class StringSink : public WritableFile {
 class StringSource : public RandomAccessFile {
  public:
   StringSource(const Slice& contents)
-      : contents_(contents.data(), contents.size()) {}
+      : contents_(contents.data(), contents.size()), reads_(0) {}
 
   ~StringSource() override = default;
 
   uint64_t Size() const { return contents_.size(); }
+  int reads() const { return reads_; }
 
   Status Read(uint64_t offset, size_t n, Slice* result,
               char* scratch) const override {
@@ -125,11 +130,13 @@ class StringSource : public RandomAccessFile {
     }
     std::memcpy(scratch, &contents_[offset], n);
     *result = Slice(scratch, n);
+    reads_++;
     return Status::OK();
   }
 
  private:
   std::string contents_;
+  mutable std::atomic<int> reads_;
 };
 
 typedef std::map<std::string, std::string, STLLessThan> KVMap;
@@ -370,7 +377,13 @@ class DBConstructor : public Constructor {
   DB* db_;
 };
 
-enum TestType { TABLE_TEST, BLOCK_TEST, MEMTABLE_TEST, DB_TEST };
+enum TestType {
+  TABLE_TEST,
+  PARTITIONED_TABLE_TEST,
+  BLOCK_TEST,
+  MEMTABLE_TEST,
+  DB_TEST
+};
 
 struct TestArgs {
   TestType type;
@@ -386,6 +399,10 @@ static const TestArgs kTestArgList[] = {
     {TABLE_TEST, true, 1},
     {TABLE_TEST, true, 1024},
 
+    {PARTITIONED_TABLE_TEST, false, 16},
+    {PARTITIONED_TABLE_TEST, false, 1},
+    {PARTITIONED_TABLE_TEST, true, 16},
+
     {BLOCK_TEST, false, 16},
     {BLOCK_TEST, false, 1},
     {BLOCK_TEST, false, 1024},
@@ -423,6 +440,10 @@ class Harness : public testing::Test {
       case TABLE_TEST:
         constructor_ = new TableConstructor(options_.comparator);
         break;
+      case PARTITIONED_TABLE_TEST:
+        options_.partition_index_and_filters = true;
+        constructor_ = new TableConstructor(options_.comparator);
+        break;
       case BLOCK_TEST:
         constructor_ = new BlockConstructor(options_.comparator);
         break;
@@ -638,6 +659,71 @@ TEST_F(Harness, ZeroRestartPointsInBlock) {
   delete iter;
 }
 
+TEST(BlockTest, HashIndex) {
+  InternalKeyComparator cmp(BytewiseComparator());
+  Options options;
+  options.comparator = &cmp;
+  options.block_restart_interval = 4;
+  BlockBuilder plain_builder(&options);
+  BlockBuilder hash_builder(&options, true);
+  char key[20];
+  for (int i = 0; i < 400; i += 2) {
+    std::snprintf(key, sizeof(key), "k%04d", i);
+    for (int seq = 30; seq > 0; seq -= 10) {
+      std::string ikey;
+      AppendInternalKey(&ikey, ParsedInternalKey(key, seq, kTypeValue));
+      plain_builder.Add(ikey, std::to_string(seq));
+      hash_builder.Add(ikey, std::to_string(seq));
+    }
+  }
+  BlockContents contents;
+  contents.cachable = false;
+  contents.heap_allocated = false;
+  contents.data = plain_builder.Finish();
+  Block plain_block(contents);
+  contents.data = hash_builder.Finish();
+  Block hash_block(contents);
+  ASSERT_GT(hash_block.size(), plain_block.size());
+  ASSERT_LT(hash_block.size(), plain_block.size() + 400);
+
+  // The index does not change what an ordinary iterator sees.
+  Iterator* plain_iter = plain_block.NewIterator(&cmp);
+  Iterator* iter = hash_block.NewIterator(&cmp);
+  iter->SeekToFirst();
+  for (plain_iter->SeekToFirst(); plain_iter->Valid(); plain_iter->Next()) {
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(plain_iter->key().ToString(), iter->key().ToString());
+    iter->Next();
+  }
+  ASSERT_TRUE(!iter->Valid());
+  delete iter;
+
+  // A point lookup finds the same entry as a binary search whenever that
+  // entry has the user key that was sought.
+  iter = hash_block.NewIterator(&cmp, true);
+  for (int i = 0; i < 400; i++) {
+    std::snprintf(key, sizeof(key), "k%04d", i);
+    for (int seq = 35; seq > 0; seq -= 10) {
+      std::string target;
+      AppendInternalKey(&target, ParsedInternalKey(key, seq, kTypeValue));
+      plain_iter->Seek(target);
+      iter->Seek(target);
+      ASSERT_LEVELDB_OK(iter->status());
+      if (plain_iter->Valid() &&
+          ExtractUserKey(plain_iter->key()) == Slice(key)) {
+        ASSERT_TRUE(iter->Valid()) << target;
+        ASSERT_EQ(plain_iter->key().ToString(), iter->key().ToString());
+        ASSERT_EQ(plain_iter->value().ToString(), iter->value().ToString());
+      } else {
+        ASSERT_TRUE(!iter->Valid() ||
+                    ExtractUserKey(iter->key()) != Slice(key));
+      }
+    }
+  }
+  delete iter;
+  delete plain_iter;
+}
+
 // Test the empty key
 TEST_F(Harness, SimpleEmptyKey) {
   for (int i = 0; i < kNumTestArgs; i++) {
@@ -784,15 +870,33 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
 }
 
-static bool SnappyCompressionSupported() {
+static bool CompressionSupported(CompressionType type) {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
-  return port::Snappy_Compress(in.data(), in.size(), &out);
+  switch (type) {
+    case kSnappyCompression:
+      return port::Snappy_Compress(in.data(), in.size(), &out);
+    case kZstdCompression:
+      return port::Zstd_Compress(1, in.data(), in.size(), nullptr, &out);
+    case kLz4Compression:
+      return port::Lz4_Compress(in.data(), in.size(), &out);
+    default:
+      return false;
+  }
 }
 
-TEST(TableTest, ApproximateOffsetOfCompressed) {
-  if (!SnappyCompressionSupported())
-    GTEST_SKIP() << "skipping compression tests";
+class CompressionTableTest
+    : public ::testing::TestWithParam<CompressionType> {};
+
+INSTANTIATE_TEST_SUITE_P(CompressionTests, CompressionTableTest,
+                         ::testing::Values(kSnappyCompression,
+                                           kZstdCompression, kLz4Compression));
+
+TEST_P(CompressionTableTest, ApproximateOffsetOfCompressed) {
+  const CompressionType type = GetParam();
+  if (!CompressionSupported(type)) {
+    GTEST_SKIP() << "skipping compression test: " << type;
+  }
 
   Random rnd(301);
   TableConstructor c(BytewiseComparator());
@@ -805,7 +909,7 @@ TEST(TableTest, ApproximateOffsetOfCompressed) {
   KVMap kvmap;
   Options options;
   options.block_size = 1024;
-  options.compression = kSnappyCompression;
+  options.compression = type;
   c.Finish(options, &keys, &kvmap);
 
   // Expected upper and lower bounds of space used by compressible strings.
@@ -824,4 +928,317 @@ TEST(TableTest, ApproximateOffsetOfCompressed) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 2 * min_z, 2 * max_z));
 }
 
+TEST(TableTest, Lz4LengthPrefix) {
+  if (!CompressionSupported(kLz4Compression)) {
+    GTEST_SKIP() << "skipping lz4 tests";
+  }
+
+  // Long enough for every byte of the length prefix to be used.
+  Random rnd(301);
+  std::string input;
+  test::CompressibleString(&rnd, 0.001, (1 << 24) + 0x030201, &input);
+  std::string compressed;
+  ASSERT_TRUE(port::Lz4_Compress(input.data(), input.size(), &compressed));
+  ASSERT_LT(compressed.size(), input.size());
+  ASSERT_EQ(std::string("\x01\x02\x03\x01", 4), compressed.substr(0, 4));
+
+  size_t length;
+  ASSERT_TRUE(port::Lz4_GetUncompressedLength(compressed.data(),
+                                              compressed.size(), &length));
+  ASSERT_EQ(input.size(), length);
+  std::string output(length, '\0');
+  ASSERT_TRUE(
+      port::Lz4_Uncompress(compressed.data(), compressed.size(), &output[0]));
+  ASSERT_EQ(input, output);
+
+  // A prefix that does not match the compressed data is rejected.
+  compressed[0]++;
+  ASSERT_TRUE(port::Lz4_GetUncompressedLength(compressed.data(),
+                                              compressed.size(), &length));
+  output.resize(length);
+  ASSERT_FALSE(
+      port::Lz4_Uncompress(compressed.data(), compressed.size(), &output[0]));
+  ASSERT_FALSE(port::Lz4_GetUncompressedLength(compressed.data(), 3, &length));
+}
+
+TEST(TableTest, ZstdDictionary) {
+  if (!CompressionSupported(kZstdCompression)) {
+    GTEST_SKIP() << "skipping zstd tests";
+  }
+
+  // Small blocks of similar values, which compress much better with a
+  // dictionary drawn from the same kind of data.
+  Random rnd(301);
+  std::string sample;
+  test::RandomString(&rnd, 64, &sample);
+  std::string dictionary;
+  for (int i = 0; i < 64; i++) {
+    dictionary += sample;
+  }
+
+  const int N = 1000;
+  uint64_t sizes[2];
+  for (int use_dictionary = 0; use_dictionary < 2; use_dictionary++) {
+    Options options;
+    options.block_size = 256;
+    options.compression = kZstdCompression;
+    if (use_dictionary) {
+      options.zstd_dictionary = dictionary;
+    }
+    StringSink sink;
+    TableBuilder builder(options, &sink);
+    char key[20];
+    for (int i = 0; i < N; i++) {
+      std::snprintf(key, sizeof(key), "k%06d", i);
+      builder.Add(key, sample);
+    }
+    ASSERT_LEVELDB_OK(builder.Finish());
+    sizes[use_dictionary] = sink.contents().size();
+
+    // The table can be read without the dictionary in the options.
+    StringSource source(sink.contents());
+    Table* table;
+    ASSERT_LEVELDB_OK(
+        Table::Open(Options(), &source, sink.contents().size(), &table));
+    Iterator* iter = table->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      std::snprintf(key, sizeof(key), "k%06d", count++);
+      ASSERT_EQ(key, iter->key().ToString());
+      ASSERT_EQ(sample, iter->value().ToString());
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    ASSERT_EQ(N, count);
+    delete iter;
+    delete table;
+  }
+  ASSERT_LT(sizes[1], sizes[0]);
+}
+
+TEST(TableTest, CompressedBlockCache) {
+  if (!CompressionSupported(kSnappyCompression))
+    GTEST_SKIP() << "skipping compression tests";
+
+  Random rnd(301);
+  Options options;
+  options.block_size = 1024;
+  options.compression = kSnappyCompression;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  std::string value;
+  const int N = 1000;
+  for (int i = 0; i < N; i++) {
+    std::snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, test::CompressibleString(&rnd, 0.25, 100, &value));
+  }
+  ASSERT_LEVELDB_OK(builder.Finish());
+
+  StringSource source(sink.contents());
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.compressed_block_cache = NewLRUCache(8 << 20);
+  Table* table;
+  ASSERT_LEVELDB_OK(
+      Table::Open(options, &source, sink.contents().size(), &table));
+
+  for (int pass = 0; pass < 2; pass++) {
+    const int reads = source.reads();
+    Iterator* iter = table->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      std::snprintf(key, sizeof(key), "k%06d", count++);
+      ASSERT_EQ(key, iter->key().ToString());
+      ASSERT_EQ(100, iter->value().size());
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    ASSERT_EQ(N, count);
+    delete iter;
+
+    if (pass == 0) {
+      // Every data block was read from the file and kept compressed.
+      ASSERT_GT(source.reads(), reads + N * 100 / 1024);
+      ASSERT_GT(options.compressed_block_cache->TotalCharge(), 0);
+      ASSERT_LT(options.compressed_block_cache->TotalCharge(), N * 100 / 2);
+    } else {
+      // Every data block came from the compressed cache.
+      ASSERT_EQ(reads, source.reads());
+    }
+  }
+
+  delete table;
+  delete options.block_cache;
+  delete options.compressed_block_cache;
+}
+
+TEST(TableTest, PrefetchBlocks) {
+  Scheduler* scheduler = NewThreadPoolScheduler(4);
+  Options options;
+  options.prefetch_scheduler = scheduler;
+  options.block_size = 256;
+  options.compression = kNoCompression;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  const int N = 2000;
+  for (int i = 0; i < N; i++) {
+    std::snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, "value");
+  }
+  ASSERT_LEVELDB_OK(builder.Finish());
+
+  StringSource source(sink.contents());
+  Table* table;
+  ASSERT_LEVELDB_OK(
+      Table::Open(options, &source, sink.contents().size(), &table));
+
+  int unprefetched_reads[2];
+  for (int run = 0; run < 4; run++) {
+    const int reverse = run % 2;
+    ReadOptions read_options;
+    read_options.prefetch_blocks = (run < 2) ? 0 : 4;
+    const int reads = source.reads();
+    Iterator* iter = table->NewIterator(read_options);
+    int count = 0;
+    if (reverse) {
+      iter->SeekToLast();
+    } else {
+      iter->SeekToFirst();
+    }
+    while (iter->Valid()) {
+      std::snprintf(key, sizeof(key), "k%06d",
+                    reverse ? N - 1 - count : count);
+      ASSERT_EQ(key, iter->key().ToString());
+      ASSERT_EQ("value", iter->value().ToString());
+      count++;
+      if (reverse) {
+        iter->Prev();
+      } else {
+        iter->Next();
+      }
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    ASSERT_EQ(N, count);
+    delete iter;
+
+    // Each block is read once, whether or not it was prefetched.
+    if (read_options.prefetch_blocks == 0) {
+      unprefetched_reads[reverse] = source.reads() - reads;
+    } else {
+      ASSERT_EQ(unprefetched_reads[reverse], source.reads() - reads);
+    }
+  }
+
+  // An iterator that is deleted in the middle of a scan waits for its
+  // reads to finish.
+  ReadOptions read_options;
+  read_options.prefetch_blocks = 4;
+  Iterator* iter = table->NewIterator(read_options);
+  iter->SeekToFirst();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(iter->Valid());
+    iter->Next();
+  }
+  delete iter;
+
+  delete table;
+  delete scheduler;
+}
+
+TEST(TableTest, ParallelCompression) {
+  const FilterPolicy* policy = NewBloomFilterPolicy(10);
+  Scheduler* scheduler = NewThreadPoolScheduler(4);
+  for (int layout = 0; layout < 3; layout++) {
+    std::string contents[2];
+    for (int parallel = 0; parallel < 2; parallel++) {
+      Options options;
+      options.compression_scheduler = scheduler;
+      options.block_size = 256;
+      options.filter_policy = policy;
+      options.whole_table_filter = (layout == 1);
+      options.partition_index_and_filters = (layout == 2);
+      options.compression_threads = parallel ? 4 : 1;
+      StringSink sink;
+      TableBuilder builder(options, &sink);
+      Random rnd(301);
+      char key[20];
+      std::string value;
+      const int N = 5000;
+      for (int i = 0; i < N; i++) {
+        std::snprintf(key, sizeof(key), "k%06d", i);
+        builder.Add(key, test::CompressibleString(&rnd, 0.5, 50, &value));
+      }
+      ASSERT_LEVELDB_OK(builder.Finish());
+      ASSERT_EQ(sink.contents().size(), builder.FileSize());
+      contents[parallel] = sink.contents();
+
+      StringSource source(sink.contents());
+      Table* table;
+      ASSERT_LEVELDB_OK(
+          Table::Open(options, &source, sink.contents().size(), &table));
+      Iterator* iter = table->NewIterator(ReadOptions());
+      int count = 0;
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        std::snprintf(key, sizeof(key), "k%06d", count++);
+        ASSERT_EQ(key, iter->key().ToString());
+      }
+      ASSERT_LEVELDB_OK(iter->status());
+      ASSERT_EQ(N, count);
+      delete iter;
+      delete table;
+    }
+
+    // Compressing blocks in parallel does not change the table.
+    ASSERT_EQ(contents[0], contents[1]) << "layout " << layout;
+  }
+  delete scheduler;
+  delete policy;
+}
+
+TEST(TableTest, PartitionedIndexUsesBlockCache) {
+  const FilterPolicy* policy = NewBloomFilterPolicy(10);
+  Options options;
+  options.block_size = 256;
+  options.compression = kNoCompression;
+  options.filter_policy = policy;
+  options.partition_index_and_filters = true;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    std::snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, "value");
+  }
+  ASSERT_LEVELDB_OK(builder.Finish());
+
+  StringSource source(sink.contents());
+  options.block_cache = NewLRUCache(8 << 20);
+  Table* table;
+  ASSERT_LEVELDB_OK(
+      Table::Open(options, &source, sink.contents().size(), &table));
+
+  // Opening the table does not load any index or filter partitions.
+  ASSERT_EQ(0, options.block_cache->TotalCharge());
+  uint64_t offset = table->ApproximateOffsetOf("k005000");
+  ASSERT_TRUE(Between(offset, sink.contents().size() / 3,
+                      sink.contents().size() * 2 / 3));
+  const size_t charge = options.block_cache->TotalCharge();
+  ASSERT_GT(charge, 0);
+  ASSERT_LT(charge, 4 * options.block_size);
+
+  Iterator* iter = table->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    std::snprintf(key, sizeof(key), "k%06d", count++);
+    ASSERT_EQ(key, iter->key().ToString());
+  }
+  ASSERT_LEVELDB_OK(iter->status());
+  ASSERT_EQ(N, count);
+  delete iter;
+
+  delete table;
+  delete options.block_cache;
+  delete policy;
+}
+
 }  // namespace leveldb
@@ -14,11 +14,18 @@ namespace leveldb {
 namespace {
 
 typedef Iterator* (*BlockFunction)(void*, const ReadOptions&, const Slice&);
+typedef void (*PrefetchFunction)(void*, const Slice&);
+
+// Number of consecutive moves to the next (or previous) block after which
+// the access pattern is treated as sequential and blocks are prefetched.
+static const int kSequentialMoves = 2;
 
 class TwoLevelIterator : public Iterator {
  public:
-  TwoLevelIterator(Iterator* index_iter, BlockFunction block_function,
-                   void* arg, const ReadOptions& options);
+  TwoLevelIterator(Iterator* index_iter, Iterator* lookahead_iter,
+                   BlockFunction block_function,
+                   PrefetchFunction prefetch_function, void* arg,
+                   const ReadOptions& options);
 
   ~TwoLevelIterator() override;
 
@@ -49,6 +56,8 @@ class TwoLevelIterator : public Iterator {
   }
 
  private:
+  enum Direction { kForward, kReverse };
+
   void SaveError(const Status& s) {
     if (status_.ok() && !s.ok()) status_ = s;
   }
@@ -56,8 +65,11 @@ class TwoLevelIterator : public Iterator {
   void SkipEmptyDataBlocksBackward();
   void SetDataIterator(Iterator* data_iter);
   void InitDataBlock();
+  void ResetPrefetch() { moves_ = 0; }
+  void Prefetch(Direction direction);
 
   BlockFunction block_function_;
+  PrefetchFunction prefetch_function_;  // May be nullptr
   void* arg_;
   const ReadOptions options_;
   Status status_;
@@ -66,20 +78,36 @@ class TwoLevelIterator : public Iterator {
   // If data_iter_ is non-null, then "data_block_handle_" holds the
   // "index_value" passed to block_function_ to create the data_iter_.
   std::string data_block_handle_;
+
+  // Used to find the blocks to prefetch if prefetch_function_ is non-null.
+  // lookahead_ is positioned "ahead_" index entries past index_iter_ in
+  // "direction_", and the blocks in between have been prefetched.
+  IteratorWrapper lookahead_;
+  Direction direction_;
+  int moves_;  // Consecutive moves to another block in direction_
+  int ahead_;
 };
 
 TwoLevelIterator::TwoLevelIterator(Iterator* index_iter,
-                                   BlockFunction block_function, void* arg,
-                                   const ReadOptions& options)
+                                   Iterator* lookahead_iter,
+                                   BlockFunction block_function,
+                                   PrefetchFunction prefetch_function,
+                                   void* arg, const ReadOptions& options)
     : block_function_(block_function),
+      prefetch_function_(prefetch_function),
       arg_(arg),
       options_(options),
       index_iter_(index_iter),
-      data_iter_(nullptr) {}
+      data_iter_(nullptr),
+      lookahead_(lookahead_iter),
+      direction_(kForward),
+      moves_(0),
+      ahead_(0) {}
 
 TwoLevelIterator::~TwoLevelIterator() = default;
 
 void TwoLevelIterator::Seek(const Slice& target) {
+  ResetPrefetch();
   index_iter_.Seek(target);
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.Seek(target);
@@ -87,6 +115,7 @@ void TwoLevelIterator::Seek(const Slice& target) {
 }
 
 void TwoLevelIterator::SeekToFirst() {
+  ResetPrefetch();
   index_iter_.SeekToFirst();
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
@@ -94,6 +123,7 @@ void TwoLevelIterator::SeekToFirst() {
 }
 
 void TwoLevelIterator::SeekToLast() {
+  ResetPrefetch();
   index_iter_.SeekToLast();
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
@@ -120,6 +150,7 @@ void TwoLevelIterator::SkipEmptyDataBlocksForward() {
       return;
     }
     index_iter_.Next();
+    Prefetch(kForward);
     InitDataBlock();
     if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
   }
@@ -133,6 +164,7 @@ void TwoLevelIterator::SkipEmptyDataBlocksBackward() {
       return;
     }
     index_iter_.Prev();
+    Prefetch(kReverse);
     InitDataBlock();
     if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
   }
@@ -160,12 +192,58 @@ void TwoLevelIterator::InitDataBlock() {
   }
 }
 
+void TwoLevelIterator::Prefetch(Direction direction) {
+  if (prefetch_function_ == nullptr || options_.prefetch_blocks <= 0 ||
+      !index_iter_.Valid()) {
+    return;
+  }
+  if (moves_ == 0 || direction != direction_) {
+    direction_ = direction;
+    moves_ = 0;
+    ahead_ = 0;
+  }
+  moves_++;
+  if (moves_ < kSequentialMoves) {
+    return;
+  }
+
+  if (ahead_ > 0) {
+    // index_iter_ has moved one entry closer to lookahead_
+    ahead_--;
+  } else {
+    lookahead_.Seek(index_iter_.key());
+  }
+  while (ahead_ < options_.prefetch_blocks && lookahead_.Valid()) {
+    if (direction == kForward) {
+      lookahead_.Next();
+    } else {
+      lookahead_.Prev();
+    }
+    if (!lookahead_.Valid()) {
+      break;
+    }
+    (*prefetch_function_)(arg_, lookahead_.value());
+    ahead_++;
+  }
+}
+
 }  // namespace
 
 Iterator* NewTwoLevelIterator(Iterator* index_iter,
                               BlockFunction block_function, void* arg,
                               const ReadOptions& options) {
-  return new TwoLevelIterator(index_iter, block_function, arg, options);
+  return new TwoLevelIterator(index_iter, nullptr, block_function, nullptr,
+                              arg, options);
+}
+
+Iterator* NewPrefetchingTwoLevelIterator(Iterator* index_iter,
+                                         Iterator* lookahead_iter,
+                                         BlockFunction block_function,
+                                         PrefetchFunction prefetch_function,
+                                         void* arg,
+                                         const ReadOptions& options) {
+  return new TwoLevelIterator(index_iter, lookahead_iter, block_function,
+                              prefetch_function, arg, options);
 }
 
 }  // namespace leveldb
@@ -26,6 +26,20 @@ Iterator* NewTwoLevelIterator(
                                 const Slice& index_value),
     void* arg, const ReadOptions& options);
 
+// Like NewTwoLevelIterator(), but once the iterator moves sequentially
+// from block to block, calls "(*prefetch_function)(arg, index_value)"
+// with the index values of up to options.prefetch_blocks blocks ahead of
+// the current one, in the direction of iteration, so that the caller can
+// start reading them before they are needed.  "lookahead_iter" must be a
+// second iterator over the same index as "index_iter".  Takes ownership
+// of both iterators.
+Iterator* NewPrefetchingTwoLevelIterator(
+    Iterator* index_iter, Iterator* lookahead_iter,
+    Iterator* (*block_function)(void* arg, const ReadOptions& options,
+                                const Slice& index_value),
+    void (*prefetch_function)(void* arg, const Slice& index_value), void* arg,
+    const ReadOptions& options);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_TABLE_TWO_LEVEL_ITERATOR_H_
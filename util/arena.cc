@@ -4,6 +4,11 @@
 
 #include "util/arena.h"
 
+#include <functional>
+#include <thread>
+
+#include "util/mutexlock.h"
+
 namespace leveldb {
 
 static const int kBlockSize = 4096;
@@ -12,6 +17,7 @@ Arena::Arena()
     : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0) {}
 
 Arena::~Arena() {
+  MutexLock l(&blocks_mu_);
   for (size_t i = 0; i < blocks_.size(); i++) {
     delete[] blocks_[i];
   }
@@ -55,9 +61,39 @@ char* Arena::AllocateAligned(size_t bytes) {
   return result;
 }
 
+char* Arena::AllocateAlignedConcurrently(size_t bytes) {
+  assert(bytes > 0);
+  const int align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+  // Round up the size so that the next allocation from the shard is
+  // aligned as well.
+  bytes = (bytes + align - 1) & ~static_cast<size_t>(align - 1);
+  if (bytes > kBlockSize / 4) {
+    // Large objects get a block of their own, as in AllocateFallback().
+    return AllocateNewBlock(bytes);
+  }
+
+  const size_t index =
+      std::hash<std::thread::id>()(std::this_thread::get_id()) % kNumShards;
+  Shard* shard = &shards_[index];
+  MutexLock l(&shard->mu);
+  if (bytes > shard->alloc_bytes_remaining) {
+    // We waste the remaining space in the shard's current block.
+    shard->alloc_ptr = AllocateNewBlock(kBlockSize);
+    shard->alloc_bytes_remaining = kBlockSize;
+  }
+  char* result = shard->alloc_ptr;
+  shard->alloc_ptr += bytes;
+  shard->alloc_bytes_remaining -= bytes;
+  assert((reinterpret_cast<uintptr_t>(result) & (align - 1)) == 0);
+  return result;
+}
+
 char* Arena::AllocateNewBlock(size_t block_bytes) {
   char* result = new char[block_bytes];
-  blocks_.push_back(result);
+  {
+    MutexLock l(&blocks_mu_);
+    blocks_.push_back(result);
+  }
   memory_usage_.fetch_add(block_bytes + sizeof(char*),
                           std::memory_order_relaxed);
   return result;
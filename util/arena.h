@@ -11,6 +11,9 @@
 #include <cstdint>
 #include <vector>
 
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
 namespace leveldb {
 
 class Arena {
@@ -28,6 +31,12 @@ class Arena {
   // Allocate memory with the normal alignment guarantees provided by malloc.
   char* AllocateAligned(size_t bytes);
 
+  // Like AllocateAligned(), but safe to call from several threads at once.
+  // Threads allocate from separate shards of the arena, so that they
+  // rarely contend on a lock.
+  // REQUIRES: no concurrent calls to Allocate() or AllocateAligned().
+  char* AllocateAlignedConcurrently(size_t bytes);
+
   // Returns an estimate of the total memory usage of data allocated
   // by the arena.
   size_t MemoryUsage() const {
@@ -35,6 +44,17 @@ class Arena {
   }
 
  private:
+  // Allocation state of one shard used by AllocateAlignedConcurrently().
+  struct Shard {
+    Shard() : alloc_ptr(nullptr), alloc_bytes_remaining(0) {}
+
+    port::Mutex mu;
+    char* alloc_ptr GUARDED_BY(mu);
+    size_t alloc_bytes_remaining GUARDED_BY(mu);
+  };
+
+  enum { kNumShards = 16 };
+
   char* AllocateFallback(size_t bytes);
   char* AllocateNewBlock(size_t block_bytes);
 
@@ -42,8 +62,11 @@ class Arena {
   char* alloc_ptr_;
   size_t alloc_bytes_remaining_;
 
+  Shard shards_[kNumShards];
+
   // Array of new[] allocated memory blocks
-  std::vector<char*> blocks_;
+  port::Mutex blocks_mu_;
+  std::vector<char*> blocks_ GUARDED_BY(blocks_mu_);
 
   // Total memory usage of the arena.
   //
@@ -4,7 +4,11 @@
 
 #include "util/arena.h"
 
+#include <atomic>
+
 #include "gtest/gtest.h"
+#include "leveldb/env.h"
+#include "port/port.h"
 #include "util/random.h"
 
 namespace leveldb {
@@ -58,4 +62,66 @@ TEST(ArenaTest, Simple) {
   }
 }
 
+struct ConcurrentArenaState {
+  static constexpr int kThreads = 4;
+  static constexpr int kAllocations = 20000;
+
+  ConcurrentArenaState() : done_cv(&mu), done(0) {}
+
+  Arena arena;
+  std::atomic<int> next_thread{0};
+  port::Mutex mu;
+  port::CondVar done_cv;
+  int done;
+  std::vector<std::pair<size_t, char*>> allocated[kThreads];
+};
+
+// Needed when building in C++11 mode.
+constexpr int ConcurrentArenaState::kThreads;
+constexpr int ConcurrentArenaState::kAllocations;
+
+static void ConcurrentAllocator(void* arg) {
+  ConcurrentArenaState* state = reinterpret_cast<ConcurrentArenaState*>(arg);
+  const int id = state->next_thread.fetch_add(1);
+  Random rnd(301 + id);
+  for (int i = 0; i < ConcurrentArenaState::kAllocations; i++) {
+    size_t s = rnd.OneIn(1000) ? rnd.Uniform(6000) + 1 : rnd.Uniform(100) + 1;
+    char* r = state->arena.AllocateAlignedConcurrently(s);
+    for (size_t b = 0; b < s; b++) {
+      r[b] = id;
+    }
+    state->allocated[id].push_back(std::make_pair(s, r));
+  }
+  state->mu.Lock();
+  state->done++;
+  state->done_cv.Signal();
+  state->mu.Unlock();
+}
+
+TEST(ArenaTest, Concurrent) {
+  ConcurrentArenaState state;
+  for (int i = 0; i < ConcurrentArenaState::kThreads; i++) {
+    Env::Default()->StartThread(ConcurrentAllocator, &state);
+  }
+  state.mu.Lock();
+  while (state.done < ConcurrentArenaState::kThreads) {
+    state.done_cv.Wait();
+  }
+  state.mu.Unlock();
+
+  size_t bytes = 0;
+  for (int id = 0; id < ConcurrentArenaState::kThreads; id++) {
+    for (size_t i = 0; i < state.allocated[id].size(); i++) {
+      size_t num_bytes = state.allocated[id][i].first;
+      const char* p = state.allocated[id][i].second;
+      for (size_t b = 0; b < num_bytes; b++) {
+        // Another thread's allocation must not overlap ours.
+        ASSERT_EQ(id, p[b]);
+      }
+      bytes += num_bytes;
+    }
+  }
+  ASSERT_GE(state.arena.MemoryUsage(), bytes);
+}
+
 }  // namespace leveldb
@@ -4,9 +4,21 @@
 
 #include "leveldb/filter_policy.h"
 
+#include <cassert>
+#include <cmath>
+#include <vector>
+
 #include "leveldb/slice.h"
 #include "util/hash.h"
 
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define LEVELDB_BLOOM_AVX2 1
+#include <immintrin.h>
+#else
+#define LEVELDB_BLOOM_AVX2 0
+#endif
+
 namespace leveldb {
 
 namespace {
@@ -83,10 +95,253 @@ class BloomFilterPolicy : public FilterPolicy {
   size_t bits_per_key_;
   size_t k_;
 };
+
+// Chooses among bloom filters with different numbers of bits per key by
+// level.  All of them share a name and encode their number of probes, so
+// any of them can read the filters built by the others.
+class LevelBloomFilterPolicy : public FilterPolicy {
+ public:
+  // If bits_per_level is empty, the number of bits for each level is
+  // derived from the average "bits_per_key" and the sizes of the levels.
+  LevelBloomFilterPolicy(const std::vector<int>& bits_per_level,
+                         int bits_per_key)
+      : bits_per_level_(bits_per_level), bits_per_key_(bits_per_key) {
+    for (int bits = 1; bits <= kMaxBitsPerKey; bits++) {
+      policies_.push_back(new BloomFilterPolicy(bits));
+    }
+    default_ = Policy(bits_per_level.empty() ? bits_per_key
+                                             : bits_per_level.back());
+  }
+
+  ~LevelBloomFilterPolicy() override {
+    for (size_t i = 0; i < policies_.size(); i++) {
+      delete policies_[i];
+    }
+  }
+
+  const char* Name() const override { return default_->Name(); }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    default_->CreateFilter(keys, n, dst);
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& bloom_filter) const override {
+    return default_->KeyMayMatch(key, bloom_filter);
+  }
+
+  const FilterPolicy* PolicyForLevel(int level, const uint64_t* level_bytes,
+                                     int num_levels) const override {
+    if (!bits_per_level_.empty()) {
+      const size_t i = static_cast<size_t>(level);
+      return Policy(i < bits_per_level_.size() ? bits_per_level_[i]
+                                               : bits_per_level_.back());
+    }
+    return Policy(OptimalBitsPerKey(level, level_bytes, num_levels));
+  }
+
+ private:
+  static const int kMaxBitsPerKey = 40;
+
+  // The expected number of unnecessary reads for a missing key is the sum
+  // of the false positive rates of the levels.  For a fixed total number
+  // of bits, this sum is minimized by making the false positive rate of
+  // each level proportional to its share f of the keys [Dayan et al.,
+  // "Monkey", SIGMOD 2017].  With a false positive rate of
+  // exp(-bits * ln(2)^2) for a bloom filter, that yields
+  //    bits = bits_per_key + (ln(1/f) - H) / ln(2)^2
+  // where H is the sum of f * ln(1/f) over all levels.  Level sizes in
+  // bytes stand in for numbers of keys.
+  int OptimalBitsPerKey(int level, const uint64_t* level_bytes,
+                        int num_levels) const {
+    double total = 0;
+    for (int i = 0; i < num_levels; i++) {
+      total += level_bytes[i];
+    }
+    if (total == 0) {
+      return bits_per_key_;
+    }
+    double entropy = 0;
+    for (int i = 0; i < num_levels; i++) {
+      if (level_bytes[i] > 0) {
+        const double f = level_bytes[i] / total;
+        entropy -= f * std::log(f);
+      }
+    }
+    // An empty level would otherwise get an unbounded number of bits.
+    double f = level_bytes[level] / total;
+    if (f < 0.0001) f = 0.0001;
+    const double ln2_squared = std::log(2.0) * std::log(2.0);
+    const double bits =
+        bits_per_key_ + (-std::log(f) - entropy) / ln2_squared;
+    return static_cast<int>(std::lround(bits));
+  }
+
+  const FilterPolicy* Policy(int bits) const {
+    if (bits < 1) bits = 1;
+    if (bits > kMaxBitsPerKey) bits = kMaxBitsPerKey;
+    return policies_[bits - 1];
+  }
+
+  const std::vector<int> bits_per_level_;
+  const int bits_per_key_;
+  std::vector<const FilterPolicy*> policies_;  // Indexed by bits per key - 1
+  const FilterPolicy* default_;
+};
+
+// A blocked bloom filter sets all k bits for a key within a single 64-byte
+// block, chosen by one hash of the key.  The bit positions within the
+// block come from a second hash, multiplied by successive powers of the
+// golden ratio, taking the top 9 bits each time.  A probe thus reads at
+// most two cache lines (one if the filter happens to be aligned), instead
+// of up to k.
+//
+// The filter is encoded as the blocks followed by one byte holding k.
+static const size_t kBloomBlockBytes = 64;
+static const uint32_t kBloomMultiplier = 0x9e3779b9;  // 2^32 / golden ratio
+
+static uint32_t BlockedBloomProbeHash(const Slice& key) {
+  return Hash(key.data(), key.size(), 0x7c5e3a91);
+}
+
+static bool BlockMayMatch(const char* block, uint32_t h, size_t k) {
+  for (size_t j = 0; j < k; j++) {
+    h *= kBloomMultiplier;
+    const uint32_t bitpos = h >> 23;
+    if ((block[bitpos / 8] & (1 << (bitpos % 8))) == 0) return false;
+  }
+  return true;
+}
+
+#if LEVELDB_BLOOM_AVX2
+// Same as BlockMayMatch(), checking eight probes at a time.  Bit i of the
+// block is bit (i % 32) of the i / 32'th little-endian 32-bit word, which
+// matches the byte-wise addressing above on x86.
+__attribute__((target("avx2"))) static bool BlockMayMatchAVX2(
+    const char* block, uint32_t h, size_t k) {
+  uint32_t m = kBloomMultiplier;
+  uint32_t powers[8];
+  for (int i = 0; i < 8; i++) {
+    powers[i] = m;
+    m *= kBloomMultiplier;
+  }
+  const uint32_t step = powers[7];  // Advance by eight probes per round
+  const __m256i multipliers =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(powers));
+  const __m256i lane_numbers = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i ones = _mm256_set1_epi32(1);
+  const __m256i low_five_bits = _mm256_set1_epi32(31);
+  for (size_t j = 0; j < k; j += 8) {
+    const __m256i hashes =
+        _mm256_mullo_epi32(_mm256_set1_epi32(h), multipliers);
+    const __m256i bitpos = _mm256_srli_epi32(hashes, 23);
+    const __m256i words = _mm256_i32gather_epi32(
+        reinterpret_cast<const int*>(block), _mm256_srli_epi32(bitpos, 5), 4);
+    const __m256i bits =
+        _mm256_sllv_epi32(ones, _mm256_and_si256(bitpos, low_five_bits));
+    // Ignore the lanes past the k'th probe.
+    const __m256i in_range = _mm256_cmpgt_epi32(
+        _mm256_set1_epi32(static_cast<int>(k - j)), lane_numbers);
+    const __m256i missing =
+        _mm256_and_si256(_mm256_andnot_si256(words, bits), in_range);
+    if (!_mm256_testz_si256(missing, missing)) return false;
+    h *= step;
+  }
+  return true;
+}
+#endif  // LEVELDB_BLOOM_AVX2
+
+class BlockedBloomFilterPolicy : public FilterPolicy {
+ public:
+  explicit BlockedBloomFilterPolicy(int bits_per_key)
+      : bits_per_key_(bits_per_key) {
+    k_ = static_cast<size_t>(bits_per_key * 0.69);  // 0.69 =~ ln(2)
+    if (k_ < 1) k_ = 1;
+    if (k_ > 30) k_ = 30;
+#if LEVELDB_BLOOM_AVX2
+    use_avx2_ = __builtin_cpu_supports("avx2");
+#else
+    use_avx2_ = false;
+#endif
+  }
+
+  const char* Name() const override { return "leveldb.BlockedBloomFilter"; }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    const size_t bits = n * bits_per_key_;
+    const size_t block_bits = kBloomBlockBytes * 8;
+    size_t num_blocks = (bits + block_bits - 1) / block_bits;
+    if (num_blocks < 1) num_blocks = 1;
+
+    const size_t init_size = dst->size();
+    dst->resize(init_size + num_blocks * kBloomBlockBytes, 0);
+    dst->push_back(static_cast<char>(k_));  // Remember # of probes in filter
+    char* array = &(*dst)[init_size];
+    for (int i = 0; i < n; i++) {
+      char* block = array + BlockIndex(BloomHash(keys[i]), num_blocks) *
+                                kBloomBlockBytes;
+      uint32_t h = BlockedBloomProbeHash(keys[i]);
+      for (size_t j = 0; j < k_; j++) {
+        h *= kBloomMultiplier;
+        const uint32_t bitpos = h >> 23;
+        block[bitpos / 8] |= (1 << (bitpos % 8));
+      }
+    }
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& bloom_filter) const override {
+    const size_t len = bloom_filter.size();
+    if (len < 2) return false;
+    if ((len - 1) % kBloomBlockBytes != 0) {
+      return true;  // Errors are treated as potential matches
+    }
+
+    const size_t num_blocks = (len - 1) / kBloomBlockBytes;
+    const char* array = bloom_filter.data();
+    const size_t k = array[len - 1];
+    if (k > 30) {
+      // Reserved for potentially new encodings.  Consider it a match.
+      return true;
+    }
+
+    const char* block =
+        array + BlockIndex(BloomHash(key), num_blocks) * kBloomBlockBytes;
+    const uint32_t h = BlockedBloomProbeHash(key);
+#if LEVELDB_BLOOM_AVX2
+    if (use_avx2_) {
+      return BlockMayMatchAVX2(block, h, k);
+    }
+#endif
+    return BlockMayMatch(block, h, k);
+  }
+
+ private:
+  // Map h uniformly onto [0, num_blocks) without a division.
+  static size_t BlockIndex(uint32_t h, size_t num_blocks) {
+    return static_cast<size_t>((static_cast<uint64_t>(h) * num_blocks) >> 32);
+  }
+
+  size_t bits_per_key_;
+  size_t k_;
+  bool use_avx2_;
+};
 }  // namespace
 
 const FilterPolicy* NewBloomFilterPolicy(int bits_per_key) {
   return new BloomFilterPolicy(bits_per_key);
 }
 
+const FilterPolicy* NewLevelBloomFilterPolicy(
+    const std::vector<int>& bits_per_key) {
+  assert(!bits_per_key.empty());
+  return new LevelBloomFilterPolicy(bits_per_key, bits_per_key.back());
+}
+
+const FilterPolicy* NewOptimizedBloomFilterPolicy(int bits_per_key) {
+  return new LevelBloomFilterPolicy(std::vector<int>(), bits_per_key);
+}
+
+const FilterPolicy* NewBlockedBloomFilterPolicy(int bits_per_key) {
+  return new BlockedBloomFilterPolicy(bits_per_key);
+}
+
 }  // namespace leveldb
@@ -20,6 +20,7 @@ static Slice Key(int i, char* buffer) {
 class BloomTest : public testing::Test {
  public:
   BloomTest() : policy_(NewBloomFilterPolicy(10)) {}
+  explicit BloomTest(const FilterPolicy* policy) : policy_(policy) {}
 
   ~BloomTest() { delete policy_; }
 
@@ -151,4 +152,149 @@ TEST_F(BloomTest, VaryingLengths) {
 
 // Different bits-per-byte
 
+class BlockedBloomTest : public BloomTest {
+ public:
+  BlockedBloomTest() : BloomTest(NewBlockedBloomFilterPolicy(10)) {}
+};
+
+TEST_F(BlockedBloomTest, EmptyFilter) {
+  ASSERT_TRUE(!Matches("hello"));
+  ASSERT_TRUE(!Matches("world"));
+}
+
+TEST_F(BlockedBloomTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+  ASSERT_TRUE(!Matches("foo"));
+}
+
+TEST_F(BlockedBloomTest, VaryingLengths) {
+  char buffer[sizeof(int)];
+
+  // Count number of filters that significantly exceed the false positive rate
+  int mediocre_filters = 0;
+  int good_filters = 0;
+
+  for (int length = 1; length <= 10000; length = NextLength(length)) {
+    Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+    }
+    Build();
+
+    // Filters are a whole number of 64-byte blocks, plus one byte.
+    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 65))
+        << length;
+    ASSERT_EQ(1, FilterSize() % 64) << length;
+
+    // All added keys must match
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(Matches(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    // Check false positive rate
+    double rate = FalsePositiveRate();
+    if (kVerbose >= 1) {
+      std::fprintf(stderr,
+                   "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
+                   rate * 100.0, length, static_cast<int>(FilterSize()));
+    }
+    ASSERT_LE(rate, 0.02);  // Must not be over 2%
+    if (rate > 0.0125)
+      mediocre_filters++;  // Allowed, but not too often
+    else
+      good_filters++;
+  }
+  if (kVerbose >= 1) {
+    std::fprintf(stderr, "Filters: %d good, %d mediocre\n", good_filters,
+                 mediocre_filters);
+  }
+  ASSERT_LE(mediocre_filters, good_filters / 5);
+}
+
+// Per-level bits per key
+
+static std::string BuildFilter(const FilterPolicy* policy, int n) {
+  std::vector<std::string> keys;
+  char buffer[sizeof(int)];
+  for (int i = 0; i < n; i++) {
+    keys.push_back(Key(i, buffer).ToString());
+  }
+  std::vector<Slice> key_slices(keys.begin(), keys.end());
+  std::string filter;
+  policy->CreateFilter(&key_slices[0], n, &filter);
+  return filter;
+}
+
+TEST(LevelBloomTest, FixedBitsPerLevel) {
+  const FilterPolicy* policy = NewLevelBloomFilterPolicy({20, 15, 10});
+  const uint64_t level_bytes[4] = {0, 0, 0, 0};
+  const int kKeys = 1000;
+  ASSERT_EQ(kKeys * 20 / 8 + 1,
+            BuildFilter(policy->PolicyForLevel(0, level_bytes, 4), kKeys)
+                .size());
+  ASSERT_EQ(kKeys * 15 / 8 + 1,
+            BuildFilter(policy->PolicyForLevel(1, level_bytes, 4), kKeys)
+                .size());
+  ASSERT_EQ(kKeys * 10 / 8 + 1,
+            BuildFilter(policy->PolicyForLevel(2, level_bytes, 4), kKeys)
+                .size());
+  // Levels past the end, and tables built without a level, use the last.
+  ASSERT_EQ(kKeys * 10 / 8 + 1,
+            BuildFilter(policy->PolicyForLevel(3, level_bytes, 4), kKeys)
+                .size());
+  ASSERT_EQ(kKeys * 10 / 8 + 1, BuildFilter(policy, kKeys).size());
+  ASSERT_EQ(std::string(policy->Name()), "leveldb.BuiltinBloomFilter2");
+
+  // The filters of every level are understood by the policy itself.
+  char buffer[sizeof(int)];
+  for (int level = 0; level < 3; level++) {
+    std::string filter =
+        BuildFilter(policy->PolicyForLevel(level, level_bytes, 4), kKeys);
+    for (int i = 0; i < kKeys; i++) {
+      ASSERT_TRUE(policy->KeyMayMatch(Key(i, buffer), filter));
+    }
+  }
+  delete policy;
+}
+
+TEST(LevelBloomTest, OptimizedBitsPerLevel) {
+  const FilterPolicy* policy = NewOptimizedBloomFilterPolicy(10);
+  const int kKeys = 1000;
+
+  // Without any data every level gets the average.
+  const uint64_t empty[4] = {0, 0, 0, 0};
+  for (int level = 0; level < 4; level++) {
+    ASSERT_EQ(kKeys * 10 / 8 + 1,
+              BuildFilter(policy->PolicyForLevel(level, empty, 4), kKeys)
+                  .size());
+  }
+
+  // Smaller levels get more bits per key, and the average weighted by
+  // level size stays close to the requested number of bits.
+  const uint64_t level_bytes[4] = {1 << 20, 10 << 20, 100 << 20, 1000 << 20};
+  double total_bits = 0;
+  double total_bytes = 0;
+  size_t prev_size = ~size_t{0};
+  for (int level = 0; level < 4; level++) {
+    const size_t size =
+        BuildFilter(policy->PolicyForLevel(level, level_bytes, 4), kKeys)
+            .size();
+    if (kVerbose >= 1) {
+      std::fprintf(stderr, "Level %d: %d bits per key\n", level,
+                   static_cast<int>((size - 1) * 8 / kKeys));
+    }
+    ASSERT_LT(size, prev_size);
+    prev_size = size;
+    total_bits += static_cast<double>(size - 1) * 8 / kKeys * level_bytes[level];
+    total_bytes += level_bytes[level];
+  }
+  ASSERT_NEAR(10.0, total_bits / total_bytes, 0.5);
+  delete policy;
+}
+
 }  // namespace leveldb
@@ -4,9 +4,11 @@
 
 #include "leveldb/cache.h"
 
+#include <atomic>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <new>
 
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -17,6 +19,15 @@ namespace leveldb {
 
 Cache::~Cache() {}
 
+bool Cache::Contains(const Slice& key) {
+  Handle* handle = Lookup(key);
+  if (handle == nullptr) {
+    return false;
+  }
+  Release(handle);
+  return true;
+}
+
 namespace {
 
 // LRU cache implementation
@@ -37,6 +48,15 @@ namespace {
 // Elements are moved between these lists by the Ref() and Unref() methods,
 // when they detect an element in the cache acquiring or losing its only
 // external reference.
+//
+// A segmented cache splits the LRU list in two.  New entries start out in
+// the probationary segment (lru_), and are promoted to the protected
+// segment (protected_) when they are looked up again.  Eviction takes from
+// the probationary segment first, and the protected segment is bounded by
+// protected_capacity_: when it overflows, its oldest entries are demoted to
+// the newest end of the probationary segment.  Entries touched only once,
+// like the blocks of a long scan, thus never displace entries that are hit
+// repeatedly.
 
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
@@ -48,10 +68,11 @@ struct LRUHandle {
   LRUHandle* prev;
   size_t charge;  // TODO(opt): Only allow uint32_t?
   size_t key_length;
-  bool in_cache;     // Whether entry is in the cache.
-  uint32_t refs;     // References, including cache reference, if present.
-  uint32_t hash;     // Hash of key(); used for fast sharding and comparisons
-  char key_data[1];  // Beginning of key
+  bool in_cache;      // Whether entry is in the cache.
+  bool in_protected;  // Whether entry is in the protected segment.
+  uint32_t refs;      // References, including cache reference, if present.
+  uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  char key_data[1];   // Beginning of key
 
   Slice key() const {
     // next is only equal to this if the LRU handle is the list head of an
@@ -67,18 +88,21 @@ struct LRUHandle {
 // table implementations in some of the compiler/runtime combinations
 // we have tested.  E.g., readrandom speeds up by ~5% over the g++
 // 4.4.3's builtin hashtable.
+//
+// Entries must provide key(), hash and next_hash.
+template <typename Entry>
 class HandleTable {
  public:
   HandleTable() : length_(0), elems_(0), list_(nullptr) { Resize(); }
   ~HandleTable() { delete[] list_; }
 
-  LRUHandle* Lookup(const Slice& key, uint32_t hash) {
+  Entry* Lookup(const Slice& key, uint32_t hash) {
     return *FindPointer(key, hash);
   }
 
-  LRUHandle* Insert(LRUHandle* h) {
-    LRUHandle** ptr = FindPointer(h->key(), h->hash);
-    LRUHandle* old = *ptr;
+  Entry* Insert(Entry* h) {
+    Entry** ptr = FindPointer(h->key(), h->hash);
+    Entry* old = *ptr;
     h->next_hash = (old == nullptr ? nullptr : old->next_hash);
     *ptr = h;
     if (old == nullptr) {
@@ -92,9 +116,9 @@ class HandleTable {
     return old;
   }
 
-  LRUHandle* Remove(const Slice& key, uint32_t hash) {
-    LRUHandle** ptr = FindPointer(key, hash);
-    LRUHandle* result = *ptr;
+  Entry* Remove(const Slice& key, uint32_t hash) {
+    Entry** ptr = FindPointer(key, hash);
+    Entry* result = *ptr;
     if (result != nullptr) {
       *ptr = result->next_hash;
       --elems_;
@@ -107,13 +131,13 @@ class HandleTable {
   // a linked list of cache entries that hash into the bucket.
   uint32_t length_;
   uint32_t elems_;
-  LRUHandle** list_;
+  Entry** list_;
 
   // Return a pointer to slot that points to a cache entry that
   // matches key/hash.  If there is no such cache entry, return a
   // pointer to the trailing slot in the corresponding linked list.
-  LRUHandle** FindPointer(const Slice& key, uint32_t hash) {
-    LRUHandle** ptr = &list_[hash & (length_ - 1)];
+  Entry** FindPointer(const Slice& key, uint32_t hash) {
+    Entry** ptr = &list_[hash & (length_ - 1)];
     while (*ptr != nullptr && ((*ptr)->hash != hash || key != (*ptr)->key())) {
       ptr = &(*ptr)->next_hash;
     }
@@ -125,15 +149,15 @@ class HandleTable {
     while (new_length < elems_) {
       new_length *= 2;
     }
-    LRUHandle** new_list = new LRUHandle*[new_length];
+    Entry** new_list = new Entry*[new_length];
     memset(new_list, 0, sizeof(new_list[0]) * new_length);
     uint32_t count = 0;
     for (uint32_t i = 0; i < length_; i++) {
-      LRUHandle* h = list_[i];
+      Entry* h = list_[i];
       while (h != nullptr) {
-        LRUHandle* next = h->next_hash;
+        Entry* next = h->next_hash;
         uint32_t hash = h->hash;
-        LRUHandle** ptr = &new_list[hash & (new_length - 1)];
+        Entry** ptr = &new_list[hash & (new_length - 1)];
         h->next_hash = *ptr;
         *ptr = h;
         h = next;
@@ -155,12 +179,16 @@ class LRUCache {
 
   // Separate from constructor so caller can easily make an array of LRUCache
   void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  void SetProtectedCapacity(size_t capacity) {
+    protected_capacity_ = capacity;
+  }
 
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
                         size_t charge,
                         void (*deleter)(const Slice& key, void* value));
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+  bool Contains(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
   void Prune();
@@ -174,31 +202,41 @@ class LRUCache {
   void LRU_Append(LRUHandle* list, LRUHandle* e);
   void Ref(LRUHandle* e);
   void Unref(LRUHandle* e);
+  void Promote(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   bool FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // Initialized before use.
   size_t capacity_;
+  size_t protected_capacity_;  // Zero disables segmentation.
 
   // mutex_ protects the following state.
   mutable port::Mutex mutex_;
   size_t usage_ GUARDED_BY(mutex_);
+  size_t protected_usage_ GUARDED_BY(mutex_);
 
-  // Dummy head of LRU list.
+  // Dummy head of LRU list (the probationary segment, if segmented).
   // lru.prev is newest entry, lru.next is oldest entry.
   // Entries have refs==1 and in_cache==true.
   LRUHandle lru_ GUARDED_BY(mutex_);
 
+  // Dummy head of the LRU list of the protected segment.
+  // Entries have refs==1, in_cache==true and in_protected==true.
+  LRUHandle protected_ GUARDED_BY(mutex_);
+
   // Dummy head of in-use list.
   // Entries are in use by clients, and have refs >= 2 and in_cache==true.
   LRUHandle in_use_ GUARDED_BY(mutex_);
 
-  HandleTable table_ GUARDED_BY(mutex_);
+  HandleTable<LRUHandle> table_ GUARDED_BY(mutex_);
 };
 
-LRUCache::LRUCache() : capacity_(0), usage_(0) {
+LRUCache::LRUCache()
+    : capacity_(0), protected_capacity_(0), usage_(0), protected_usage_(0) {
   // Make empty circular linked lists.
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  protected_.next = &protected_;
+  protected_.prev = &protected_;
   in_use_.next = &in_use_;
   in_use_.prev = &in_use_;
 }
@@ -213,6 +251,14 @@ LRUCache::~LRUCache() {
     Unref(e);
     e = next;
   }
+  for (LRUHandle* e = protected_.next; e != &protected_;) {
+    LRUHandle* next = e->next;
+    assert(e->in_cache);
+    e->in_cache = false;
+    assert(e->refs == 1);  // Invariant of protected_ list.
+    Unref(e);
+    e = next;
+  }
 }
 
 void LRUCache::Ref(LRUHandle* e) {
@@ -231,9 +277,25 @@ void LRUCache::Unref(LRUHandle* e) {
     (*e->deleter)(e->key(), e->value);
     free(e);
   } else if (e->in_cache && e->refs == 1) {
-    // No longer in use; move to lru_ list.
+    // No longer in use; move to lru_ or protected_ list.
     LRU_Remove(e);
-    LRU_Append(&lru_, e);
+    LRU_Append(e->in_protected ? &protected_ : &lru_, e);
+  }
+}
+
+void LRUCache::Promote(LRUHandle* e) {
+  e->in_protected = true;
+  protected_usage_ += e->charge;
+  // Demote the oldest protected entries that are not in use.  Entries in
+  // use stay protected until they are released.
+  while (protected_usage_ > protected_capacity_ &&
+         protected_.next != &protected_) {
+    LRUHandle* old = protected_.next;
+    assert(old->refs == 1);
+    old->in_protected = false;
+    protected_usage_ -= old->charge;
+    LRU_Remove(old);
+    LRU_Append(&lru_, old);
   }
 }
 
@@ -255,10 +317,18 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != nullptr) {
     Ref(e);
+    if (protected_capacity_ > 0 && !e->in_protected) {
+      Promote(e);
+    }
   }
   return reinterpret_cast<Cache::Handle*>(e);
 }
 
+bool LRUCache::Contains(const Slice& key, uint32_t hash) {
+  MutexLock l(&mutex_);
+  return table_.Lookup(key, hash) != nullptr;
+}
+
 void LRUCache::Release(Cache::Handle* handle) {
   MutexLock l(&mutex_);
   Unref(reinterpret_cast<LRUHandle*>(handle));
@@ -278,6 +348,7 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
   e->key_length = key.size();
   e->hash = hash;
   e->in_cache = false;
+  e->in_protected = false;
   e->refs = 1;  // for the returned handle.
   std::memcpy(e->key_data, key.data(), key.size());
 
@@ -291,8 +362,9 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
     // next is read by key() in an assert, so it must be initialized
     e->next = nullptr;
   }
-  while (usage_ > capacity_ && lru_.next != &lru_) {
-    LRUHandle* old = lru_.next;
+  while (usage_ > capacity_ &&
+         (lru_.next != &lru_ || protected_.next != &protected_)) {
+    LRUHandle* old = (lru_.next != &lru_) ? lru_.next : protected_.next;
     assert(old->refs == 1);
     bool erased = FinishErase(table_.Remove(old->key(), old->hash));
     if (!erased) {  // to avoid unused variable when compiled NDEBUG
@@ -311,6 +383,10 @@ bool LRUCache::FinishErase(LRUHandle* e) {
     LRU_Remove(e);
     e->in_cache = false;
     usage_ -= e->charge;
+    if (e->in_protected) {
+      e->in_protected = false;
+      protected_usage_ -= e->charge;
+    }
     Unref(e);
   }
   return e != nullptr;
@@ -323,8 +399,8 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
 
 void LRUCache::Prune() {
   MutexLock l(&mutex_);
-  while (lru_.next != &lru_) {
-    LRUHandle* e = lru_.next;
+  while (lru_.next != &lru_ || protected_.next != &protected_) {
+    LRUHandle* e = (lru_.next != &lru_) ? lru_.next : protected_.next;
     assert(e->refs == 1);
     bool erased = FinishErase(table_.Remove(e->key(), e->hash));
     if (!erased) {  // to avoid unused variable when compiled NDEBUG
@@ -349,10 +425,12 @@ class ShardedLRUCache : public Cache {
   static uint32_t Shard(uint32_t hash) { return hash >> (32 - kNumShardBits); }
 
  public:
-  explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
+  ShardedLRUCache(size_t capacity, double protected_ratio) : last_id_(0) {
     const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
     for (int s = 0; s < kNumShards; s++) {
       shard_[s].SetCapacity(per_shard);
+      shard_[s].SetProtectedCapacity(
+          static_cast<size_t>(per_shard * protected_ratio));
     }
   }
   ~ShardedLRUCache() override {}
@@ -365,6 +443,10 @@ class ShardedLRUCache : public Cache {
     const uint32_t hash = HashSlice(key);
     return shard_[Shard(hash)].Lookup(key, hash);
   }
+  bool Contains(const Slice& key) override {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Contains(key, hash);
+  }
   void Release(Handle* handle) override {
     LRUHandle* h = reinterpret_cast<LRUHandle*>(handle);
     shard_[Shard(h->hash)].Release(handle);
@@ -394,8 +476,327 @@ class ShardedLRUCache : public Cache {
   }
 };
 
+// CLOCK cache implementation
+//
+// Like LRUCache, but without a list to reorder on every hit.  The entries of
+// a shard form a ring, and a lookup merely bumps the small "clock" counter
+// of the entry it finds.  To make room, the clock hand sweeps the ring:
+// entries in use by clients are skipped, entries with a non-zero counter
+// have it decremented and are passed over, and the first entry whose
+// counter is zero is evicted.  Counting rather than keeping a single
+// referenced bit lets a hot entry survive sweeps that happen while every
+// other entry has also been looked up once.
+//
+// Reference counts are atomic, so that Release() does not take the shard
+// mutex.  Only Insert() and Lookup() may add a reference, and both hold the
+// mutex, so an entry whose only reference is the cache's can be evicted
+// under the mutex without racing with clients.
+
+struct ClockHandle {
+  void* value;
+  void (*deleter)(const Slice&, void* value);
+  ClockHandle* next_hash;
+  ClockHandle* next;  // Ring of the entries in the cache
+  ClockHandle* prev;
+  size_t charge;
+  size_t key_length;
+  std::atomic<uint32_t> refs;  // References, including cache reference.
+  uint32_t clock;              // Recent lookups, up to kMaxClock.
+  bool in_cache;               // Whether entry is in the cache.
+  uint32_t hash;
+  char key_data[1];  // Beginning of key
+
+  Slice key() const { return Slice(key_data, key_length); }
+};
+
+static const uint32_t kMaxClock = 3;
+
+// A single shard of sharded CLOCK cache.
+class ClockCache {
+ public:
+  ClockCache();
+  ~ClockCache();
+
+  // Separate from constructor so caller can easily make an array of
+  // ClockCache
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
+                        size_t charge,
+                        void (*deleter)(const Slice& key, void* value));
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+  bool Contains(const Slice& key, uint32_t hash);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+  void Prune();
+  size_t TotalCharge() const {
+    MutexLock l(&mutex_);
+    return usage_;
+  }
+
+ private:
+  void Ring_Remove(ClockHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Ring_Append(ClockHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static void Unref(ClockHandle* e);
+  bool FinishErase(ClockHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Initialized before use.
+  size_t capacity_;
+
+  // mutex_ protects the following state.
+  mutable port::Mutex mutex_;
+  size_t usage_ GUARDED_BY(mutex_);
+
+  // Next entry to consider for eviction; nullptr iff the ring is empty.
+  // Entries are appended just behind the hand, so a new entry survives a
+  // full sweep.
+  ClockHandle* hand_ GUARDED_BY(mutex_);
+  size_t ring_size_ GUARDED_BY(mutex_);
+
+  HandleTable<ClockHandle> table_ GUARDED_BY(mutex_);
+};
+
+ClockCache::ClockCache()
+    : capacity_(0), usage_(0), hand_(nullptr), ring_size_(0) {}
+
+ClockCache::~ClockCache() {
+  while (hand_ != nullptr) {
+    ClockHandle* e = hand_;
+    // Error if caller has an unreleased handle
+    assert(e->refs.load(std::memory_order_relaxed) == 1);
+    Ring_Remove(e);
+    e->in_cache = false;
+    Unref(e);
+  }
+}
+
+void ClockCache::Unref(ClockHandle* e) {
+  if (e->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {  // Deallocate.
+    (*e->deleter)(e->key(), e->value);
+    e->~ClockHandle();
+    free(e);
+  }
+}
+
+void ClockCache::Ring_Remove(ClockHandle* e) {
+  if (e->next == e) {
+    hand_ = nullptr;
+  } else {
+    if (hand_ == e) {
+      hand_ = e->next;
+    }
+    e->next->prev = e->prev;
+    e->prev->next = e->next;
+  }
+  ring_size_--;
+}
+
+void ClockCache::Ring_Append(ClockHandle* e) {
+  if (hand_ == nullptr) {
+    e->next = e;
+    e->prev = e;
+    hand_ = e;
+  } else {
+    e->next = hand_;
+    e->prev = hand_->prev;
+    e->prev->next = e;
+    e->next->prev = e;
+  }
+  ring_size_++;
+}
+
+Cache::Handle* ClockCache::Lookup(const Slice& key, uint32_t hash) {
+  MutexLock l(&mutex_);
+  ClockHandle* e = table_.Lookup(key, hash);
+  if (e != nullptr) {
+    e->refs.fetch_add(1, std::memory_order_relaxed);
+    if (e->clock < kMaxClock) {
+      e->clock++;
+    }
+  }
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+bool ClockCache::Contains(const Slice& key, uint32_t hash) {
+  MutexLock l(&mutex_);
+  return table_.Lookup(key, hash) != nullptr;
+}
+
+void ClockCache::Release(Cache::Handle* handle) {
+  Unref(reinterpret_cast<ClockHandle*>(handle));
+}
+
+Cache::Handle* ClockCache::Insert(const Slice& key, uint32_t hash,
+                                  void* value, size_t charge,
+                                  void (*deleter)(const Slice& key,
+                                                  void* value)) {
+  MutexLock l(&mutex_);
+
+  ClockHandle* e = new (malloc(sizeof(ClockHandle) - 1 + key.size()))
+      ClockHandle;
+  e->value = value;
+  e->deleter = deleter;
+  e->charge = charge;
+  e->key_length = key.size();
+  e->hash = hash;
+  e->in_cache = false;
+  e->refs.store(1, std::memory_order_relaxed);  // for the returned handle.
+  e->clock = 0;
+  std::memcpy(e->key_data, key.data(), key.size());
+
+  if (capacity_ > 0) {
+    e->refs.fetch_add(1, std::memory_order_relaxed);  // for the cache's ref.
+    e->in_cache = true;
+    Ring_Append(e);
+    usage_ += charge;
+    FinishErase(table_.Insert(e));
+  }
+
+  // Each entry is visited at most kMaxClock + 1 times before it is evicted,
+  // unless it is in use.
+  size_t budget = (kMaxClock + 1) * ring_size_;
+  while (usage_ > capacity_ && hand_ != nullptr && budget-- > 0) {
+    ClockHandle* old = hand_;
+    hand_ = old->next;
+    if (old->refs.load(std::memory_order_acquire) > 1) {
+      continue;  // In use by some client
+    }
+    if (old->clock > 0) {
+      old->clock--;  // Another chance
+      continue;
+    }
+    bool erased = FinishErase(table_.Remove(old->key(), old->hash));
+    if (!erased) {  // to avoid unused variable when compiled NDEBUG
+      assert(erased);
+    }
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+// If e != nullptr, finish removing *e from the cache; it has already been
+// removed from the hash table.  Return whether e != nullptr.
+bool ClockCache::FinishErase(ClockHandle* e) {
+  if (e != nullptr) {
+    assert(e->in_cache);
+    Ring_Remove(e);
+    e->in_cache = false;
+    usage_ -= e->charge;
+    Unref(e);
+  }
+  return e != nullptr;
+}
+
+void ClockCache::Erase(const Slice& key, uint32_t hash) {
+  MutexLock l(&mutex_);
+  FinishErase(table_.Remove(key, hash));
+}
+
+void ClockCache::Prune() {
+  MutexLock l(&mutex_);
+  for (size_t n = ring_size_; n > 0; n--) {
+    ClockHandle* e = hand_;
+    hand_ = e->next;
+    if (e->refs.load(std::memory_order_acquire) == 1) {
+      bool erased = FinishErase(table_.Remove(e->key(), e->hash));
+      if (!erased) {  // to avoid unused variable when compiled NDEBUG
+        assert(erased);
+      }
+    }
+  }
+}
+
+static const int kMaxClockShardBits = 16;
+
+class ShardedClockCache : public Cache {
+ private:
+  const int num_shard_bits_;
+  ClockCache* const shard_;
+  std::atomic<uint64_t> last_id_;
+
+  static inline uint32_t HashSlice(const Slice& s) {
+    return Hash(s.data(), s.size(), 0);
+  }
+
+  uint32_t Shard(uint32_t hash) const {
+    // Shifting a 32-bit value by 32 is undefined.
+    return num_shard_bits_ == 0 ? 0 : hash >> (32 - num_shard_bits_);
+  }
+
+ public:
+  ShardedClockCache(size_t capacity, int num_shard_bits)
+      : num_shard_bits_(num_shard_bits),
+        shard_(new ClockCache[1 << num_shard_bits]),
+        last_id_(0) {
+    const int num_shards = 1 << num_shard_bits_;
+    const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+    for (int s = 0; s < num_shards; s++) {
+      shard_[s].SetCapacity(per_shard);
+    }
+  }
+  ~ShardedClockCache() override { delete[] shard_; }
+  Handle* Insert(const Slice& key, void* value, size_t charge,
+                 void (*deleter)(const Slice& key, void* value)) override {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+  }
+  Handle* Lookup(const Slice& key) override {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Lookup(key, hash);
+  }
+  bool Contains(const Slice& key) override {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Contains(key, hash);
+  }
+  void Release(Handle* handle) override {
+    ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+    shard_[Shard(h->hash)].Release(handle);
+  }
+  void Erase(const Slice& key) override {
+    const uint32_t hash = HashSlice(key);
+    shard_[Shard(hash)].Erase(key, hash);
+  }
+  void* Value(Handle* handle) override {
+    return reinterpret_cast<ClockHandle*>(handle)->value;
+  }
+  uint64_t NewId() override {
+    return last_id_.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+  void Prune() override {
+    for (int s = 0; s < (1 << num_shard_bits_); s++) {
+      shard_[s].Prune();
+    }
+  }
+  size_t TotalCharge() const override {
+    size_t total = 0;
+    for (int s = 0; s < (1 << num_shard_bits_); s++) {
+      total += shard_[s].TotalCharge();
+    }
+    return total;
+  }
+};
+
 }  // end anonymous namespace
 
-Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity); }
+Cache* NewLRUCache(size_t capacity) {
+  return new ShardedLRUCache(capacity, 0);
+}
+
+Cache* NewSegmentedLRUCache(size_t capacity, double protected_ratio) {
+  assert(protected_ratio >= 0 && protected_ratio < 1);
+  if (protected_ratio < 0) protected_ratio = 0;
+  if (protected_ratio > 1) protected_ratio = 1;
+  return new ShardedLRUCache(capacity, protected_ratio);
+}
+
+Cache* NewClockCache(size_t capacity, int num_shard_bits) {
+  assert(num_shard_bits >= 0 && num_shard_bits <= kMaxClockShardBits);
+  if (num_shard_bits < 0) num_shard_bits = 0;
+  if (num_shard_bits > kMaxClockShardBits) {
+    num_shard_bits = kMaxClockShardBits;
+  }
+  return new ShardedClockCache(capacity, num_shard_bits);
+}
 
 }  // namespace leveldb
@@ -4,9 +4,13 @@
 
 #include "leveldb/cache.h"
 
+#include <atomic>
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -37,6 +41,7 @@ class CacheTest : public testing::Test {
   Cache* cache_;
 
   CacheTest() : cache_(NewLRUCache(kCacheSize)) { current_ = this; }
+  explicit CacheTest(Cache* cache) : cache_(cache) { current_ = this; }
 
   ~CacheTest() { delete cache_; }
 
@@ -150,6 +155,20 @@ TEST_F(CacheTest, EvictionPolicy) {
   cache_->Release(h);
 }
 
+TEST_F(CacheTest, ContainsIsNotAUse) {
+  ASSERT_FALSE(cache_->Contains(EncodeKey(100)));
+  Insert(100, 101);
+  ASSERT_TRUE(cache_->Contains(EncodeKey(100)));
+
+  // Unlike a Lookup() (see EvictionPolicy), probing an entry does not keep
+  // it around.
+  for (int i = 0; i < kCacheSize + 100; i++) {
+    Insert(1000 + i, 2000 + i);
+    cache_->Contains(EncodeKey(100));
+  }
+  ASSERT_FALSE(cache_->Contains(EncodeKey(100)));
+}
+
 TEST_F(CacheTest, UseExceedsCacheSize) {
   // Overfill the cache, keeping handles on all inserted entries.
   std::vector<Cache::Handle*> h;
@@ -221,4 +240,293 @@ TEST_F(CacheTest, ZeroSizeCache) {
   ASSERT_EQ(-1, Lookup(1));
 }
 
+class SegmentedLRUCacheTest : public CacheTest {
+ public:
+  SegmentedLRUCacheTest() : CacheTest(NewSegmentedLRUCache(kCacheSize, 0.5)) {}
+};
+
+TEST_F(SegmentedLRUCacheTest, HitAndMiss) {
+  ASSERT_EQ(-1, Lookup(100));
+
+  Insert(100, 101);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+
+  Insert(200, 201);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+
+  Insert(100, 102);
+  ASSERT_EQ(102, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[0]);
+  ASSERT_EQ(101, deleted_values_[0]);
+}
+
+TEST_F(SegmentedLRUCacheTest, ScanResistance) {
+  // A working set that is hit repeatedly...
+  const int kHot = kCacheSize / 4;
+  for (int i = 0; i < kHot; i++) {
+    Insert(i, 1000 + i);
+    ASSERT_EQ(1000 + i, Lookup(i));
+  }
+
+  // ...survives a scan over several times the capacity of the cache.
+  for (int i = 0; i < 4 * kCacheSize; i++) {
+    Insert(10000 + i, 20000 + i);
+  }
+  int survivors = 0;
+  for (int i = 0; i < kHot; i++) {
+    if (Lookup(i) == 1000 + i) survivors++;
+  }
+  ASSERT_GE(survivors, kHot * 9 / 10);
+
+  // The scan still had room to be cached.
+  ASSERT_EQ(20000 + 4 * kCacheSize - 1, Lookup(10000 + 4 * kCacheSize - 1));
+  ASSERT_LE(cache_->TotalCharge(), kCacheSize + kCacheSize / 10);
+}
+
+TEST_F(SegmentedLRUCacheTest, ContainsDoesNotPromote) {
+  // Entries that are only probed with Contains() stay probationary, so a
+  // scan evicts them like any other entry read once.
+  const int kProbed = kCacheSize / 4;
+  for (int i = 0; i < kProbed; i++) {
+    Insert(i, 1000 + i);
+    ASSERT_TRUE(cache_->Contains(EncodeKey(i)));
+  }
+  for (int i = 0; i < 4 * kCacheSize; i++) {
+    Insert(10000 + i, 20000 + i);
+  }
+  for (int i = 0; i < kProbed; i++) {
+    ASSERT_FALSE(cache_->Contains(EncodeKey(i))) << i;
+  }
+}
+
+TEST_F(SegmentedLRUCacheTest, ProtectedSegmentIsBounded) {
+  // Promote more than the protected segment can hold.  The oldest hot
+  // entries are demoted, and evicted by a later scan.
+  for (int i = 0; i < kCacheSize; i++) {
+    Insert(i, 1000 + i);
+    ASSERT_EQ(1000 + i, Lookup(i));
+  }
+  for (int i = 0; i < 4 * kCacheSize; i++) {
+    Insert(10000 + i, 20000 + i);
+  }
+  ASSERT_EQ(-1, Lookup(0));
+  ASSERT_EQ(1000 + kCacheSize - 1, Lookup(kCacheSize - 1));
+}
+
+TEST_F(SegmentedLRUCacheTest, Prune) {
+  Insert(1, 100);
+  Insert(2, 200);
+  ASSERT_EQ(200, Lookup(2));  // Protected
+
+  Cache::Handle* handle = cache_->Lookup(EncodeKey(1));
+  ASSERT_TRUE(handle);
+  cache_->Prune();
+  cache_->Release(handle);
+
+  ASSERT_EQ(100, Lookup(1));
+  ASSERT_EQ(-1, Lookup(2));
+}
+
+class ClockCacheTest : public CacheTest {
+ public:
+  ClockCacheTest() : CacheTest(NewClockCache(kCacheSize, 4)) {}
+};
+
+TEST_F(ClockCacheTest, HitAndMiss) {
+  ASSERT_EQ(-1, Lookup(100));
+
+  Insert(100, 101);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+
+  Insert(200, 201);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+
+  Insert(100, 102);
+  ASSERT_EQ(102, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[0]);
+  ASSERT_EQ(101, deleted_values_[0]);
+}
+
+TEST_F(ClockCacheTest, EntriesArePinned) {
+  Insert(100, 101);
+  Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
+  ASSERT_EQ(101, DecodeValue(cache_->Value(h1)));
+
+  Insert(100, 102);
+  Cache::Handle* h2 = cache_->Lookup(EncodeKey(100));
+  ASSERT_EQ(102, DecodeValue(cache_->Value(h2)));
+  ASSERT_EQ(0, deleted_keys_.size());
+
+  cache_->Release(h1);
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(101, deleted_values_[0]);
+
+  Erase(100);
+  ASSERT_EQ(-1, Lookup(100));
+  ASSERT_EQ(1, deleted_keys_.size());
+
+  cache_->Release(h2);
+  ASSERT_EQ(2, deleted_keys_.size());
+  ASSERT_EQ(102, deleted_values_[1]);
+}
+
+TEST_F(ClockCacheTest, EvictionPolicy) {
+  Insert(100, 101);
+  Insert(200, 201);
+  Insert(300, 301);
+  Cache::Handle* h = cache_->Lookup(EncodeKey(300));
+
+  // Frequently used entry must be kept around,
+  // as must things that are still in use.
+  for (int i = 0; i < kCacheSize + 100; i++) {
+    Insert(1000 + i, 2000 + i);
+    ASSERT_EQ(2000 + i, Lookup(1000 + i));
+    ASSERT_EQ(101, Lookup(100));
+  }
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+  ASSERT_EQ(301, Lookup(300));
+  cache_->Release(h);
+}
+
+TEST_F(ClockCacheTest, HeavyEntries) {
+  const int kLight = 1;
+  const int kHeavy = 10;
+  int added = 0;
+  int index = 0;
+  while (added < 2 * kCacheSize) {
+    const int weight = (index & 1) ? kLight : kHeavy;
+    Insert(index, 1000 + index, weight);
+    added += weight;
+    index++;
+  }
+
+  int cached_weight = 0;
+  for (int i = 0; i < index; i++) {
+    const int weight = (i & 1 ? kLight : kHeavy);
+    int r = Lookup(i);
+    if (r >= 0) {
+      cached_weight += weight;
+      ASSERT_EQ(1000 + i, r);
+    }
+  }
+  ASSERT_LE(cached_weight, kCacheSize + kCacheSize / 10);
+  ASSERT_LE(cache_->TotalCharge(), kCacheSize + kCacheSize / 10);
+}
+
+TEST_F(ClockCacheTest, Prune) {
+  Insert(1, 100);
+  Insert(2, 200);
+
+  Cache::Handle* handle = cache_->Lookup(EncodeKey(1));
+  ASSERT_TRUE(handle);
+  cache_->Prune();
+  cache_->Release(handle);
+
+  ASSERT_EQ(100, Lookup(1));
+  ASSERT_EQ(-1, Lookup(2));
+}
+
+TEST_F(ClockCacheTest, ZeroSizeCache) {
+  delete cache_;
+  cache_ = NewClockCache(0, 0);
+
+  Insert(1, 100);
+  ASSERT_EQ(-1, Lookup(1));
+  ASSERT_EQ(1, deleted_keys_.size());
+}
+
+namespace {
+
+class ConcurrentCacheState {
+ public:
+  static constexpr int kThreads = 4;
+  static constexpr int kOpsPerThread = 20000;
+  static constexpr int kKeys = 500;
+
+  explicit ConcurrentCacheState(Cache* cache)
+      : cache_(cache), done_cv_(&mu_), done_(0) {}
+
+  static void Deleter(const Slice& key, void* v) {
+    delete reinterpret_cast<std::string*>(v);
+  }
+
+  Cache* const cache_;
+  std::atomic<int> next_thread_{0};
+  std::atomic<int> mismatches_{0};
+
+  void MarkDone() LOCKS_EXCLUDED(mu_) {
+    mu_.Lock();
+    done_++;
+    done_cv_.Signal();
+    mu_.Unlock();
+  }
+
+  void WaitForAll() LOCKS_EXCLUDED(mu_) {
+    mu_.Lock();
+    while (done_ < kThreads) {
+      done_cv_.Wait();
+    }
+    mu_.Unlock();
+  }
+
+ private:
+  port::Mutex mu_;
+  port::CondVar done_cv_ GUARDED_BY(mu_);
+  int done_ GUARDED_BY(mu_);
+};
+
+// Needed when building in C++11 mode.
+constexpr int ConcurrentCacheState::kThreads;
+constexpr int ConcurrentCacheState::kOpsPerThread;
+constexpr int ConcurrentCacheState::kKeys;
+
+void ConcurrentCacheUser(void* arg) {
+  ConcurrentCacheState* state = reinterpret_cast<ConcurrentCacheState*>(arg);
+  Cache* cache = state->cache_;
+  const int id = state->next_thread_.fetch_add(1);
+  for (int i = 0; i < ConcurrentCacheState::kOpsPerThread; i++) {
+    const int k = (i * 7 + id * 13) % ConcurrentCacheState::kKeys;
+    const std::string key = EncodeKey(k);
+    Cache::Handle* h = cache->Lookup(key);
+    if (h == nullptr) {
+      h = cache->Insert(key, new std::string(key), 1,
+                        &ConcurrentCacheState::Deleter);
+    }
+    if (*reinterpret_cast<std::string*>(cache->Value(h)) != key) {
+      state->mismatches_.fetch_add(1);
+    }
+    if (i % 100 == 0) {
+      cache->Erase(key);
+    }
+    cache->Release(h);
+  }
+  state->MarkDone();
+}
+
+}  // namespace
+
+TEST_F(ClockCacheTest, Concurrent) {
+  delete cache_;
+  cache_ = NewClockCache(ConcurrentCacheState::kKeys / 4, 2);
+
+  ConcurrentCacheState state(cache_);
+  for (int i = 0; i < ConcurrentCacheState::kThreads; i++) {
+    Env::Default()->StartThread(ConcurrentCacheUser, &state);
+  }
+  state.WaitForAll();
+  ASSERT_EQ(0, state.mismatches_.load());
+  ASSERT_LE(cache_->TotalCharge(), ConcurrentCacheState::kKeys / 4 + 4);
+}
+
 }  // namespace leveldb
@@ -28,6 +28,25 @@ Status Env::DeleteDir(const std::string& dirname) { return RemoveDir(dirname); }
 Status Env::RemoveFile(const std::string& fname) { return DeleteFile(fname); }
 Status Env::DeleteFile(const std::string& fname) { return RemoveFile(fname); }
 
+Status Env::NewDirectRandomAccessFile(const std::string& fname,
+                                      RandomAccessFile** result) {
+  return NewRandomAccessFile(fname, result);
+}
+
+Status Env::NewReadaheadRandomAccessFile(const std::string& fname,
+                                         size_t readahead_size,
+                                         RandomAccessFile** result) {
+  return NewRandomAccessFile(fname, result);
+}
+
+Status Env::NewBufferedWritableFile(const std::string& fname,
+                                    size_t buffer_size,
+                                    WritableFile** result) {
+  return NewWritableFile(fname, result);
+}
+
+void Env::SetBackgroundThreads(int number) {}
+
 SequentialFile::~SequentialFile() = default;
 
 RandomAccessFile::~RandomAccessFile() = default;
@@ -11,6 +11,7 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <atomic>
@@ -34,6 +35,7 @@
 #include "port/port.h"
 #include "port/thread_annotations.h"
 #include "util/env_posix_test_helper.h"
+#include "util/mutexlock.h"
 #include "util/posix_logger.h"
 
 namespace leveldb {
@@ -58,6 +60,22 @@ constexpr const int kOpenBaseFlags = 0;
 
 constexpr const size_t kWritableFileBufferSize = 65536;
 
+// Flags added to open table files for direct I/O.
+#if HAVE_O_DIRECT
+constexpr const int kOpenDirectFlags = O_DIRECT;
+#else
+constexpr const int kOpenDirectFlags = 0;
+#endif  // HAVE_O_DIRECT
+
+// Direct reads are issued at offsets, with lengths and into buffers that
+// are multiples of this, which satisfies the logical block size of common
+// devices and file systems.
+constexpr const size_t kDirectIOAlignment = 4096;
+
+// Direct read buffers up to this size are kept by the thread that used
+// them, for its next direct read.
+constexpr const size_t kMaxKeptDirectReadBuffer = 1 << 20;
+
 Status PosixError(const std::string& context, int error_number) {
   if (error_number == ENOENT) {
     return Status::NotFound(context, std::strerror(error_number));
@@ -168,6 +186,54 @@ class PosixSequentialFile final : public SequentialFile {
   const std::string filename_;
 };
 
+// An aligned buffer for direct reads, kept by the thread that owns it.
+class DirectReadBuffer {
+ public:
+  DirectReadBuffer() : data_(nullptr), size_(0) {}
+
+  DirectReadBuffer(const DirectReadBuffer&) = delete;
+  DirectReadBuffer& operator=(const DirectReadBuffer&) = delete;
+
+  ~DirectReadBuffer() { std::free(data_); }
+
+  // Returns the buffer of the calling thread.
+  static DirectReadBuffer* ForCurrentThread() {
+    static thread_local DirectReadBuffer buffer;
+    return &buffer;
+  }
+
+  // Returns a buffer of at least "size" bytes, aligned to
+  // kDirectIOAlignment, or nullptr if it cannot be allocated.  It is
+  // valid until the next call.
+  char* Get(size_t size) {
+    if (size > size_) {
+      std::free(data_);
+      data_ = nullptr;
+      size_ = 0;
+      void* data;
+      if (::posix_memalign(&data, kDirectIOAlignment, size) != 0) {
+        return nullptr;
+      }
+      data_ = reinterpret_cast<char*>(data);
+      size_ = size;
+    }
+    return data_;
+  }
+
+  // Frees the buffer if it is too large to keep.
+  void Trim() {
+    if (size_ > kMaxKeptDirectReadBuffer) {
+      std::free(data_);
+      data_ = nullptr;
+      size_ = 0;
+    }
+  }
+
+ private:
+  char* data_;
+  size_t size_;
+};
+
 // Implements random read access in a file using pread().
 //
 // Instances of this class are thread-safe, as required by the RandomAccessFile
@@ -177,9 +243,14 @@ class PosixRandomAccessFile final : public RandomAccessFile {
  public:
   // The new instance takes ownership of |fd|. |fd_limiter| must outlive this
   // instance, and will be used to determine if .
-  PosixRandomAccessFile(std::string filename, int fd, Limiter* fd_limiter)
+  //
+  // If |direct_io| is true, |fd| was opened with kOpenDirectFlags, and reads
+  // go through aligned buffers.
+  PosixRandomAccessFile(std::string filename, int fd, Limiter* fd_limiter,
+                        bool direct_io = false)
       : has_permanent_fd_(fd_limiter->Acquire()),
         fd_(has_permanent_fd_ ? fd : -1),
+        direct_io_(direct_io),
         fd_limiter_(fd_limiter),
         filename_(std::move(filename)) {
     if (!has_permanent_fd_) {
@@ -200,7 +271,9 @@ class PosixRandomAccessFile final : public RandomAccessFile {
               char* scratch) const override {
     int fd = fd_;
     if (!has_permanent_fd_) {
-      fd = ::open(filename_.c_str(), O_RDONLY | kOpenBaseFlags);
+      const int flags =
+          O_RDONLY | kOpenBaseFlags | (direct_io_ ? kOpenDirectFlags : 0);
+      fd = ::open(filename_.c_str(), flags);
       if (fd < 0) {
         return PosixError(filename_, errno);
       }
@@ -209,11 +282,15 @@ class PosixRandomAccessFile final : public RandomAccessFile {
     assert(fd != -1);
 
     Status status;
-    ssize_t read_size = ::pread(fd, scratch, n, static_cast<off_t>(offset));
-    *result = Slice(scratch, (read_size < 0) ? 0 : read_size);
-    if (read_size < 0) {
-      // An error: return a non-ok status.
-      status = PosixError(filename_, errno);
+    if (direct_io_) {
+      status = DirectRead(fd, offset, n, result, scratch);
+    } else {
+      ssize_t read_size = ::pread(fd, scratch, n, static_cast<off_t>(offset));
+      *result = Slice(scratch, (read_size < 0) ? 0 : read_size);
+      if (read_size < 0) {
+        // An error: return a non-ok status.
+        status = PosixError(filename_, errno);
+      }
     }
     if (!has_permanent_fd_) {
       // Close the temporary file descriptor opened earlier.
@@ -224,8 +301,44 @@ class PosixRandomAccessFile final : public RandomAccessFile {
   }
 
  private:
+  // Reads the aligned range of the file that covers [offset, offset + n)
+  // into an aligned buffer, and copies the requested part to scratch.
+  Status DirectRead(int fd, uint64_t offset, size_t n, Slice* result,
+                    char* scratch) const {
+    const uint64_t aligned_offset = offset & ~(kDirectIOAlignment - 1);
+    const size_t skip = static_cast<size_t>(offset - aligned_offset);
+    const size_t aligned_size =
+        (skip + n + kDirectIOAlignment - 1) & ~(kDirectIOAlignment - 1);
+    DirectReadBuffer* buffer = DirectReadBuffer::ForCurrentThread();
+    char* buf = buffer->Get(aligned_size);
+    if (buf == nullptr) {
+      *result = Slice();
+      return PosixError(filename_, ENOMEM);
+    }
+
+    Status status;
+    ssize_t read_size = ::pread(fd, buf, aligned_size,
+                                static_cast<off_t>(aligned_offset));
+    if (read_size < 0) {
+      *result = Slice();
+      status = PosixError(filename_, errno);
+    } else {
+      // The read stops short at the end of the file.
+      size_t available =
+          static_cast<size_t>(read_size) > skip ? read_size - skip : 0;
+      if (n > available) {
+        n = available;
+      }
+      std::memcpy(scratch, buf + skip, n);
+      *result = Slice(scratch, n);
+    }
+    buffer->Trim();
+    return status;
+  }
+
   const bool has_permanent_fd_;  // If false, the file is opened on every read.
   const int fd_;                 // -1 if has_permanent_fd_ is false.
+  const bool direct_io_;
   Limiter* const fd_limiter_;
   const std::string filename_;
 };
@@ -274,20 +387,164 @@ class PosixMmapReadableFile final : public RandomAccessFile {
   const std::string filename_;
 };
 
+// Implements random read access for a file that is read mostly sequentially,
+// through a buffer that is refilled with a single pread() of readahead_size
+// bytes whenever a read falls outside of it.
+//
+// Instances of this class are thread-safe, but meant for one reader at a time:
+// concurrent readers share, and keep replacing, the one buffer.
+class PosixReadaheadFile final : public RandomAccessFile {
+ public:
+  // The new instance takes ownership of |fd|. |fd_limiter| must outlive this
+  // instance.  As for PosixRandomAccessFile, the file is opened on every
+  // read of the file instead of being kept open if |fd_limiter| has no
+  // descriptors left.
+  PosixReadaheadFile(std::string filename, int fd, size_t readahead_size,
+                     Limiter* fd_limiter)
+      : has_permanent_fd_(fd_limiter->Acquire()),
+        fd_(has_permanent_fd_ ? fd : -1),
+        fd_limiter_(fd_limiter),
+        readahead_size_(readahead_size),
+        filename_(std::move(filename)),
+        buffer_(new char[readahead_size]),
+        buffer_offset_(0),
+        buffer_size_(0) {
+    if (!has_permanent_fd_) {
+      assert(fd_ == -1);
+      ::close(fd);  // The file will be opened on every read.
+    } else {
+#if HAVE_POSIX_FADVISE
+      ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif  // HAVE_POSIX_FADVISE
+    }
+  }
+
+  ~PosixReadaheadFile() override {
+    if (has_permanent_fd_) {
+      assert(fd_ != -1);
+      DropCachedPages(fd_, buffer_offset_, buffer_size_);
+      ::close(fd_);
+      fd_limiter_->Release();
+    }
+    delete[] buffer_;
+  }
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    MutexLock lock(&mutex_);
+    if (offset >= buffer_offset_ &&
+        offset + n <= buffer_offset_ + buffer_size_) {
+      std::memcpy(scratch, buffer_ + (offset - buffer_offset_), n);
+      *result = Slice(scratch, n);
+      return Status::OK();
+    }
+
+    int fd = fd_;
+    if (!has_permanent_fd_) {
+      fd = ::open(filename_.c_str(), O_RDONLY | kOpenBaseFlags);
+      if (fd < 0) {
+        *result = Slice();
+        return PosixError(filename_, errno);
+      }
+    }
+
+    Status status;
+    if (n >= readahead_size_) {
+      // Too large for the buffer.
+      ssize_t read_size = ::pread(fd, scratch, n, static_cast<off_t>(offset));
+      *result = Slice(scratch, (read_size < 0) ? 0 : read_size);
+      if (read_size < 0) {
+        status = PosixError(filename_, errno);
+      } else {
+        DropCachedPages(fd, offset, read_size);
+      }
+    } else {
+      // The data in the buffer has been consumed, so its pages are not
+      // needed in the page cache any more.
+      DropCachedPages(fd, buffer_offset_, buffer_size_);
+      ssize_t read_size = ::pread(fd, buffer_, readahead_size_,
+                                  static_cast<off_t>(offset));
+      buffer_offset_ = offset;
+      buffer_size_ = (read_size < 0) ? 0 : read_size;
+      if (read_size < 0) {
+        *result = Slice();
+        status = PosixError(filename_, errno);
+      } else {
+        if (n > buffer_size_) {
+          n = buffer_size_;  // The read stops short at the end of the file.
+        }
+        std::memcpy(scratch, buffer_, n);
+        *result = Slice(scratch, n);
+      }
+    }
+
+    if (!has_permanent_fd_) {
+      // Close the temporary file descriptor opened earlier.
+      assert(fd != fd_);
+      ::close(fd);
+    }
+    return status;
+  }
+
+ private:
+  // Hints that [offset, offset + size) of the file open as |fd| will not be
+  // read again.
+  static void DropCachedPages(int fd, uint64_t offset, size_t size) {
+#if HAVE_POSIX_FADVISE
+    if (size > 0) {
+      ::posix_fadvise(fd, static_cast<off_t>(offset),
+                      static_cast<off_t>(size), POSIX_FADV_DONTNEED);
+    }
+#endif  // HAVE_POSIX_FADVISE
+  }
+
+  const bool has_permanent_fd_;  // If false, the file is opened on every read.
+  const int fd_;                 // -1 if has_permanent_fd_ is false.
+  Limiter* const fd_limiter_;
+  const size_t readahead_size_;
+  const std::string filename_;
+
+  mutable port::Mutex mutex_;
+  // buffer_[0, buffer_size_ - 1] holds the file's data starting at
+  // buffer_offset_.
+  char* const buffer_ GUARDED_BY(mutex_);
+  mutable uint64_t buffer_offset_ GUARDED_BY(mutex_);
+  mutable size_t buffer_size_ GUARDED_BY(mutex_);
+};
+
 class PosixWritableFile final : public WritableFile {
  public:
-  PosixWritableFile(std::string filename, int fd)
-      : pos_(0),
+  // Data is buffered in kWritableFileBufferSize bytes inside the instance,
+  // or in an aligned heap buffer if |buffer_size| is larger.  If
+  // |buffer_size| is non-zero, the write-back of each buffer is started as
+  // soon as it is written, so that Sync() has less to do.
+  PosixWritableFile(std::string filename, int fd, size_t buffer_size = 0)
+      : buf_(inline_buf_),
+        buf_size_(kWritableFileBufferSize),
+        pos_(0),
         fd_(fd),
+        sync_ranges_(buffer_size != 0),
+        file_size_(0),
+        synced_size_(0),
         is_manifest_(IsManifest(filename)),
         filename_(std::move(filename)),
-        dirname_(Dirname(filename_)) {}
+        dirname_(Dirname(filename_)) {
+    void* buf;
+    if (buffer_size > kWritableFileBufferSize &&
+        ::posix_memalign(&buf, kDirectIOAlignment, buffer_size) == 0) {
+      buf_ = reinterpret_cast<char*>(buf);
+      buf_size_ = buffer_size;
+    }
+  }
 
   ~PosixWritableFile() override {
     if (fd_ >= 0) {
       // Ignoring any potential errors
       Close();
     }
+    if (buf_ != inline_buf_) {
+      std::free(buf_);
+    }
   }
 
   Status Append(const Slice& data) override {
@@ -295,7 +552,7 @@ class PosixWritableFile final : public WritableFile {
     const char* write_data = data.data();
 
     // Fit as much as possible into buffer.
-    size_t copy_size = std::min(write_size, kWritableFileBufferSize - pos_);
+    size_t copy_size = std::min(write_size, buf_size_ - pos_);
     std::memcpy(buf_ + pos_, write_data, copy_size);
     write_data += copy_size;
     write_size -= copy_size;
@@ -311,7 +568,7 @@ class PosixWritableFile final : public WritableFile {
     }
 
     // Small writes go to buffer, large writes are written directly.
-    if (write_size < kWritableFileBufferSize) {
+    if (write_size < buf_size_) {
       std::memcpy(buf_, write_data, write_size);
       pos_ = write_size;
       return Status::OK();
@@ -354,6 +611,16 @@ class PosixWritableFile final : public WritableFile {
   Status FlushBuffer() {
     Status status = WriteUnbuffered(buf_, pos_);
     pos_ = 0;
+#if HAVE_SYNC_FILE_RANGE
+    if (status.ok() && sync_ranges_ && file_size_ > synced_size_) {
+      // Start writing back the new data without waiting for it.  This is
+      // only a hint, so errors are ignored.
+      ::sync_file_range(fd_, static_cast<off_t>(synced_size_),
+                        static_cast<off_t>(file_size_ - synced_size_),
+                        SYNC_FILE_RANGE_WRITE);
+      synced_size_ = file_size_;
+    }
+#endif  // HAVE_SYNC_FILE_RANGE
     return status;
   }
 
@@ -368,6 +635,7 @@ class PosixWritableFile final : public WritableFile {
       }
       data += write_result;
       size -= write_result;
+      file_size_ += write_result;
     }
     return Status::OK();
   }
@@ -455,10 +723,16 @@ class PosixWritableFile final : public WritableFile {
   }
 
   // buf_[0, pos_ - 1] contains data to be written to fd_.
-  char buf_[kWritableFileBufferSize];
+  char inline_buf_[kWritableFileBufferSize];
+  char* buf_;  // inline_buf_, or a larger heap buffer
+  size_t buf_size_;
   size_t pos_;
   int fd_;
 
+  const bool sync_ranges_;  // Start the write-back of each flushed buffer.
+  uint64_t file_size_;      // Bytes written to fd_.
+  uint64_t synced_size_;    // Bytes whose write-back has been started.
+
   const bool is_manifest_;  // True if the file's name starts with MANIFEST.
   const std::string filename_;
   const std::string dirname_;  // The directory of filename_.
@@ -570,6 +844,46 @@ class PosixEnv : public Env {
     return status;
   }
 
+  Status NewDirectRandomAccessFile(const std::string& filename,
+                                   RandomAccessFile** result) override {
+    *result = nullptr;
+    bool direct_io = (kOpenDirectFlags != 0);
+    int fd = ::open(filename.c_str(),
+                    O_RDONLY | kOpenBaseFlags | kOpenDirectFlags);
+    if (fd < 0 && errno == EINVAL && direct_io) {
+      // The file system does not support direct I/O (e.g. tmpfs).
+      direct_io = false;
+      fd = ::open(filename.c_str(), O_RDONLY | kOpenBaseFlags);
+    }
+    if (fd < 0) {
+      return PosixError(filename, errno);
+    }
+#if !HAVE_O_DIRECT && defined(F_NOCACHE)
+    // macOS has no O_DIRECT, but can turn off caching for a descriptor.
+    ::fcntl(fd, F_NOCACHE, 1);
+#endif  // !HAVE_O_DIRECT && defined(F_NOCACHE)
+
+    *result = new PosixRandomAccessFile(filename, fd, &fd_limiter_, direct_io);
+    return Status::OK();
+  }
+
+  Status NewReadaheadRandomAccessFile(const std::string& filename,
+                                      size_t readahead_size,
+                                      RandomAccessFile** result) override {
+    if (readahead_size == 0) {
+      return NewRandomAccessFile(filename, result);
+    }
+    *result = nullptr;
+    int fd = ::open(filename.c_str(), O_RDONLY | kOpenBaseFlags);
+    if (fd < 0) {
+      return PosixError(filename, errno);
+    }
+
+    *result =
+        new PosixReadaheadFile(filename, fd, readahead_size, &fd_limiter_);
+    return Status::OK();
+  }
+
   Status NewWritableFile(const std::string& filename,
                          WritableFile** result) override {
     int fd = ::open(filename.c_str(),
@@ -583,6 +897,20 @@ class PosixEnv : public Env {
     return Status::OK();
   }
 
+  Status NewBufferedWritableFile(const std::string& filename,
+                                 size_t buffer_size,
+                                 WritableFile** result) override {
+    int fd = ::open(filename.c_str(),
+                    O_TRUNC | O_WRONLY | O_CREAT | kOpenBaseFlags, 0644);
+    if (fd < 0) {
+      *result = nullptr;
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixWritableFile(filename, fd, buffer_size);
+    return Status::OK();
+  }
+
   Status NewAppendableFile(const std::string& filename,
                            WritableFile** result) override {
     int fd = ::open(filename.c_str(),
@@ -691,6 +1019,14 @@ class PosixEnv : public Env {
   void Schedule(void (*background_work_function)(void* background_work_arg),
                 void* background_work_arg) override;
 
+  void SetBackgroundThreads(int number) override {
+    background_work_mutex_.Lock();
+    if (number > max_background_threads_) {
+      max_background_threads_ = number;
+    }
+    background_work_mutex_.Unlock();
+  }
+
   void StartThread(void (*thread_main)(void* thread_main_arg),
                    void* thread_main_arg) override {
     std::thread new_thread(thread_main, thread_main_arg);
@@ -767,7 +1103,8 @@ class PosixEnv : public Env {
 
   port::Mutex background_work_mutex_;
   port::CondVar background_work_cv_ GUARDED_BY(background_work_mutex_);
-  bool started_background_thread_ GUARDED_BY(background_work_mutex_);
+  int started_background_threads_ GUARDED_BY(background_work_mutex_);
+  int max_background_threads_ GUARDED_BY(background_work_mutex_);
 
   std::queue<BackgroundWorkItem> background_work_queue_
       GUARDED_BY(background_work_mutex_);
@@ -807,7 +1144,8 @@ int MaxOpenFiles() {
 
 PosixEnv::PosixEnv()
     : background_work_cv_(&background_work_mutex_),
-      started_background_thread_(false),
+      started_background_threads_(0),
+      max_background_threads_(1),
       mmap_limiter_(MaxMmaps()),
       fd_limiter_(MaxOpenFiles()) {}
 
@@ -816,15 +1154,18 @@ void PosixEnv::Schedule(
     void* background_work_arg) {
   background_work_mutex_.Lock();
 
-  // Start the background thread, if we haven't done so already.
-  if (!started_background_thread_) {
-    started_background_thread_ = true;
+  // Start another background thread, if we are allowed to.  Threads are
+  // started lazily and live for the remainder of the process.
+  if (started_background_threads_ < max_background_threads_) {
+    ++started_background_threads_;
     std::thread background_thread(PosixEnv::BackgroundThreadEntryPoint, this);
     background_thread.detach();
   }
 
-  // If the queue is empty, the background thread may be waiting for work.
-  if (background_work_queue_.empty()) {
+  // With a single background thread, it can only be waiting for work if the
+  // queue is empty.  With more threads, some may be idle even when the queue
+  // already holds work, so wake one up for every new item.
+  if (background_work_queue_.empty() || max_background_threads_ > 1) {
     background_work_cv_.Signal();
   }
 
@@ -918,6 +1259,8 @@ void EnvPosixTestHelper::SetReadOnlyMMapLimit(int limit) {
   g_mmap_limit = limit;
 }
 
+Env* EnvPosixTestHelper::NewEnv() { return new PosixEnv; }
+
 Env* Env::Default() {
   static PosixDefaultEnv env_container;
   return env_container.env();
@@ -6,6 +6,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -17,6 +18,7 @@
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "util/env_posix_test_helper.h"
+#include "util/mutexlock.h"
 #include "util/testutil.h"
 
 #if HAVE_O_CLOEXEC
@@ -176,11 +178,115 @@ class EnvPosixTest : public testing::Test {
     EnvPosixTestHelper::SetReadOnlyMMapLimit(mmap_limit);
   }
 
+  // Return an Env whose background threads are only used by the caller,
+  // so that tests of Schedule() do not depend on what ran before them.
+  static Env* NewPrivateEnv() { return EnvPosixTestHelper::NewEnv(); }
+
   EnvPosixTest() : env_(Env::Default()) {}
 
   Env* env_;
 };
 
+TEST_F(EnvPosixTest, RunManyInOrder) {
+  // With a single background thread, work items run in FIFO order.
+  Env* env = NewPrivateEnv();
+
+  struct RunState {
+    port::Mutex mu;
+    port::CondVar cvar{&mu};
+    int last_id = 0;
+  };
+
+  struct Callback {
+    RunState* state_;  // Pointer to shared state.
+    const int id_;     // Order# for the execution of this callback.
+
+    Callback(RunState* s, int id) : state_(s), id_(id) {}
+
+    static void Run(void* arg) {
+      Callback* callback = reinterpret_cast<Callback*>(arg);
+      RunState* state = callback->state_;
+
+      MutexLock l(&state->mu);
+      ASSERT_EQ(state->last_id, callback->id_ - 1);
+      state->last_id = callback->id_;
+      state->cvar.Signal();
+    }
+  };
+
+  RunState state;
+  Callback callback1(&state, 1);
+  Callback callback2(&state, 2);
+  Callback callback3(&state, 3);
+  Callback callback4(&state, 4);
+  env->Schedule(&Callback::Run, &callback1);
+  env->Schedule(&Callback::Run, &callback2);
+  env->Schedule(&Callback::Run, &callback3);
+  env->Schedule(&Callback::Run, &callback4);
+
+  MutexLock l(&state.mu);
+  while (state.last_id != 4) {
+    state.cvar.Wait();
+  }
+}
+
+TEST_F(EnvPosixTest, RunManyConcurrently) {
+  // Once the Env has been asked for more background threads, work items
+  // run at the same time.
+  static const int kItems = 4;
+  Env* env = NewPrivateEnv();
+  env->SetBackgroundThreads(kItems);
+
+  struct RunState {
+    port::Mutex mu;
+    port::CondVar cvar{&mu};
+    int num_run = 0;
+    int running = 0;
+    int peak_running = 0;
+  };
+
+  struct Callback {
+    RunState* state_;   // Pointer to shared state.
+    bool run_ = false;  // Has this callback been executed?
+
+    explicit Callback(RunState* s) : state_(s) {}
+
+    static void Run(void* arg) {
+      Callback* callback = reinterpret_cast<Callback*>(arg);
+      RunState* state = callback->state_;
+
+      MutexLock l(&state->mu);
+      ASSERT_FALSE(callback->run_);
+      callback->run_ = true;
+      state->running++;
+      state->peak_running = std::max(state->peak_running, state->running);
+      // Wait for the other items to start while this one runs.
+      while (state->peak_running < kItems) {
+        state->cvar.Wait();
+      }
+      state->running--;
+      state->num_run++;
+      state->cvar.SignalAll();
+    }
+  };
+
+  RunState state;
+  Callback callbacks[kItems] = {Callback(&state), Callback(&state),
+                                Callback(&state), Callback(&state)};
+  for (int i = 0; i < kItems; i++) {
+    env->Schedule(&Callback::Run, &callbacks[i]);
+  }
+
+  MutexLock l(&state.mu);
+  while (state.num_run != kItems) {
+    state.cvar.Wait();
+  }
+  for (int i = 0; i < kItems; i++) {
+    ASSERT_TRUE(callbacks[i].run_);
+  }
+  ASSERT_EQ(kItems, state.peak_running);
+}
+
 TEST_F(EnvPosixTest, TestOpenOnRead) {
   // Write some test data to a single file that will be opened |n| times.
   std::string test_dir;
@@ -212,6 +318,142 @@ TEST_F(EnvPosixTest, TestOpenOnRead) {
   ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
 }
 
+TEST_F(EnvPosixTest, TestDirectRandomAccessFile) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/direct_random_access.txt";
+
+  // Span several alignment units, and end in the middle of one.
+  std::string data;
+  for (int i = 0; i < 3 * 4096 + 123; i++) {
+    data.push_back(static_cast<char>('a' + i % 26));
+  }
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, data, test_file));
+
+  leveldb::RandomAccessFile* file = nullptr;
+  ASSERT_LEVELDB_OK(env_->NewDirectRandomAccessFile(test_file, &file));
+
+  const uint64_t kOffsets[] = {0, 1, 4095, 4096, 5000, 3 * 4096 + 100};
+  const size_t kSizes[] = {1, 100, 4096, 8192};
+  std::string scratch(8192, '\0');
+  for (uint64_t offset : kOffsets) {
+    for (size_t n : kSizes) {
+      Slice result;
+      ASSERT_LEVELDB_OK(file->Read(offset, n, &result, &scratch[0]));
+      ASSERT_EQ(data.substr(offset, n), result.ToString())
+          << "offset " << offset << " size " << n;
+    }
+  }
+
+  // Reads past the end of the file come back empty.
+  Slice result;
+  ASSERT_LEVELDB_OK(file->Read(data.size() + 10, 10, &result, &scratch[0]));
+  ASSERT_EQ(0, result.size());
+
+  // A read larger than the buffer a thread keeps, followed by small reads.
+  std::string large_scratch(2 << 20, '\0');
+  ASSERT_LEVELDB_OK(file->Read(0, large_scratch.size(), &result,
+                               &large_scratch[0]));
+  ASSERT_EQ(data, result.ToString());
+  ASSERT_LEVELDB_OK(file->Read(5000, 100, &result, &scratch[0]));
+  ASSERT_EQ(data.substr(5000, 100), result.ToString());
+  delete file;
+
+  ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
+}
+
+TEST_F(EnvPosixTest, TestReadaheadRandomAccessFile) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/readahead_random_access.txt";
+
+  std::string data;
+  for (int i = 0; i < 10000; i++) {
+    data.push_back(static_cast<char>('a' + i % 26));
+  }
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, data, test_file));
+
+  leveldb::RandomAccessFile* file = nullptr;
+  ASSERT_LEVELDB_OK(env_->NewReadaheadRandomAccessFile(test_file, 1024, &file));
+
+  // Sequential reads, reads that go back, reads larger than the buffer, and
+  // reads that run past the end of the file.
+  const uint64_t kOffsets[] = {0, 100, 1000, 1100, 50, 5000, 9990, 2000};
+  const size_t kSizes[] = {1, 100, 1024, 3000};
+  std::string scratch(3000, '\0');
+  for (uint64_t offset : kOffsets) {
+    for (size_t n : kSizes) {
+      Slice result;
+      ASSERT_LEVELDB_OK(file->Read(offset, n, &result, &scratch[0]));
+      ASSERT_EQ(data.substr(offset, n), result.ToString())
+          << "offset " << offset << " size " << n;
+    }
+  }
+  delete file;
+
+  ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
+}
+
+TEST_F(EnvPosixTest, TestOpenOnReadReadaheadFile) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/open_on_read_readahead.txt";
+  const char kFileData[] = "abcdefghijklmnopqrstuvwxyz";
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, kFileData, test_file));
+
+  // Readahead files share the descriptor limit of the other read-only
+  // files, so the ones past the limit are opened on every read.
+  const int kNumFiles = kReadOnlyFileLimit + 5;
+  leveldb::RandomAccessFile* files[kNumFiles] = {0};
+  for (int i = 0; i < kNumFiles; i++) {
+    ASSERT_LEVELDB_OK(
+        env_->NewReadaheadRandomAccessFile(test_file, 1024, &files[i]));
+  }
+  char scratch;
+  Slice read_result;
+  for (int i = 0; i < kNumFiles; i++) {
+    ASSERT_LEVELDB_OK(files[i]->Read(i % 26, 1, &read_result, &scratch));
+    ASSERT_EQ(kFileData[i % 26], read_result[0]);
+  }
+
+  for (int i = 0; i < kNumFiles; i++) {
+    delete files[i];
+  }
+  ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
+}
+
+TEST_F(EnvPosixTest, TestBufferedWritableFile) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/buffered_writable.txt";
+
+  // Small appends that fill the buffer several times, and an append that
+  // is larger than the buffer.
+  const size_t kBufferSize = 1 << 20;
+  leveldb::WritableFile* file = nullptr;
+  ASSERT_LEVELDB_OK(
+      env_->NewBufferedWritableFile(test_file, kBufferSize, &file));
+  std::string data;
+  for (int i = 0; i < 100000; i++) {
+    std::string record(1 + i % 97, static_cast<char>('a' + i % 26));
+    ASSERT_LEVELDB_OK(file->Append(record));
+    data += record;
+  }
+  std::string large(2 * kBufferSize + 5, 'x');
+  ASSERT_LEVELDB_OK(file->Append(large));
+  data += large;
+  ASSERT_LEVELDB_OK(file->Sync());
+  ASSERT_LEVELDB_OK(file->Close());
+  delete file;
+
+  std::string contents;
+  ASSERT_LEVELDB_OK(ReadFileToString(env_, test_file, &contents));
+  ASSERT_EQ(data.size(), contents.size());
+  ASSERT_TRUE(data == contents);
+
+  ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
+}
+
 #if HAVE_O_CLOEXEC
 
 TEST_F(EnvPosixTest, TestCloseOnExecSequentialFile) {
@@ -7,6 +7,7 @@
 
 namespace leveldb {
 
+class Env;
 class EnvPosixTest;
 
 // A helper for the POSIX Env to facilitate testing.
@@ -21,6 +22,10 @@ class EnvPosixTestHelper {
   // Set the maximum number of read-only files that will be mapped via mmap.
   // Must be called before creating an Env.
   static void SetReadOnlyMMapLimit(int limit);
+
+  // Return a new Env that does not share its background threads with
+  // Env::Default() or any other Env.  The result must not be deleted.
+  static Env* NewEnv();
 };
 
 }  // namespace leveldb
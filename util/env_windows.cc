@@ -615,6 +615,14 @@ class WindowsEnv : public Env {
   void Schedule(void (*background_work_function)(void* background_work_arg),
                 void* background_work_arg) override;
 
+  void SetBackgroundThreads(int number) override {
+    background_work_mutex_.Lock();
+    if (number > max_background_threads_) {
+      max_background_threads_ = number;
+    }
+    background_work_mutex_.Unlock();
+  }
+
   void StartThread(void (*thread_main)(void* thread_main_arg),
                    void* thread_main_arg) override {
     std::thread new_thread(thread_main, thread_main_arg);
@@ -692,7 +700,8 @@ class WindowsEnv : public Env {
 
   port::Mutex background_work_mutex_;
   port::CondVar background_work_cv_ GUARDED_BY(background_work_mutex_);
-  bool started_background_thread_ GUARDED_BY(background_work_mutex_);
+  int started_background_threads_ GUARDED_BY(background_work_mutex_);
+  int max_background_threads_ GUARDED_BY(background_work_mutex_);
 
   std::queue<BackgroundWorkItem> background_work_queue_
       GUARDED_BY(background_work_mutex_);
@@ -705,7 +714,8 @@ int MaxMmaps() { return g_mmap_limit; }
 
 WindowsEnv::WindowsEnv()
     : background_work_cv_(&background_work_mutex_),
-      started_background_thread_(false),
+      started_background_threads_(0),
+      max_background_threads_(1),
       mmap_limiter_(MaxMmaps()) {}
 
 void WindowsEnv::Schedule(
@@ -713,15 +723,18 @@ void WindowsEnv::Schedule(
     void* background_work_arg) {
   background_work_mutex_.Lock();
 
-  // Start the background thread, if we haven't done so already.
-  if (!started_background_thread_) {
-    started_background_thread_ = true;
+  // Start another background thread, if we are allowed to.  Threads are
+  // started lazily and live for the remainder of the process.
+  if (started_background_threads_ < max_background_threads_) {
+    ++started_background_threads_;
     std::thread background_thread(WindowsEnv::BackgroundThreadEntryPoint, this);
     background_thread.detach();
   }
 
-  // If the queue is empty, the background thread may be waiting for work.
-  if (background_work_queue_.empty()) {
+  // With a single background thread, it can only be waiting for work if the
+  // queue is empty.  With more threads, some may be idle even when the queue
+  // already holds work, so wake one up for every new item.
+  if (background_work_queue_.empty() || max_background_threads_ > 1) {
     background_work_cv_.Signal();
   }
 
@@ -8,4 +8,10 @@ namespace leveldb {
 
 FilterPolicy::~FilterPolicy() {}
 
+const FilterPolicy* FilterPolicy::PolicyForLevel(int level,
+                                                 const uint64_t* level_bytes,
+                                                 int num_levels) const {
+  return this;
+}
+
 }  // namespace leveldb
@@ -0,0 +1,70 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/prefix_extractor.h"
+
+#include <cstring>
+#include <string>
+
+namespace leveldb {
+
+PrefixExtractor::~PrefixExtractor() = default;
+
+namespace {
+
+class FixedPrefixExtractor : public PrefixExtractor {
+ public:
+  explicit FixedPrefixExtractor(size_t length)
+      : length_(length),
+        name_("leveldb.FixedPrefix." + std::to_string(length)) {}
+
+  const char* Name() const override { return name_.c_str(); }
+
+  bool InDomain(const Slice& key) const override {
+    return key.size() >= length_;
+  }
+
+  Slice Transform(const Slice& key) const override {
+    return Slice(key.data(), length_);
+  }
+
+ private:
+  const size_t length_;
+  const std::string name_;
+};
+
+class DelimitedPrefixExtractor : public PrefixExtractor {
+ public:
+  explicit DelimitedPrefixExtractor(char delimiter)
+      : delimiter_(delimiter),
+        name_(std::string("leveldb.DelimitedPrefix.") + delimiter) {}
+
+  const char* Name() const override { return name_.c_str(); }
+
+  bool InDomain(const Slice& key) const override {
+    return std::memchr(key.data(), delimiter_, key.size()) != nullptr;
+  }
+
+  Slice Transform(const Slice& key) const override {
+    const char* end = reinterpret_cast<const char*>(
+        std::memchr(key.data(), delimiter_, key.size()));
+    return Slice(key.data(), end + 1 - key.data());
+  }
+
+ private:
+  const char delimiter_;
+  const std::string name_;
+};
+
+}  // namespace
+
+const PrefixExtractor* NewFixedPrefixExtractor(size_t length) {
+  return new FixedPrefixExtractor(length);
+}
+
+const PrefixExtractor* NewDelimitedPrefixExtractor(char delimiter) {
+  return new DelimitedPrefixExtractor(delimiter);
+}
+
+}  // namespace leveldb
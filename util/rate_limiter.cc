@@ -0,0 +1,262 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/rate_limiter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+RateLimiter::~RateLimiter() = default;
+
+namespace {
+
+// Interval between refills of the token bucket.
+static const uint64_t kRefillPeriodMicros = 100 * 1000;
+
+// One in this many refills serves low priority requests first.
+static const int kFairness = 10;
+
+// An auto-tuned limiter is adjusted once per this many refill periods,
+// and never drops below its maximum divided by kAutoTuneMinDivisor.
+static const int kAutoTunePeriods = 100;
+static const int kAutoTuneMinDivisor = 20;
+
+class GenericRateLimiter : public RateLimiter {
+ public:
+  GenericRateLimiter(uint64_t bytes_per_second, bool auto_tuned, Env* env)
+      : env_(env),
+        auto_tuned_(auto_tuned),
+        max_bytes_per_second_(std::max<uint64_t>(bytes_per_second, 1)),
+        bytes_per_second_(max_bytes_per_second_),
+        available_(0),
+        next_refill_micros_(0),
+        refills_(0),
+        drained_(false),
+        tune_periods_(0),
+        tune_drained_periods_(0),
+        leader_(nullptr) {
+    for (int i = 0; i < kNumPriorities; i++) {
+      total_bytes_through_[i] = 0;
+    }
+  }
+
+  ~GenericRateLimiter() override {
+    for (int i = 0; i < kNumPriorities; i++) {
+      assert(queues_[i].empty());
+    }
+  }
+
+  void Request(size_t bytes, Priority priority) override {
+    MutexLock l(&mu_);
+    total_bytes_through_[priority] += bytes;
+    Waiter w(bytes, &mu_);
+    queues_[priority].push_back(&w);
+    while (!w.granted) {
+      if (leader_ == nullptr) {
+        leader_ = &w;
+      }
+      if (leader_ != &w) {
+        w.cv.Wait();
+        continue;
+      }
+
+      // The leader hands out the bytes of the current period, and
+      // otherwise waits for the next refill on behalf of all the queued
+      // requests.
+      uint64_t now = env_->NowMicros();
+      if (now >= next_refill_micros_) {
+        Refill(now);
+      }
+      GrantRequests();
+      if (w.granted) {
+        break;
+      }
+      now = env_->NowMicros();
+      if (now < next_refill_micros_) {
+        mu_.Unlock();
+        env_->SleepForMicroseconds(
+            static_cast<int>(next_refill_micros_ - now));
+        mu_.Lock();
+      }
+    }
+
+    if (leader_ == &w) {
+      // Let the next queued request take over.
+      leader_ = nullptr;
+      for (int i = kNumPriorities - 1; i >= 0; i--) {
+        if (!queues_[i].empty()) {
+          queues_[i].front()->cv.Signal();
+          break;
+        }
+      }
+    }
+  }
+
+  uint64_t GetBytesPerSecond() const override {
+    MutexLock l(&mu_);
+    return bytes_per_second_;
+  }
+
+  void SetBytesPerSecond(uint64_t bytes_per_second) override {
+    MutexLock l(&mu_);
+    max_bytes_per_second_ = std::max<uint64_t>(bytes_per_second, 1);
+    if (auto_tuned_) {
+      bytes_per_second_ = std::min(bytes_per_second_, max_bytes_per_second_);
+      bytes_per_second_ = std::max(bytes_per_second_, MinBytesPerSecond());
+    } else {
+      bytes_per_second_ = max_bytes_per_second_;
+    }
+  }
+
+  uint64_t GetTotalBytesThrough(Priority priority) const override {
+    MutexLock l(&mu_);
+    return total_bytes_through_[priority];
+  }
+
+ private:
+  struct Waiter {
+    Waiter(size_t bytes, port::Mutex* mu)
+        : bytes(bytes), granted(false), cv(mu) {}
+
+    size_t bytes;  // Bytes that still have to be granted
+    bool granted;
+    port::CondVar cv;
+  };
+
+  uint64_t MinBytesPerSecond() const EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return std::max<uint64_t>(max_bytes_per_second_ / kAutoTuneMinDivisor, 1);
+  }
+
+  // Start a new refill period at time "now".  Bytes left over from the
+  // previous period are not carried over.
+  void Refill(uint64_t now) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (auto_tuned_) {
+      if (next_refill_micros_ != 0 && now >= next_refill_micros_) {
+        tune_periods_ += 1 + (now - next_refill_micros_) / kRefillPeriodMicros;
+      }
+      if (drained_) {
+        tune_drained_periods_++;
+      }
+      if (tune_periods_ >= kAutoTunePeriods) {
+        Tune();
+      }
+    }
+    drained_ = false;
+    available_ = std::max<uint64_t>(
+        bytes_per_second_ * kRefillPeriodMicros / 1000000, 1);
+    next_refill_micros_ = now + kRefillPeriodMicros;
+    refills_++;
+  }
+
+  // Grant queued requests from the bytes available in this period.  A
+  // request that does not fit is granted part of its bytes, and waits for
+  // the next refill for the rest.
+  void GrantRequests() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const bool low_first = (refills_ % kFairness) == 0;
+    for (int i = 0; i < kNumPriorities; i++) {
+      const int priority = low_first ? i : kNumPriorities - 1 - i;
+      std::deque<Waiter*>* queue = &queues_[priority];
+      while (!queue->empty()) {
+        Waiter* w = queue->front();
+        if (w->bytes > available_) {
+          w->bytes -= available_;
+          available_ = 0;
+          drained_ = true;
+          return;
+        }
+        available_ -= w->bytes;
+        w->bytes = 0;
+        w->granted = true;
+        queue->pop_front();
+        if (w != leader_) {
+          w->cv.Signal();
+        }
+      }
+    }
+  }
+
+  // Raise the limit if most of the recent periods ran out of bytes, and
+  // lower it if few of them did.
+  void Tune() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    uint64_t rate = bytes_per_second_;
+    if (tune_drained_periods_ * 100 > tune_periods_ * 90) {
+      rate = std::max(rate * 105 / 100, rate + 1);
+    } else if (tune_drained_periods_ * 100 < tune_periods_ * 50) {
+      rate = rate * 100 / 105;
+    }
+    rate = std::min(rate, max_bytes_per_second_);
+    bytes_per_second_ = std::max(rate, MinBytesPerSecond());
+    tune_periods_ = 0;
+    tune_drained_periods_ = 0;
+  }
+
+  Env* const env_;
+  const bool auto_tuned_;
+
+  mutable port::Mutex mu_;
+  uint64_t max_bytes_per_second_ GUARDED_BY(mu_);
+  uint64_t bytes_per_second_ GUARDED_BY(mu_);
+  uint64_t available_ GUARDED_BY(mu_);  // Bytes left in this period
+  uint64_t next_refill_micros_ GUARDED_BY(mu_);
+  uint64_t refills_ GUARDED_BY(mu_);
+
+  // Did requests have to wait for the next refill in this period?
+  bool drained_ GUARDED_BY(mu_);
+
+  // Periods since the last auto-tuning, and how many of them drained.
+  uint64_t tune_periods_ GUARDED_BY(mu_);
+  uint64_t tune_drained_periods_ GUARDED_BY(mu_);
+
+  // The request whose thread waits for refills, or null.
+  Waiter* leader_ GUARDED_BY(mu_);
+
+  // Requests waiting for bytes, by priority, oldest first.
+  std::deque<Waiter*> queues_[kNumPriorities] GUARDED_BY(mu_);
+  uint64_t total_bytes_through_[kNumPriorities] GUARDED_BY(mu_);
+};
+
+class RateLimitedWritableFile : public WritableFile {
+ public:
+  RateLimitedWritableFile(WritableFile* base, RateLimiter* limiter,
+                          RateLimiter::Priority priority)
+      : base_(base), limiter_(limiter), priority_(priority) {}
+
+  ~RateLimitedWritableFile() override { delete base_; }
+
+  Status Append(const Slice& data) override {
+    limiter_->Request(data.size(), priority_);
+    return base_->Append(data);
+  }
+  Status Close() override { return base_->Close(); }
+  Status Flush() override { return base_->Flush(); }
+  Status Sync() override { return base_->Sync(); }
+
+ private:
+  WritableFile* const base_;
+  RateLimiter* const limiter_;
+  const RateLimiter::Priority priority_;
+};
+
+}  // namespace
+
+RateLimiter* NewGenericRateLimiter(uint64_t bytes_per_second, bool auto_tuned,
+                                   Env* env) {
+  return new GenericRateLimiter(bytes_per_second, auto_tuned, env);
+}
+
+WritableFile* NewRateLimitedWritableFile(WritableFile* base,
+                                         RateLimiter* limiter,
+                                         RateLimiter::Priority priority) {
+  return new RateLimitedWritableFile(base, limiter, priority);
+}
+
+}  // namespace leveldb
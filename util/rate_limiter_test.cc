@@ -0,0 +1,136 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/rate_limiter.h"
+
+#include <atomic>
+
+#include "gtest/gtest.h"
+#include "leveldb/env.h"
+
+namespace leveldb {
+
+// An Env whose clock only advances when a thread sleeps.
+class FakeClockEnv : public EnvWrapper {
+ public:
+  FakeClockEnv() : EnvWrapper(Env::Default()), now_micros_(1000000) {}
+
+  uint64_t NowMicros() override {
+    return now_micros_.load(std::memory_order_acquire);
+  }
+
+  void SleepForMicroseconds(int micros) override {
+    // Give other threads a chance to queue their requests.
+    target()->SleepForMicroseconds(100);
+    now_micros_.fetch_add(micros, std::memory_order_acq_rel);
+  }
+
+ private:
+  std::atomic<uint64_t> now_micros_;
+};
+
+TEST(RateLimiterTest, Rate) {
+  FakeClockEnv env;
+  RateLimiter* limiter = NewGenericRateLimiter(1 << 20, false, &env);
+  const uint64_t start = env.NowMicros();
+  for (int i = 0; i < 256; i++) {
+    limiter->Request(4096, RateLimiter::kLow);
+  }
+  const uint64_t elapsed = env.NowMicros() - start;
+  ASSERT_GE(elapsed, 900000);
+  ASSERT_LE(elapsed, 1100000);
+  ASSERT_EQ(1 << 20, limiter->GetTotalBytesThrough(RateLimiter::kLow));
+  ASSERT_EQ(0, limiter->GetTotalBytesThrough(RateLimiter::kHigh));
+
+  // Requests larger than a refill are granted over several refills.
+  limiter->SetBytesPerSecond(2 << 20);
+  ASSERT_EQ(2 << 20, limiter->GetBytesPerSecond());
+  const uint64_t start2 = env.NowMicros();
+  limiter->Request(4 << 20, RateLimiter::kHigh);
+  const uint64_t elapsed2 = env.NowMicros() - start2;
+  ASSERT_GE(elapsed2, 1900000);
+  ASSERT_LE(elapsed2, 2100000);
+  ASSERT_EQ(4 << 20, limiter->GetTotalBytesThrough(RateLimiter::kHigh));
+  delete limiter;
+}
+
+namespace {
+
+struct PriorityState {
+  RateLimiter* limiter;
+  Env* env;
+  std::atomic<int> done;
+};
+
+struct PriorityThread {
+  PriorityState* state;
+  RateLimiter::Priority priority;
+  int requests;
+  uint64_t finish_micros;
+};
+
+static void PriorityBody(void* arg) {
+  PriorityThread* t = reinterpret_cast<PriorityThread*>(arg);
+  for (int i = 0; i < t->requests; i++) {
+    t->state->limiter->Request(10000, t->priority);
+  }
+  t->finish_micros = t->state->env->NowMicros();
+  t->state->done.fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST(RateLimiterTest, Priority) {
+  FakeClockEnv env;
+  PriorityState state;
+  state.limiter = NewGenericRateLimiter(1 << 20, false, &env);
+  state.env = &env;
+  state.done.store(0, std::memory_order_release);
+
+  const int kLowThreads = 4;
+  PriorityThread threads[kLowThreads + 1];
+  for (int i = 0; i <= kLowThreads; i++) {
+    threads[i].state = &state;
+    threads[i].priority = (i == 0) ? RateLimiter::kHigh : RateLimiter::kLow;
+    threads[i].requests = (i == 0) ? 20 : 100;
+    Env::Default()->StartThread(PriorityBody, &threads[i]);
+  }
+  while (state.done.load(std::memory_order_acquire) < kLowThreads + 1) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+
+  // The high priority thread gets ahead of the low priority ones even
+  // though it has the same share of the bytes.
+  for (int i = 1; i <= kLowThreads; i++) {
+    ASSERT_LT(threads[0].finish_micros, threads[i].finish_micros);
+  }
+  ASSERT_EQ(200000, state.limiter->GetTotalBytesThrough(RateLimiter::kHigh));
+  ASSERT_EQ(4000000, state.limiter->GetTotalBytesThrough(RateLimiter::kLow));
+  delete state.limiter;
+}
+
+TEST(RateLimiterTest, AutoTune) {
+  FakeClockEnv env;
+  const uint64_t kMaxRate = 10 << 20;
+  RateLimiter* limiter = NewGenericRateLimiter(kMaxRate, true, &env);
+  ASSERT_EQ(kMaxRate, limiter->GetBytesPerSecond());
+
+  // A light load lowers the limit.
+  for (int i = 0; i < 300; i++) {
+    limiter->Request(1000, RateLimiter::kLow);
+    env.SleepForMicroseconds(100000);
+  }
+  const uint64_t lowered = limiter->GetBytesPerSecond();
+  ASSERT_LT(lowered, kMaxRate);
+  ASSERT_GE(lowered, kMaxRate / 20);
+
+  // A load that keeps running out of bytes raises it again.
+  for (int i = 0; i < 300; i++) {
+    limiter->Request(kMaxRate / 5, RateLimiter::kLow);
+  }
+  ASSERT_GT(limiter->GetBytesPerSecond(), lowered);
+  delete limiter;
+}
+
+}  // namespace leveldb
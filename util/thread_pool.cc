@@ -0,0 +1,72 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/thread_pool.h"
+
+#include "leveldb/env.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+Scheduler::~Scheduler() = default;
+
+ThreadPool::ThreadPool(Env* env, int num_threads)
+    : env_(env),
+      num_threads_(num_threads),
+      work_cv_(&mu_),
+      started_(false),
+      shutting_down_(false),
+      running_threads_(0) {}
+
+ThreadPool::~ThreadPool() {
+  MutexLock l(&mu_);
+  shutting_down_ = true;
+  work_cv_.SignalAll();
+  while (running_threads_ > 0) {
+    work_cv_.Wait();
+  }
+}
+
+void ThreadPool::Schedule(void (*function)(void*), void* arg) {
+  MutexLock l(&mu_);
+  if (!started_) {
+    started_ = true;
+    running_threads_ = num_threads_;
+    for (int i = 0; i < num_threads_; i++) {
+      env_->StartThread(&ThreadPool::ThreadMainWrapper, this);
+    }
+  }
+  queue_.push_back(Work{function, arg});
+  work_cv_.Signal();
+}
+
+void ThreadPool::ThreadMainWrapper(void* pool) {
+  reinterpret_cast<ThreadPool*>(pool)->ThreadMain();
+}
+
+void ThreadPool::ThreadMain() {
+  mu_.Lock();
+  while (true) {
+    while (queue_.empty() && !shutting_down_) {
+      work_cv_.Wait();
+    }
+    if (queue_.empty()) {
+      break;  // Shutting down, and all the work is done
+    }
+    Work work = queue_.front();
+    queue_.pop_front();
+    mu_.Unlock();
+    (*work.function)(work.arg);
+    mu_.Lock();
+  }
+  running_threads_--;
+  work_cv_.SignalAll();
+  mu_.Unlock();
+}
+
+Scheduler* NewThreadPoolScheduler(int num_threads, Env* env) {
+  return new ThreadPool(env, num_threads);
+}
+
+}  // namespace leveldb
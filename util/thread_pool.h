@@ -0,0 +1,59 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_THREAD_POOL_H_
+#define STORAGE_LEVELDB_UTIL_THREAD_POOL_H_
+
+#include <deque>
+
+#include "leveldb/scheduler.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
+namespace leveldb {
+
+class Env;
+
+// A fixed set of threads that run scheduled functions in FIFO order.
+// The threads are separate from those behind Env::Schedule(), so the
+// functions scheduled here neither wait for nor hold up compactions.
+class ThreadPool : public Scheduler {
+ public:
+  // Runs functions on "num_threads" threads, which are started through
+  // env->StartThread() the first time Schedule() is called.
+  ThreadPool(Env* env, int num_threads);
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Runs the functions that are still queued, then waits for the
+  // threads to exit.
+  ~ThreadPool() override;
+
+  // Arrange to run "(*function)(arg)" on one of the threads.
+  void Schedule(void (*function)(void* arg), void* arg) override;
+
+ private:
+  struct Work {
+    void (*function)(void*);
+    void* arg;
+  };
+
+  static void ThreadMainWrapper(void* pool);
+  void ThreadMain();
+
+  Env* const env_;
+  const int num_threads_;
+
+  port::Mutex mu_;
+  port::CondVar work_cv_ GUARDED_BY(mu_);
+  std::deque<Work> queue_ GUARDED_BY(mu_);
+  bool started_ GUARDED_BY(mu_);
+  bool shutting_down_ GUARDED_BY(mu_);
+  int running_threads_ GUARDED_BY(mu_);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_THREAD_POOL_H_
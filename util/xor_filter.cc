@@ -0,0 +1,209 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// An xor filter [Graf, Lemire 2020] stores one f-bit fingerprint per slot
+// in an array of about 1.23 slots per key.  Each key maps to three slots,
+// one in each third of the array, and the array is filled in so that the
+// xor of those three slots is the fingerprint of the key.  A key that was
+// not added matches with probability 2^-f, for about 1.23*f bits per key,
+// compared to about 1.44*log2(1/fpr) bits per key for a bloom filter.
+//
+// A filter is encoded as:
+//    fingerprints: uint8[3 * block_length * f / 8]
+//    seed:         fixed64
+//    block_length: fixed32
+//    f:            uint8  (8 or 16)
+//
+// A filter over no keys has no fingerprints and matches nothing.  If the
+// filter could not be built, f is 0 and the filter matches every key.
+
+#include <algorithm>
+#include <vector>
+
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+static const size_t kXorTrailerSize = 8 + 4 + 1;
+
+// Give up on filters that cannot be built, rather than retry forever.
+// Each attempt fails with a small constant probability.
+static const int kMaxXorAttempts = 64;
+
+static uint64_t XorKeyHash(const Slice& key) {
+  return (static_cast<uint64_t>(Hash(key.data(), key.size(), 0xbc9f1d34))
+          << 32) |
+         Hash(key.data(), key.size(), 0x2d358dcc);
+}
+
+// Finalizer of MurmurHash3, used to combine a key hash with the seed.
+static uint64_t XorMix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+static uint32_t XorSlot(uint64_t h, int i, uint32_t block_length) {
+  // Use a different rotation of h for each of the three slots, and map
+  // its low 32 bits onto [0, block_length) without a division.
+  if (i > 0) {
+    h = (h << (21 * i)) | (h >> (64 - 21 * i));
+  }
+  const uint64_t r = static_cast<uint32_t>(h);
+  return static_cast<uint32_t>((r * block_length) >> 32) + i * block_length;
+}
+
+static uint32_t XorFingerprint(uint64_t h) {
+  return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+class XorFilterPolicy : public FilterPolicy {
+ public:
+  explicit XorFilterPolicy(int fingerprint_bits)
+      : fingerprint_bits_(fingerprint_bits <= 8 ? 8 : 16) {}
+
+  const char* Name() const override { return "leveldb.XorFilter"; }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    // Duplicate keys would never peel, so build over the distinct hashes.
+    std::vector<uint64_t> hashes(n);
+    for (int i = 0; i < n; i++) {
+      hashes[i] = XorKeyHash(keys[i]);
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    const size_t size = hashes.size();
+
+    const uint32_t block_length =
+        size == 0 ? 0 : static_cast<uint32_t>((32 + 1.23 * size) / 3);
+    const size_t capacity = 3 * static_cast<size_t>(block_length);
+
+    // Find an order in which every key owns a slot that none of the keys
+    // after it map to, by repeatedly removing keys from slots that only
+    // one remaining key maps to.
+    std::vector<uint64_t> xor_masks(capacity);
+    std::vector<uint32_t> counts(capacity);
+    std::vector<uint32_t> queue;
+    std::vector<std::pair<uint64_t, uint32_t>> stack;  // (hash, slot)
+    uint64_t seed = 0;
+    for (int attempt = 0; size > 0; attempt++) {
+      if (attempt == kMaxXorAttempts) {
+        // Leave a filter that matches every key.
+        PutFixed64(dst, 0);
+        PutFixed32(dst, 0);
+        dst->push_back(0);
+        return;
+      }
+      seed = XorMix(seed + 0x9e3779b97f4a7c15ull);
+      std::fill(xor_masks.begin(), xor_masks.end(), 0);
+      std::fill(counts.begin(), counts.end(), 0);
+      for (size_t i = 0; i < size; i++) {
+        const uint64_t h = XorMix(hashes[i] + seed);
+        for (int j = 0; j < 3; j++) {
+          const uint32_t slot = XorSlot(h, j, block_length);
+          xor_masks[slot] ^= h;
+          counts[slot]++;
+        }
+      }
+      queue.clear();
+      for (size_t slot = 0; slot < capacity; slot++) {
+        if (counts[slot] == 1) queue.push_back(static_cast<uint32_t>(slot));
+      }
+      stack.clear();
+      while (!queue.empty()) {
+        const uint32_t slot = queue.back();
+        queue.pop_back();
+        if (counts[slot] != 1) continue;  // Emptied by another removal
+        const uint64_t h = xor_masks[slot];
+        stack.push_back(std::make_pair(h, slot));
+        for (int j = 0; j < 3; j++) {
+          const uint32_t other = XorSlot(h, j, block_length);
+          xor_masks[other] ^= h;
+          if (--counts[other] == 1) queue.push_back(other);
+        }
+      }
+      if (stack.size() == size) break;
+    }
+
+    // Assign fingerprints in the reverse order, so that each key's own slot
+    // is set after the other two slots it maps to have their final values.
+    std::vector<uint32_t> fingerprints(capacity);
+    const uint32_t mask = (1u << fingerprint_bits_) - 1;
+    for (size_t i = stack.size(); i > 0; i--) {
+      const uint64_t h = stack[i - 1].first;
+      const uint32_t slot = stack[i - 1].second;
+      uint32_t fp = XorFingerprint(h);
+      for (int j = 0; j < 3; j++) {
+        fp ^= fingerprints[XorSlot(h, j, block_length)];
+      }
+      fingerprints[slot] = fp & mask;
+    }
+    AppendFilter(fingerprints, seed, block_length, dst);
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& xor_filter) const override {
+    const size_t len = xor_filter.size();
+    if (len < kXorTrailerSize) return false;
+
+    const char* trailer = xor_filter.data() + len - kXorTrailerSize;
+    const uint64_t seed = DecodeFixed64(trailer);
+    const uint32_t block_length = DecodeFixed32(trailer + 8);
+    const int bits = static_cast<unsigned char>(trailer[12]);
+    if (bits != 8 && bits != 16) {
+      // The filter could not be built, or is reserved for potentially
+      // new encodings.  Consider it a match.
+      return true;
+    }
+    if (block_length == 0) {
+      return false;  // No keys
+    }
+    const size_t bytes_per_slot = bits / 8;
+    if (len - kXorTrailerSize != 3 * block_length * bytes_per_slot) {
+      return true;  // Errors are treated as potential matches
+    }
+
+    const unsigned char* array =
+        reinterpret_cast<const unsigned char*>(xor_filter.data());
+    const uint64_t h = XorMix(XorKeyHash(key) + seed);
+    uint32_t fp = XorFingerprint(h);
+    for (int j = 0; j < 3; j++) {
+      const unsigned char* p =
+          array + XorSlot(h, j, block_length) * bytes_per_slot;
+      fp ^= (bytes_per_slot == 1) ? p[0] : (p[0] | (p[1] << 8));
+    }
+    return (fp & ((1u << bits) - 1)) == 0;
+  }
+
+ private:
+  void AppendFilter(const std::vector<uint32_t>& fingerprints, uint64_t seed,
+                    uint32_t block_length, std::string* dst) const {
+    for (size_t i = 0; i < fingerprints.size(); i++) {
+      dst->push_back(static_cast<char>(fingerprints[i]));
+      if (fingerprint_bits_ == 16) {
+        dst->push_back(static_cast<char>(fingerprints[i] >> 8));
+      }
+    }
+    PutFixed64(dst, seed);
+    PutFixed32(dst, block_length);
+    dst->push_back(static_cast<char>(fingerprint_bits_));
+  }
+
+  const int fingerprint_bits_;
+};
+
+}  // namespace
+
+const FilterPolicy* NewXorFilterPolicy(int fingerprint_bits) {
+  return new XorFilterPolicy(fingerprint_bits);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,154 @@
+// Copyright (c) 2026 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "gtest/gtest.h"
+#include "leveldb/filter_policy.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static const int kVerbose = 1;
+
+static Slice Key(int i, char* buffer) {
+  EncodeFixed32(buffer, i);
+  return Slice(buffer, sizeof(uint32_t));
+}
+
+class XorFilterTest : public testing::Test {
+ public:
+  XorFilterTest() : policy_(NewXorFilterPolicy(8)) {}
+
+  ~XorFilterTest() { delete policy_; }
+
+  void UsePolicy(const FilterPolicy* policy) {
+    delete policy_;
+    policy_ = policy;
+  }
+
+  void Reset() {
+    keys_.clear();
+    filter_.clear();
+  }
+
+  void Add(const Slice& s) { keys_.push_back(s.ToString()); }
+
+  void Build() {
+    std::vector<Slice> key_slices;
+    for (size_t i = 0; i < keys_.size(); i++) {
+      key_slices.push_back(Slice(keys_[i]));
+    }
+    filter_.clear();
+    policy_->CreateFilter(key_slices.data(),
+                          static_cast<int>(key_slices.size()), &filter_);
+    keys_.clear();
+  }
+
+  size_t FilterSize() const { return filter_.size(); }
+
+  bool Matches(const Slice& s) {
+    if (!keys_.empty()) {
+      Build();
+    }
+    return policy_->KeyMayMatch(s, filter_);
+  }
+
+  double FalsePositiveRate() {
+    char buffer[sizeof(int)];
+    int result = 0;
+    for (int i = 0; i < 10000; i++) {
+      if (Matches(Key(i + 1000000000, buffer))) {
+        result++;
+      }
+    }
+    return result / 10000.0;
+  }
+
+ private:
+  const FilterPolicy* policy_;
+  std::string filter_;
+  std::vector<std::string> keys_;
+};
+
+TEST_F(XorFilterTest, EmptyFilter) {
+  Build();
+  ASSERT_TRUE(!Matches("hello"));
+  ASSERT_TRUE(!Matches("world"));
+}
+
+TEST_F(XorFilterTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+  ASSERT_TRUE(!Matches("foo"));
+}
+
+TEST_F(XorFilterTest, DuplicateKeys) {
+  Add("hello");
+  Add("hello");
+  Add("world");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+}
+
+static int NextLength(int length) {
+  if (length < 10) {
+    length += 1;
+  } else if (length < 100) {
+    length += 10;
+  } else if (length < 1000) {
+    length += 100;
+  } else {
+    length += 10000;
+  }
+  return length;
+}
+
+static void CheckVaryingLengths(XorFilterTest* test, int fingerprint_bits,
+                                double max_rate) {
+  char buffer[sizeof(int)];
+  for (int length = 1; length <= 100000; length = NextLength(length)) {
+    test->Reset();
+    for (int i = 0; i < length; i++) {
+      test->Add(Key(i, buffer));
+    }
+    test->Build();
+
+    // About 1.23 fingerprints per key, plus a fixed overhead.
+    ASSERT_LE(test->FilterSize(),
+              static_cast<size_t>(length * 1.24 * fingerprint_bits / 8 +
+                                  32 * fingerprint_bits / 8 + 16))
+        << length;
+
+    // All added keys must match
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(test->Matches(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    double rate = test->FalsePositiveRate();
+    if (kVerbose >= 1) {
+      std::fprintf(stderr,
+                   "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
+                   rate * 100.0, length, static_cast<int>(test->FilterSize()));
+    }
+    ASSERT_LE(rate, max_rate) << length;
+  }
+}
+
+TEST_F(XorFilterTest, VaryingLengths8) {
+  // The expected false positive rate is 1/256 =~ 0.4%.
+  CheckVaryingLengths(this, 8, 0.008);
+}
+
+TEST_F(XorFilterTest, VaryingLengths16) {
+  UsePolicy(NewXorFilterPolicy(16));
+  // The expected false positive rate is 1/65536.
+  CheckVaryingLengths(this, 16, 0.001);
+}
+
+}  // namespace leveldb